@@ -14,22 +14,15 @@
 # along with this program; if not, write to the Free Software
 # Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
 
-QT += core gui widgets
+QT += core gui widgets concurrent
 
 CONFIG += c++11
 
-INCLUDEPATH += sdk
+include(sdk/sdk.pri)
 
 SOURCES += \
     main.cpp \
-    mainwindow.cpp \
-    sdk/knfontdialog.cpp \
-    sdk/knsearchbox.cpp
+    mainwindow.cpp
 
 HEADERS += \
-    mainwindow.h \
-    sdk/knfontdialog.h \
-    sdk/knsearchbox.h
-
-RESOURCES += \
-    sdk/CommonDialog.qrc
+    mainwindow.h
@@ -0,0 +1,177 @@
+/*
+ * Copyright (C) Kreogist Dev Team
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+#include <QBoxLayout>
+#include <QLabel>
+#include <QLineEdit>
+#include <QPushButton>
+#include <QRegExpValidator>
+#include <QScopedPointer>
+
+#include "knhsvpicker.h"
+#include "kntrace.h"
+
+#include "kncolordialog.h"
+
+//The size of the color previews.
+#define PreviewWidth 64
+#define PreviewHeight 32
+
+namespace
+{
+inline void setPreviewColor(QLabel *preview, const QColor &color)
+{
+    preview->setStyleSheet(QString("background-color: %1;").arg(color.name()));
+}
+}
+
+KNColorDialog::KNColorDialog(QWidget *parent) :
+    QDialog(parent),
+    m_picker(new KNHsvPicker(this)),
+    m_initialPreview(new QLabel(this)),
+    m_currentPreview(new QLabel(this)),
+    m_hexEditor(new QLineEdit(this)),
+    m_resultColor(Qt::white),
+    m_currentColor(Qt::white)
+{
+    KN_TRACE_SCOPE("KNColorDialog::construct");
+    //Initial layout.
+    QBoxLayout *mainLayout=new QBoxLayout(QBoxLayout::LeftToRight,
+                                          this);
+    setLayout(mainLayout);
+
+    //Color picker.
+    connect(m_picker, &KNHsvPicker::colorChanged,
+            this, &KNColorDialog::onActionPickerColorChange);
+    mainLayout->addWidget(m_picker, 1);
+
+    //Color options.
+    //Configure the previews.
+    m_initialPreview->setFixedSize(PreviewWidth, PreviewHeight);
+    m_currentPreview->setFixedSize(PreviewWidth, PreviewHeight);
+    //Configure the hex editor.
+    m_hexEditor->setValidator(
+                new QRegExpValidator(QRegExp("#?[0-9A-Fa-f]{0,6}"), this));
+    m_hexEditor->setMaximumWidth(PreviewWidth*2);
+    connect(m_hexEditor, &QLineEdit::textEdited,
+            this, &KNColorDialog::onActionHexEdited);
+    //Ok and Cancel button.
+    QPushButton *ok=new QPushButton(tr("Ok"), this),
+                *cancel=new QPushButton(tr("Cancel"), this);
+    //Configure the buttons.
+    ok->setDefault(true);
+    //Link ok and cancel button.
+    connect(ok,
+            static_cast<void (QPushButton::*)(bool)>(&QPushButton::clicked),
+            this, &KNColorDialog::onActionOk);
+    connect(cancel,
+            static_cast<void (QPushButton::*)(bool)>(&QPushButton::clicked),
+            this, &KNColorDialog::onActionCancel);
+    QBoxLayout *optionsLayout=new QBoxLayout(QBoxLayout::TopToBottom,
+                                             mainLayout->widget());
+    optionsLayout->addWidget(new QLabel(tr("Current"), this));
+    optionsLayout->addWidget(m_currentPreview);
+    optionsLayout->addWidget(new QLabel(tr("Initial"), this));
+    optionsLayout->addWidget(m_initialPreview);
+    optionsLayout->addWidget(new QLabel(tr("Hex"), this));
+    optionsLayout->addWidget(m_hexEditor);
+    optionsLayout->addStretch();
+    optionsLayout->addWidget(ok);
+    optionsLayout->addWidget(cancel);
+    mainLayout->addLayout(optionsLayout);
+}
+
+QColor KNColorDialog::resultColor() const
+{
+    return m_resultColor;
+}
+
+void KNColorDialog::setInitialColor(const QColor &color)
+{
+    //Save the initial color as the result color.
+    m_resultColor=color;
+    setPreviewColor(m_initialPreview, color);
+    //Sync the color to the picker and the editor.
+    m_picker->setColor(color);
+    syncColor(color);
+}
+
+QColor KNColorDialog::getColor(QWidget *parent,
+                               const QString &title,
+                               const QColor &initialColor)
+{
+    //Generate a color dialog.
+    QScopedPointer<KNColorDialog> colorDialog(new KNColorDialog(parent));
+    //Set the title and initial color.
+    colorDialog->setWindowTitle(title.isEmpty()?tr("Color"):title);
+    colorDialog->setInitialColor(initialColor);
+    //Launch the color dialog. Return the result color if accept the tweak.
+    if(QDialog::Accepted==colorDialog->exec())
+    {
+        return colorDialog->resultColor();
+    }
+    return initialColor;
+}
+
+void KNColorDialog::onActionOk(const bool &checked)
+{
+    Q_UNUSED(checked);
+    //Set the result color.
+    m_resultColor=m_currentColor;
+    emit colorSelected(m_resultColor);
+    //Set accept flag.
+    done(QDialog::Accepted);
+}
+
+void KNColorDialog::onActionCancel(const bool &checked)
+{
+    Q_UNUSED(checked);
+    done(QDialog::Rejected);
+}
+
+void KNColorDialog::onActionPickerColorChange(const QColor &color)
+{
+    syncColor(color);
+}
+
+void KNColorDialog::onActionHexEdited()
+{
+    //Only apply the complete color name.
+    QString hexText=m_hexEditor->text();
+    if(!hexText.startsWith('#'))
+    {
+        hexText.prepend('#');
+    }
+    QColor color(hexText);
+    if(hexText.size()!=7 || !color.isValid())
+    {
+        return;
+    }
+    m_picker->setColor(color);
+    syncColor(color, false);
+}
+
+inline void KNColorDialog::syncColor(const QColor &color, bool changeLineEdit)
+{
+    m_currentColor=color;
+    setPreviewColor(m_currentPreview, color);
+    //Sync the editor to the color.
+    if(changeLineEdit)
+    {
+        m_hexEditor->setText(color.name());
+    }
+}
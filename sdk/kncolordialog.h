@@ -0,0 +1,91 @@
+/*
+ * Copyright (C) Kreogist Dev Team
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#ifndef KNCOLORDIALOG_H
+#define KNCOLORDIALOG_H
+
+#include <QColor>
+#include <QDialog>
+
+class QLabel;
+class QLineEdit;
+class KNHsvPicker;
+/*!
+ * \brief The KNColorDialog is a dialog to select a color from a hue wheel and
+ * a saturation/value square, or from its hex name.
+ */
+class KNColorDialog : public QDialog
+{
+    Q_OBJECT
+public:
+    /*!
+     * \brief Construct a KNColorDialog.
+     * \param parent The parent widget.
+     */
+    explicit KNColorDialog(QWidget *parent = 0);
+
+    /*!
+     * \brief Get the color after configured by user.
+     * \return The user configured color.
+     */
+    QColor resultColor() const;
+
+    /*!
+     * \brief Set the initial color, which is going to be tweak.
+     * \param color The initial color.
+     */
+    void setInitialColor(const QColor &color);
+
+    /*!
+     * \brief Executes a modal color dialog and returns a color.\n
+     * If the user clicks OK, the selected color is returned. If the user
+     * clicks Cancel, the initial color is returned.
+     * \param parent The parent widget.
+     * \param title The color dialog title.
+     * \param initialColor The initial color.
+     * \return The selected color.
+     */
+    static QColor getColor(QWidget *parent=0,
+                           const QString &title=QString(),
+                           const QColor &initialColor=Qt::white);
+
+signals:
+    /*!
+     * \brief When the user clicks OK, this signal will be emitted with the
+     * selected color.
+     * \param color The selected color.
+     */
+    void colorSelected(const QColor &color);
+
+public slots:
+
+private slots:
+    void onActionOk(const bool &checked);
+    void onActionCancel(const bool &checked);
+    void onActionPickerColorChange(const QColor &color);
+    void onActionHexEdited();
+
+private:
+    inline void syncColor(const QColor &color, bool changeLineEdit=true);
+    KNHsvPicker *m_picker;
+    QLabel *m_initialPreview, *m_currentPreview;
+    QLineEdit *m_hexEditor;
+    QColor m_resultColor, m_currentColor;
+};
+
+#endif // KNCOLORDIALOG_H
@@ -0,0 +1,130 @@
+/*
+ * Copyright (C) Kreogist Dev Team
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+#include <QDirIterator>
+#include <QFile>
+#include <QFileInfo>
+
+#ifdef Q_OS_LINUX
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#include "kndirectoryreader.h"
+
+//The size of the getdents64() buffer.
+#define DirentBufferSize 65536
+
+#ifdef Q_OS_LINUX
+namespace
+{
+struct LinuxDirent64
+{
+    quint64 d_ino;
+    qint64 d_off;
+    unsigned short d_reclen;
+    unsigned char d_type;
+    char d_name[1];
+};
+}
+#endif
+
+bool KNDirectoryReader::read(const QString &path,
+                             bool showHidden,
+                             const EntryHandler &handler)
+{
+#ifdef Q_OS_LINUX
+    //Read the directory entries directly, the type of most entries is known
+    //without a stat call.
+    int directoryFd=::open(QFile::encodeName(path).constData(),
+                           O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if(directoryFd==-1)
+    {
+        return false;
+    }
+    QByteArray direntBuffer(DirentBufferSize, Qt::Uninitialized);
+    long length;
+    while((length=syscall(SYS_getdents64,
+                          directoryFd,
+                          direntBuffer.data(),
+                          direntBuffer.size()))>0)
+    {
+        for(long offset=0; offset<length; )
+        {
+            const LinuxDirent64 *dirent=
+                    reinterpret_cast<const LinuxDirent64 *>(
+                        direntBuffer.constData()+offset);
+            offset+=dirent->d_reclen;
+            const char *name=dirent->d_name;
+            //Skip the "." and "..", and the hidden entries.
+            if(name[0]=='.' &&
+                    (!showHidden || name[1]=='\0' ||
+                     (name[1]=='.' && name[2]=='\0')))
+            {
+                continue;
+            }
+            unsigned char type=dirent->d_type;
+            //Some file systems don't provide the type.
+            if(type==DT_UNKNOWN)
+            {
+                struct stat entryStat;
+                if(fstatat(directoryFd, name, &entryStat,
+                           AT_SYMLINK_NOFOLLOW)==0)
+                {
+                    type=S_ISDIR(entryStat.st_mode)?DT_DIR:
+                         (S_ISLNK(entryStat.st_mode)?DT_LNK:DT_REG);
+                }
+            }
+            if(!handler(name, type==DT_DIR, type==DT_LNK))
+            {
+                ::close(directoryFd);
+                return true;
+            }
+        }
+    }
+    ::close(directoryFd);
+    return true;
+#else
+    QDir::Filters filters=QDir::AllEntries | QDir::NoDotAndDotDot |
+            QDir::System;
+    if(showHidden)
+    {
+        filters|=QDir::Hidden;
+    }
+    if(!QFileInfo(path).isDir())
+    {
+        return false;
+    }
+    QDirIterator directoryIterator(path, filters);
+    while(directoryIterator.hasNext())
+    {
+        directoryIterator.next();
+        QFileInfo fileInfo=directoryIterator.fileInfo();
+        //Don't follow the link to a directory.
+        if(!handler(QFile::encodeName(fileInfo.fileName()).constData(),
+                    fileInfo.isDir() && !fileInfo.isSymLink(),
+                    fileInfo.isSymLink()))
+        {
+            break;
+        }
+    }
+    return true;
+#endif
+}
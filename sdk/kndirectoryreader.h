@@ -0,0 +1,58 @@
+/*
+ * Copyright (C) Kreogist Dev Team
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#ifndef KNDIRECTORYREADER_H
+#define KNDIRECTORYREADER_H
+
+#include <QString>
+
+#include <functional>
+
+/*!
+ * \brief The KNDirectoryReader reads the entries of one directory as fast as
+ * the platform allows. On Linux, it reads the entries with batched
+ * getdents64() calls, and the type of an entry is taken from the directory
+ * entry, an entry is only stated when the file system doesn't provide its
+ * type.
+ */
+class KNDirectoryReader
+{
+public:
+    /*!
+     * \brief The entry handler is called with the name in the file system
+     * encoding, whether the entry is a directory and whether it is a symbolic
+     * link. Return false to stop reading.
+     */
+    typedef std::function<bool(const char *, bool, bool)> EntryHandler;
+
+    /*!
+     * \brief Read all the entries of a directory, "." and ".." are skipped.
+     * \param path The directory path.
+     * \param showHidden To read the hidden entries, set it to true.
+     * \param handler The entry handler.
+     * \return If the directory could be opened, return true.
+     */
+    static bool read(const QString &path,
+                     bool showHidden,
+                     const EntryHandler &handler);
+
+private:
+    KNDirectoryReader();
+};
+
+#endif // KNDIRECTORYREADER_H
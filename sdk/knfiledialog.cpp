@@ -0,0 +1,360 @@
+/*
+ * Copyright (C) Kreogist Dev Team
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+#include <QBoxLayout>
+#include <QDir>
+#include <QFileInfo>
+#include <QHeaderView>
+#include <QLabel>
+#include <QLineEdit>
+#include <QListWidget>
+#include <QPushButton>
+#include <QScopedPointer>
+#include <QTreeView>
+
+#include "knfileindex.h"
+#include "knfilesystemmodel.h"
+#include "knsearchbox.h"
+#include "kntrace.h"
+
+#include "knfiledialog.h"
+
+//The maximum number of the search results.
+#define SearchResultLimit 500
+//The time to wait for the index before checking the cancel.
+#define IndexWaitInterval 50
+
+KNFileDialog::KNFileDialog(QWidget *parent) :
+    QDialog(parent),
+    m_fileModel(new KNFileSystemModel(this)),
+    m_fileView(new QTreeView(this)),
+    m_searchResults(new QListWidget(this)),
+    m_fileSearcher(new KNSearchBox(this)),
+    m_fileIndex(new SearchIndex),
+    m_pathEditor(new QLineEdit(this)),
+    m_nameEditor(new QLineEdit(this)),
+    m_status(new QLabel(this))
+{
+    KN_TRACE_SCOPE("KNFileDialog::construct");
+    //Initial layout.
+    QBoxLayout *mainLayout=new QBoxLayout(QBoxLayout::TopToBottom,
+                                          this);
+    setLayout(mainLayout);
+
+    //Path bar.
+    QPushButton *up=new QPushButton(tr("Up"), this);
+    connect(up,
+            static_cast<void (QPushButton::*)(bool)>(&QPushButton::clicked),
+            this, &KNFileDialog::onActionUp);
+    connect(m_pathEditor, &QLineEdit::returnPressed,
+            this, &KNFileDialog::onActionPathEdited);
+    QBoxLayout *pathLayout=new QBoxLayout(QBoxLayout::LeftToRight,
+                                          mainLayout->widget());
+    pathLayout->addWidget(m_pathEditor, 1);
+    pathLayout->addWidget(up);
+    mainLayout->addLayout(pathLayout);
+
+    //File search.
+    m_fileSearcher->setPlaceholderText(tr("Search in this folder"));
+    //The index is searched on the search worker, it is picked on the main
+    //thread when the search starts. The worker may outlive the dialog, so it
+    //holds a reference of the index while searching.
+    QSharedPointer<SearchIndex> fileIndex=m_fileIndex;
+    m_fileSearcher->setSearchFunction(
+                [fileIndex](const QString &query, KNSearchReporter &reporter)
+    {
+        QSharedPointer<KNFileIndex> searchIndex;
+        {
+            QMutexLocker locker(&fileIndex->lock);
+            searchIndex=fileIndex->index;
+        }
+        if(query.isEmpty() || searchIndex.isNull())
+        {
+            return;
+        }
+        //A new index is ready after the tree is walked.
+        while(!searchIndex->waitForReady(IndexWaitInterval))
+        {
+            if(reporter.isCanceled())
+            {
+                return;
+            }
+        }
+        reporter.reportResults(searchIndex->search(query, SearchResultLimit));
+    });
+    connect(m_fileSearcher, &KNSearchBox::textChanged,
+            this, &KNFileDialog::onActionSearchTextChange);
+    connect(m_fileSearcher, &KNSearchBox::searchStarted,
+            this, &KNFileDialog::onActionSearchStarted);
+    connect(m_fileSearcher, &KNSearchBox::searchResultsReady,
+            this, &KNFileDialog::onActionSearchResultsReady);
+    connect(m_searchResults, &QListWidget::itemActivated,
+            this, &KNFileDialog::onActionSearchResultActivated);
+    m_searchResults->setUniformItemSizes(true);
+    m_searchResults->hide();
+    mainLayout->addWidget(m_fileSearcher);
+
+    //File view.
+    //Configure view, all the rows have the same height.
+    m_fileView->setModel(m_fileModel);
+    m_fileView->setRootIsDecorated(false);
+    m_fileView->setUniformRowHeights(true);
+    m_fileView->setItemsExpandable(false);
+    m_fileView->setSelectionMode(QAbstractItemView::SingleSelection);
+    m_fileView->setSelectionBehavior(QAbstractItemView::SelectRows);
+    m_fileView->header()->setStretchLastSection(false);
+    m_fileView->header()->setSectionResizeMode(KNFileSystemModel::NameColumn,
+                                               QHeaderView::Stretch);
+    //Keep the listed order until a column is clicked.
+    m_fileView->header()->setSortIndicator(-1, Qt::AscendingOrder);
+    m_fileView->setSortingEnabled(true);
+    connect(m_fileView, &QTreeView::activated,
+            this, &KNFileDialog::onActionEntryActivated);
+    connect(m_fileView->selectionModel(), &QItemSelectionModel::currentChanged,
+            this, &KNFileDialog::onActionCurrentChanged);
+    connect(m_fileModel, &KNFileSystemModel::directoryLoaded,
+            this, &KNFileDialog::onActionDirectoryLoaded);
+    connect(m_fileModel, &KNFileSystemModel::rowsInserted,
+            this, &KNFileDialog::updateStatus);
+    connect(m_fileModel, &KNFileSystemModel::rowsRemoved,
+            this, &KNFileDialog::updateStatus);
+    mainLayout->addWidget(m_fileView, 1);
+    mainLayout->addWidget(m_searchResults, 1);
+    mainLayout->addWidget(m_status);
+
+    //File name and buttons.
+    QPushButton *ok=new QPushButton(tr("Ok"), this),
+                *cancel=new QPushButton(tr("Cancel"), this);
+    //Configure the buttons.
+    ok->setDefault(true);
+    //Link ok and cancel button.
+    connect(ok,
+            static_cast<void (QPushButton::*)(bool)>(&QPushButton::clicked),
+            this, &KNFileDialog::onActionOk);
+    connect(cancel,
+            static_cast<void (QPushButton::*)(bool)>(&QPushButton::clicked),
+            this, &KNFileDialog::onActionCancel);
+    QBoxLayout *nameLayout=new QBoxLayout(QBoxLayout::LeftToRight,
+                                          mainLayout->widget());
+    nameLayout->addWidget(new QLabel(tr("File name"), this));
+    nameLayout->addWidget(m_nameEditor, 1);
+    nameLayout->addWidget(ok);
+    nameLayout->addWidget(cancel);
+    mainLayout->addLayout(nameLayout);
+    resize(640, 480);
+}
+
+QString KNFileDialog::directory() const
+{
+    return m_fileModel->rootPath();
+}
+
+QString KNFileDialog::selectedFile() const
+{
+    return m_selectedFile;
+}
+
+QString KNFileDialog::getOpenFileName(QWidget *parent,
+                                      const QString &title,
+                                      const QString &directory)
+{
+    //Generate a file dialog.
+    QScopedPointer<KNFileDialog> fileDialog(new KNFileDialog(parent));
+    //Set the title and the initial directory.
+    fileDialog->setWindowTitle(title.isEmpty()?tr("Open File"):title);
+    fileDialog->setDirectory(directory.isEmpty()?QDir::homePath():directory);
+    //Launch the file dialog. Return the selected file if accept.
+    if(QDialog::Accepted==fileDialog->exec())
+    {
+        return fileDialog->selectedFile();
+    }
+    return QString();
+}
+
+void KNFileDialog::setDirectory(const QString &directory)
+{
+    m_fileModel->setRootPath(directory);
+    m_pathEditor->setText(QDir::toNativeSeparators(m_fileModel->rootPath()));
+    m_nameEditor->clear();
+    //The search is restarted under the new directory.
+    m_fileSearcher->clear();
+    updateStatus();
+}
+
+void KNFileDialog::onActionOk(const bool &checked)
+{
+    Q_UNUSED(checked);
+    QString name=m_nameEditor->text();
+    if(name.isEmpty())
+    {
+        return;
+    }
+    QString path=QDir(m_fileModel->rootPath()).absoluteFilePath(name);
+    QFileInfo fileInfo(path);
+    //Open the directory instead of selecting it.
+    if(fileInfo.isDir())
+    {
+        setDirectory(path);
+        return;
+    }
+    if(!fileInfo.exists())
+    {
+        return;
+    }
+    //Set the selected file.
+    m_selectedFile=path;
+    emit fileSelected(m_selectedFile);
+    //Set accept flag.
+    done(QDialog::Accepted);
+}
+
+void KNFileDialog::onActionCancel(const bool &checked)
+{
+    Q_UNUSED(checked);
+    done(QDialog::Rejected);
+}
+
+void KNFileDialog::onActionUp(const bool &checked)
+{
+    Q_UNUSED(checked);
+    QDir directory(m_fileModel->rootPath());
+    if(directory.cdUp())
+    {
+        setDirectory(directory.absolutePath());
+    }
+}
+
+void KNFileDialog::onActionPathEdited()
+{
+    setDirectory(QDir::fromNativeSeparators(m_pathEditor->text()));
+}
+
+void KNFileDialog::onActionEntryActivated(const QModelIndex &index)
+{
+    //Open the directory, or select the file.
+    if(m_fileModel->entry(index.row()).isDir)
+    {
+        setDirectory(m_fileModel->filePath(index));
+        return;
+    }
+    m_nameEditor->setText(m_fileModel->entry(index.row()).name);
+    onActionOk(false);
+}
+
+void KNFileDialog::onActionCurrentChanged(const QModelIndex &current)
+{
+    //Show the name of the current file.
+    if(current.isValid() && !m_fileModel->entry(current.row()).isDir)
+    {
+        m_nameEditor->setText(m_fileModel->entry(current.row()).name);
+    }
+}
+
+void KNFileDialog::onActionDirectoryLoaded()
+{
+    updateStatus();
+}
+
+void KNFileDialog::onActionSearchTextChange(const QString &text)
+{
+    //Show the directory again when the search is cleared.
+    if(text.isEmpty())
+    {
+        m_fileSearcher->cancelSearch();
+        m_searchResults->hide();
+        m_searchResults->clear();
+        m_fileView->show();
+    }
+}
+
+void KNFileDialog::onActionSearchStarted(const QString &query)
+{
+    if(query.isEmpty())
+    {
+        return;
+    }
+    //Get the index of the directory, it is created at the first search. The
+    //index of the previous directory is released.
+    QSharedPointer<KNFileIndex> fileIndex=m_fileIndex->index;
+    if(fileIndex.isNull() || fileIndex->rootPath()!=
+            QDir::cleanPath(QFileInfo(directory()).absoluteFilePath()))
+    {
+        if(!fileIndex.isNull())
+        {
+            disconnect(fileIndex.data(), &KNFileIndex::indexUpdated,
+                       m_fileSearcher, &KNSearchBox::search);
+        }
+        fileIndex=KNFileIndex::index(directory());
+        //Search again when the files are changed.
+        connect(fileIndex.data(), &KNFileIndex::indexUpdated,
+                m_fileSearcher, &KNSearchBox::search);
+        QMutexLocker locker(&m_fileIndex->lock);
+        m_fileIndex->index=fileIndex;
+    }
+    m_fileView->hide();
+    m_searchResults->show();
+}
+
+void KNFileDialog::onActionSearchResultsReady(const QString &query,
+                                              const QVector<int> &entryIds)
+{
+    Q_UNUSED(query);
+    KN_TRACE_SCOPE("KNFileDialog::showSearchResults");
+    //The index is only changed on the main thread.
+    QSharedPointer<KNFileIndex> fileIndex=m_fileIndex->index;
+    m_searchResults->clear();
+    QDir rootDirectory(fileIndex->rootPath());
+    for(int entryId : entryIds)
+    {
+        QString path=fileIndex->filePath(entryId);
+        if(path.isEmpty())
+        {
+            continue;
+        }
+        //Show the path under the directory, keep the absolute path.
+        QListWidgetItem *item=new QListWidgetItem(
+                    QDir::toNativeSeparators(rootDirectory.relativeFilePath(
+                                                 path)),
+                    m_searchResults);
+        item->setData(Qt::UserRole, path);
+    }
+    m_status->setText(tr("%1 results").arg(m_searchResults->count()));
+}
+
+void KNFileDialog::onActionSearchResultActivated(QListWidgetItem *item)
+{
+    QString path=item->data(Qt::UserRole).toString();
+    QFileInfo fileInfo(path);
+    //Open the directory, or select the file.
+    if(fileInfo.isDir())
+    {
+        setDirectory(path);
+        return;
+    }
+    setDirectory(fileInfo.absolutePath());
+    m_nameEditor->setText(fileInfo.fileName());
+    onActionOk(false);
+}
+
+inline void KNFileDialog::updateStatus()
+{
+    //Show the progress of the listing.
+    m_status->setText(m_fileModel->isLoading()?
+                          tr("Loading... %1 items").arg(
+                              m_fileModel->rowCount()):
+                          tr("%1 items").arg(m_fileModel->rowCount()));
+}
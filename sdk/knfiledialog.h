@@ -0,0 +1,124 @@
+/*
+ * Copyright (C) Kreogist Dev Team
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#ifndef KNFILEDIALOG_H
+#define KNFILEDIALOG_H
+
+#include <QDialog>
+#include <QMutex>
+#include <QSharedPointer>
+
+class QLabel;
+class QLineEdit;
+class QListWidget;
+class QListWidgetItem;
+class QModelIndex;
+class QTreeView;
+class KNFileIndex;
+class KNFileSystemModel;
+class KNSearchBox;
+/*!
+ * \brief The KNFileDialog is a dialog to select a file. The directories are
+ * listed on a worker thread and streamed into the view, so a huge or remote
+ * directory doesn't freeze the dialog.\n
+ * The search box finds the files under the current directory by a part of
+ * their names, with a persistent index of the directory tree.
+ */
+class KNFileDialog : public QDialog
+{
+    Q_OBJECT
+public:
+    /*!
+     * \brief Construct a KNFileDialog.
+     * \param parent The parent widget.
+     */
+    explicit KNFileDialog(QWidget *parent = 0);
+
+    /*!
+     * \brief Get the directory shown in the dialog.
+     * \return The directory path.
+     */
+    QString directory() const;
+
+    /*!
+     * \brief Get the file selected by user.
+     * \return The selected file path. If no file is selected, it is empty.
+     */
+    QString selectedFile() const;
+
+    /*!
+     * \brief Executes a modal file dialog and returns an existing file.\n
+     * If the user clicks OK, the selected file is returned. If the user clicks
+     * Cancel, an empty string is returned.
+     * \param parent The parent widget.
+     * \param title The file dialog title.
+     * \param directory The initial directory, the home directory is used when
+     * it is empty.
+     * \return The selected file path.
+     */
+    static QString getOpenFileName(QWidget *parent=0,
+                                   const QString &title=QString(),
+                                   const QString &directory=QString());
+
+signals:
+    /*!
+     * \brief When the user clicks OK with a file, this signal will be
+     * emitted.
+     * \param file The selected file path.
+     */
+    void fileSelected(const QString &file);
+
+public slots:
+    /*!
+     * \brief Show a directory in the dialog.
+     * \param directory The directory path.
+     */
+    void setDirectory(const QString &directory);
+
+private slots:
+    void onActionOk(const bool &checked);
+    void onActionCancel(const bool &checked);
+    void onActionUp(const bool &checked);
+    void onActionPathEdited();
+    void onActionEntryActivated(const QModelIndex &index);
+    void onActionCurrentChanged(const QModelIndex &current);
+    void onActionDirectoryLoaded();
+    void onActionSearchTextChange(const QString &text);
+    void onActionSearchStarted(const QString &query);
+    void onActionSearchResultsReady(const QString &query,
+                                    const QVector<int> &entryIds);
+    void onActionSearchResultActivated(QListWidgetItem *item);
+
+private:
+    struct SearchIndex
+    {
+        QMutex lock;
+        QSharedPointer<KNFileIndex> index;
+    };
+    inline void updateStatus();
+    KNFileSystemModel *m_fileModel;
+    QTreeView *m_fileView;
+    QListWidget *m_searchResults;
+    KNSearchBox *m_fileSearcher;
+    QSharedPointer<SearchIndex> m_fileIndex;
+    QLineEdit *m_pathEditor, *m_nameEditor;
+    QLabel *m_status;
+    QString m_selectedFile;
+};
+
+#endif // KNFILEDIALOG_H
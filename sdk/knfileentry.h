@@ -0,0 +1,72 @@
+/*
+ * Copyright (C) Kreogist Dev Team
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#ifndef KNFILEENTRY_H
+#define KNFILEENTRY_H
+
+#include <QMetaType>
+#include <QString>
+#include <QVector>
+
+/*!
+ * \brief The KNFileEntry describes one entry of a directory. The name and the
+ * type are known from the directory listing, the size and the modified time
+ * are only loaded when they are needed.
+ */
+struct KNFileEntry
+{
+    /*!
+     * \brief The file name.
+     */
+    QString name;
+    /*!
+     * \brief The file size in bytes, it is -1 before the entry is stated.
+     */
+    qint64 size;
+    /*!
+     * \brief The modified time in milliseconds since the epoch, it is -1
+     * before the entry is stated.
+     */
+    qint64 modified;
+    /*!
+     * \brief Whether the entry is a directory, or a link to a directory.
+     */
+    bool isDir;
+    /*!
+     * \brief Whether the entry is a symbolic link.
+     */
+    bool isSymLink;
+    /*!
+     * \brief Whether the size and the modified time are loaded.
+     */
+    bool stated;
+    KNFileEntry() :
+        size(-1),
+        modified(-1),
+        isDir(false),
+        isSymLink(false),
+        stated(false)
+    {
+    }
+};
+
+typedef QVector<KNFileEntry> KNFileEntryList;
+
+Q_DECLARE_METATYPE(KNFileEntry)
+
+#endif // KNFILEENTRY_H
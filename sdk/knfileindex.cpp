@@ -0,0 +1,1220 @@
+/*
+ * Copyright (C) Kreogist Dev Team
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+#include <QCryptographicHash>
+#include <QDir>
+#include <QFileInfo>
+#include <QMutex>
+#include <QSaveFile>
+#include <QSocketNotifier>
+#include <QStandardPaths>
+#include <QThread>
+#include <QThreadPool>
+#include <QTimer>
+#include <QtConcurrent/QtConcurrent>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+
+#ifdef Q_OS_LINUX
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+#include "kndirectoryreader.h"
+#include "kntrace.h"
+
+#include "knfileindex.h"
+
+#define IndexMagic 0x49464E4B
+#define IndexVersion 1
+//The size of the inotify event buffer.
+#define InotifyBufferSize 65536
+//When the delta is larger than this, the tree is walked again.
+#define DeltaRebuildThreshold 4096
+//The delay of walking the tree again after the changes, in milliseconds.
+#define RebuildDelay 1000
+//The interval of walking the tree again when some directories couldn't be
+//watched, in milliseconds.
+#define PollRebuildInterval 300000
+//The parent of the root entry.
+#define NoParent 0xFFFFFFFFu
+
+#ifdef Q_OS_LINUX
+//The changes of the directory entries are watched.
+#define IndexWatchMask (IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO | \
+                        IN_ONLYDIR | IN_DONT_FOLLOW)
+#endif
+
+namespace
+{
+//The index file is laid out as the header, the entry records, the trigram
+//records, the posting lists and the name arena. All the records are aligned
+//to 4 bytes so the file could be used after it is mapped.
+struct IndexHeader
+{
+    quint32 magic;
+    quint32 version;
+    quint32 entryCount;
+    quint32 trigramCount;
+    quint32 postingCount;
+    quint32 nameSize;
+};
+
+struct EntryRecord
+{
+    quint32 nameOffset;
+    quint32 parent;
+    quint16 nameLength;
+    quint16 isDir;
+};
+
+struct TrigramRecord
+{
+    quint32 trigram;
+    quint32 postingOffset;
+    quint32 postingCount;
+};
+
+//The entries of one top level directory.
+struct LocalTree
+{
+    QVector<EntryRecord> entries;
+    QByteArray names;
+    bool watchesComplete;
+    LocalTree() :
+        watchesComplete(true)
+    {
+    }
+};
+
+//The builds of all the indexes save their files one by one.
+QMutex cacheFileLock;
+
+//The inotify instance and the watches of an index. The walkers add their
+//watches to the index at once, so the events of the new watches are applied
+//while the tree is still being walked.
+struct WatchTarget
+{
+    int inotifyFd;
+    QHash<int, QString> *watches;
+    QReadWriteLock *lock;
+};
+
+struct SearchMatch
+{
+    int rank;
+    int nameLength;
+    int depth;
+    int entryId;
+};
+
+inline bool operator <(const SearchMatch &left, const SearchMatch &right)
+{
+    if(left.rank!=right.rank)
+    {
+        return left.rank<right.rank;
+    }
+    if(left.nameLength!=right.nameLength)
+    {
+        return left.nameLength<right.nameLength;
+    }
+    if(left.depth!=right.depth)
+    {
+        return left.depth<right.depth;
+    }
+    return left.entryId<right.entryId;
+}
+
+inline uchar foldByte(uchar byte)
+{
+    return (byte>='A' && byte<='Z')?(byte|0x20):byte;
+}
+
+inline quint32 trigramAt(const char *name)
+{
+    return ((quint32)foldByte(name[0])<<16) |
+            ((quint32)foldByte(name[1])<<8) |
+            (quint32)foldByte(name[2]);
+}
+
+//Get the rank of a name: 0 for the exact name, 1 for the prefix, 2 for the
+//substring. If the name doesn't contain the folded query, return -1.
+inline int matchRank(const char *name, int nameLength,
+                     const QByteArray &query)
+{
+    int queryLength=query.size();
+    const char *queryData=query.constData();
+    for(int start=0; start+queryLength<=nameLength; ++start)
+    {
+        int i=0;
+        while(i<queryLength && foldByte(name[start+i])==(uchar)queryData[i])
+        {
+            ++i;
+        }
+        if(i==queryLength)
+        {
+            return start>0?2:(nameLength==queryLength?0:1);
+        }
+    }
+    return -1;
+}
+
+inline void appendEntry(QVector<EntryRecord> &entries,
+                        QByteArray &names,
+                        const char *name,
+                        quint32 parent,
+                        bool isDir)
+{
+    EntryRecord entry;
+    int nameLength=qMin<int>(qstrlen(name), 0xFFFF);
+    entry.nameOffset=names.size();
+    entry.parent=parent;
+    entry.nameLength=nameLength;
+    entry.isDir=isDir;
+    names.append(name, nameLength);
+    entries.append(entry);
+}
+
+//Watch a directory. If the watch couldn't be added because the limit of the
+//watches is reached, or the directories couldn't be watched at all, return
+//false, the tree is walked again periodically then.
+inline bool watchDirectory(const WatchTarget &target,
+                           const QString &path,
+                           const QString &relativePath)
+{
+#ifdef Q_OS_LINUX
+    if(target.inotifyFd!=-1)
+    {
+        int watch=inotify_add_watch(target.inotifyFd,
+                                    QFile::encodeName(path).constData(),
+                                    IndexWatchMask);
+        if(watch!=-1)
+        {
+            QWriteLocker locker(target.lock);
+            target.watches->insert(watch, relativePath);
+        }
+        //The directories which couldn't be read or are removed are ignored.
+        else if(errno==ENOSPC || errno==ENOMEM)
+        {
+            return false;
+        }
+        return true;
+    }
+#else
+    Q_UNUSED(target)
+    Q_UNUSED(path)
+    Q_UNUSED(relativePath)
+#endif
+    return false;
+}
+
+//Walk a top level directory, the parent of its children is LocalRoot.
+LocalTree walkTree(const QString &rootPath,
+                   const QString &topPath,
+                   const WatchTarget &target,
+                   const QAtomicInt *generation,
+                   int buildGeneration)
+{
+    KN_TRACE_SCOPE("KNFileIndex::walkTree");
+    LocalTree tree;
+    QVector<QPair<QString, quint32> > directories;
+    directories.append(qMakePair(topPath, NoParent));
+    while(!directories.isEmpty())
+    {
+        if(generation->loadAcquire()!=buildGeneration)
+        {
+            break;
+        }
+        QPair<QString, quint32> directory=directories.takeLast();
+        QString directoryPath=rootPath+"/"+directory.first;
+        if(!watchDirectory(target, directoryPath, directory.first))
+        {
+            tree.watchesComplete=false;
+        }
+        KNDirectoryReader::read(directoryPath, false,
+                                [&](const char *name, bool isDir, bool)
+        {
+            quint32 entryId=tree.entries.size();
+            appendEntry(tree.entries, tree.names, name, directory.second,
+                        isDir);
+            if(isDir)
+            {
+                directories.append(
+                            qMakePair(directory.first+"/"+
+                                      QFile::decodeName(name),
+                                      entryId));
+            }
+            return true;
+        });
+    }
+    return tree;
+}
+
+//Collect the sorted (trigram, entry) pairs of a range of the entries.
+QVector<quint64> collectTrigrams(const EntryRecord *entries,
+                                 const char *names,
+                                 int first,
+                                 int last)
+{
+    QVector<quint64> pairs;
+    for(int i=first; i<last; ++i)
+    {
+        const EntryRecord &entry=entries[i];
+        const char *name=names+entry.nameOffset;
+        for(int j=0; j+3<=entry.nameLength; ++j)
+        {
+            pairs.append(((quint64)trigramAt(name+j)<<32) | (quint32)i);
+        }
+    }
+    std::sort(pairs.begin(), pairs.end());
+    pairs.erase(std::unique(pairs.begin(), pairs.end()), pairs.end());
+    return pairs;
+}
+}
+
+QHash<QString, QWeakPointer<KNFileIndex> > KNFileIndex::m_indexes;
+
+QSharedPointer<KNFileIndex> KNFileIndex::index(const QString &rootPath)
+{
+    QString cleanRootPath=QDir::cleanPath(QFileInfo(rootPath).absoluteFilePath());
+    QSharedPointer<KNFileIndex> fileIndex=
+            m_indexes.value(cleanRootPath).toStrongRef();
+    if(fileIndex.isNull())
+    {
+        //The index is deleted on the main thread when it is released, the
+        //last reference might be held by a search worker.
+        fileIndex=QSharedPointer<KNFileIndex>(new KNFileIndex(cleanRootPath),
+                                              &QObject::deleteLater);
+        m_indexes.insert(cleanRootPath, fileIndex);
+    }
+    return fileIndex;
+}
+
+KNFileIndex::KNFileIndex(const QString &rootPath, QObject *parent) :
+    QObject(parent),
+    m_rootPath(rootPath),
+    m_cacheData(nullptr),
+    m_data(nullptr),
+    m_dataSize(0),
+    m_buildPool(new QThreadPool(this)),
+    m_generation(0),
+    m_inotifyNotifier(nullptr),
+    m_rebuildTimer(new QTimer(this)),
+    m_pollTimer(new QTimer(this)),
+    m_inotifyFd(-1),
+    m_ready(false)
+{
+    //The tree is walked again after the changes are settled.
+    m_rebuildTimer->setSingleShot(true);
+    m_rebuildTimer->setInterval(RebuildDelay);
+    connect(m_rebuildTimer, &QTimer::timeout,
+            this, &KNFileIndex::rebuild);
+    //When some directories couldn't be watched, their changes are only found
+    //by walking the tree again periodically.
+    m_pollTimer->setSingleShot(true);
+    m_pollTimer->setInterval(PollRebuildInterval);
+    connect(m_pollTimer, &QTimer::timeout,
+            this, &KNFileIndex::rebuild);
+#ifdef Q_OS_LINUX
+    //Watch the tree with inotify, the watches are added while walking.
+    m_inotifyFd=inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if(m_inotifyFd!=-1)
+    {
+        m_inotifyNotifier=new QSocketNotifier(m_inotifyFd,
+                                              QSocketNotifier::Read,
+                                              this);
+        connect(m_inotifyNotifier, &QSocketNotifier::activated,
+                this, &KNFileIndex::onActionInotifyActivated);
+    }
+#endif
+    //Map the saved index, it is searched until the new index is built. The
+    //file is checked on the worker, it is used after it is checked.
+    m_cacheFile.setFileName(cachePath(m_rootPath));
+    if(m_cacheFile.open(QIODevice::ReadOnly))
+    {
+        m_cacheData=m_cacheFile.map(0, m_cacheFile.size());
+        if(m_cacheData==nullptr)
+        {
+            m_cacheFile.close();
+        }
+        else
+        {
+            const uchar *cacheData=m_cacheData;
+            qint64 cacheSize=m_cacheFile.size();
+            m_cacheChecker=QtConcurrent::run(m_buildPool, [=]()
+            {
+                bool valid=checkIndexData(cacheData, cacheSize);
+                QMetaObject::invokeMethod(this,
+                                          "onActionCacheChecked",
+                                          Qt::QueuedConnection,
+                                          Q_ARG(bool, valid));
+            });
+        }
+    }
+    //Walk the tree in the background.
+    rebuild();
+}
+
+KNFileIndex::~KNFileIndex()
+{
+    //Stop the walkers, they check the generation for every directory.
+    m_generation.fetchAndAddOrdered(1);
+    m_buildPool->clear();
+    m_buildPool->waitForDone();
+    //A new index of the root might be created before this one is deleted.
+    if(m_indexes.value(m_rootPath).isNull())
+    {
+        m_indexes.remove(m_rootPath);
+    }
+#ifdef Q_OS_LINUX
+    if(m_inotifyFd!=-1)
+    {
+        ::close(m_inotifyFd);
+    }
+#endif
+}
+
+QString KNFileIndex::rootPath() const
+{
+    return m_rootPath;
+}
+
+bool KNFileIndex::isReady() const
+{
+    QReadLocker locker(&m_lock);
+    return m_ready;
+}
+
+bool KNFileIndex::waitForReady(int msecs) const
+{
+    QReadLocker locker(&m_lock);
+    if(!m_ready)
+    {
+        m_readyCondition.wait(&m_lock, msecs);
+    }
+    return m_ready;
+}
+
+QVector<int> KNFileIndex::search(const QString &query, int limit) const
+{
+    KN_TRACE_SCOPE("KNFileIndex::search");
+    QByteArray foldedQuery=foldName(QFile::encodeName(query));
+    if(foldedQuery.isEmpty() || limit<1)
+    {
+        return QVector<int>();
+    }
+    QReadLocker locker(&m_lock);
+    QVector<SearchMatch> matches;
+    const IndexHeader *header=
+            reinterpret_cast<const IndexHeader *>(m_data);
+    if(m_data!=nullptr)
+    {
+        const EntryRecord *entries=
+                reinterpret_cast<const EntryRecord *>(m_data+
+                                                      sizeof(IndexHeader));
+        const TrigramRecord *trigrams=
+                reinterpret_cast<const TrigramRecord *>(
+                    entries+header->entryCount);
+        const quint32 *postings=reinterpret_cast<const quint32 *>(
+                    trigrams+header->trigramCount);
+        const char *names=reinterpret_cast<const char *>(
+                    postings+header->postingCount);
+        //Check one candidate entry.
+        auto checkEntry=[&](quint32 entryId)
+        {
+            const EntryRecord &entry=entries[entryId];
+            int rank=matchRank(names+entry.nameOffset, entry.nameLength,
+                               foldedQuery);
+            if(rank==-1 || isRemoved(entryId))
+            {
+                return;
+            }
+            SearchMatch match;
+            match.rank=rank;
+            match.nameLength=entry.nameLength;
+            match.depth=0;
+            for(quint32 parent=entry.parent; parent!=0;
+                parent=entries[parent].parent)
+            {
+                ++match.depth;
+            }
+            match.entryId=entryId;
+            matches.append(match);
+        };
+        if(foldedQuery.size()<3)
+        {
+            //The query is too short for the trigrams, scan all the names.
+            for(quint32 i=1; i<header->entryCount; ++i)
+            {
+                checkEntry(i);
+            }
+        }
+        else
+        {
+            //Find the posting lists of all the trigrams in the query.
+            QVector<QPair<const quint32 *, quint32> > lists;
+            bool missing=false;
+            for(int i=0; i+3<=foldedQuery.size() && !missing; ++i)
+            {
+                quint32 trigram=trigramAt(foldedQuery.constData()+i);
+                const TrigramRecord *record=std::lower_bound(
+                            trigrams, trigrams+header->trigramCount, trigram,
+                            [](const TrigramRecord &record, quint32 value)
+                {
+                    return record.trigram<value;
+                });
+                if(record==trigrams+header->trigramCount ||
+                        record->trigram!=trigram)
+                {
+                    missing=true;
+                    break;
+                }
+                lists.append(qMakePair(postings+record->postingOffset,
+                                       record->postingCount));
+            }
+            if(!missing)
+            {
+                //Intersect from the shortest list.
+                std::sort(lists.begin(), lists.end(),
+                          [](const QPair<const quint32 *, quint32> &left,
+                             const QPair<const quint32 *, quint32> &right)
+                {
+                    return left.second<right.second;
+                });
+                QVector<quint32> candidates(lists.first().second),
+                                 intersection;
+                std::copy(lists.first().first,
+                          lists.first().first+lists.first().second,
+                          candidates.begin());
+                for(int i=1; i<lists.size() && !candidates.isEmpty(); ++i)
+                {
+                    intersection.resize(candidates.size());
+                    intersection.erase(
+                                std::set_intersection(
+                                    candidates.constBegin(),
+                                    candidates.constEnd(),
+                                    lists.at(i).first,
+                                    lists.at(i).first+lists.at(i).second,
+                                    intersection.begin()),
+                                intersection.end());
+                    candidates.swap(intersection);
+                }
+                //The trigrams don't keep the order, check the names.
+                for(quint32 entryId : candidates)
+                {
+                    checkEntry(entryId);
+                }
+            }
+        }
+    }
+    //Scan the delta.
+    int entryCount=(header==nullptr)?0:header->entryCount;
+    for(int i=0; i<m_delta.size(); ++i)
+    {
+        const DeltaEntry &deltaEntry=m_delta.at(i);
+        if(deltaEntry.removed)
+        {
+            continue;
+        }
+        int rank=matchRank(deltaEntry.foldedName.constData(),
+                           deltaEntry.foldedName.size(),
+                           foldedQuery);
+        if(rank!=-1)
+        {
+            SearchMatch match;
+            match.rank=rank;
+            match.nameLength=deltaEntry.foldedName.size();
+            match.depth=deltaEntry.path.count('/');
+            match.entryId=entryCount+i;
+            matches.append(match);
+        }
+    }
+    //Only the best results are sorted.
+    int resultCount=qMin(limit, matches.size());
+    std::partial_sort(matches.begin(), matches.begin()+resultCount,
+                      matches.end());
+    QVector<int> results;
+    results.reserve(resultCount);
+    for(int i=0; i<resultCount; ++i)
+    {
+        results.append(matches.at(i).entryId);
+    }
+    return results;
+}
+
+QString KNFileIndex::filePath(int entryId) const
+{
+    QReadLocker locker(&m_lock);
+    if(entryId<0)
+    {
+        return QString();
+    }
+    int entryCount=0;
+    if(m_data!=nullptr)
+    {
+        const IndexHeader *header=
+                reinterpret_cast<const IndexHeader *>(m_data);
+        entryCount=header->entryCount;
+        if(entryId<entryCount)
+        {
+            if(entryId==0 || isRemoved(entryId))
+            {
+                return QString();
+            }
+            const EntryRecord *entries=
+                    reinterpret_cast<const EntryRecord *>(
+                        m_data+sizeof(IndexHeader));
+            const char *names=reinterpret_cast<const char *>(m_data)+
+                    m_dataSize-header->nameSize;
+            //Join the names from the entry to the root.
+            QByteArray path;
+            for(quint32 current=entryId; current!=0 && current!=NoParent;
+                current=entries[current].parent)
+            {
+                const EntryRecord &entry=entries[current];
+                path.prepend(names+entry.nameOffset, entry.nameLength);
+                path.prepend('/');
+            }
+            return m_rootPath+QFile::decodeName(path);
+        }
+    }
+    int deltaIndex=entryId-entryCount;
+    if(deltaIndex>=m_delta.size() || m_delta.at(deltaIndex).removed)
+    {
+        return QString();
+    }
+    return m_rootPath+"/"+m_delta.at(deltaIndex).path;
+}
+
+void KNFileIndex::rebuild()
+{
+    m_rebuildTimer->stop();
+    m_pollTimer->stop();
+    int buildGeneration=m_generation.fetchAndAddOrdered(1)+1;
+    QString rootPath=m_rootPath;
+    int inotifyFd=m_inotifyFd;
+    QHash<int, QString> *watches=&m_watches;
+    QReadWriteLock *watchLock=&m_lock;
+    const QAtomicInt *generation=&m_generation;
+    //The previous builds might be still running, they are owned by the pool,
+    //so the index waits for all of them when it is deleted.
+    m_builder=QtConcurrent::run(m_buildPool, [=]()
+    {
+        BuildResult result=buildIndex(rootPath, inotifyFd, watches,
+                                      watchLock, generation,
+                                      buildGeneration);
+        QMetaObject::invokeMethod(this,
+                                  "onActionIndexBuilt",
+                                  Qt::QueuedConnection,
+                                  Q_ARG(int, buildGeneration));
+        return result;
+    });
+}
+
+void KNFileIndex::onActionIndexBuilt(int generation)
+{
+    //Ignore the index of a canceled build.
+    if(generation!=m_generation.loadAcquire())
+    {
+        return;
+    }
+    BuildResult result=m_builder.result();
+    if(result.data.isEmpty())
+    {
+        return;
+    }
+    //Some directories couldn't be watched, walk the tree again later.
+    if(!result.watchesComplete)
+    {
+        m_pollTimer->start();
+    }
+    //The check of the saved index reads the mapped file, it is always
+    //finished before the tree is walked.
+    m_cacheChecker.waitForFinished();
+    {
+        QWriteLocker locker(&m_lock);
+        //Map the saved index only when it is written by this build, so the
+        //index is shared by the page cache. If the file couldn't be saved,
+        //keep the index in memory. The built data is not checked again.
+        m_cacheFile.close();
+        m_cacheData=nullptr;
+        m_builtData.clear();
+        m_cacheFile.setFileName(cachePath(m_rootPath));
+        const uchar *cacheData=nullptr;
+        if(result.saved && m_cacheFile.open(QIODevice::ReadOnly) &&
+                m_cacheFile.size()==result.data.size())
+        {
+            cacheData=m_cacheFile.map(0, m_cacheFile.size());
+        }
+        if(cacheData!=nullptr)
+        {
+            setIndexData(cacheData, m_cacheFile.size());
+        }
+        else
+        {
+            m_cacheFile.close();
+            m_builtData=result.data;
+            setIndexData(reinterpret_cast<const uchar *>(
+                             m_builtData.constData()),
+                         m_builtData.size());
+        }
+        //The watches are added while walking, and the watches of the removed
+        //directories are removed by the kernel. Keep the changes which are
+        //happened during the walk.
+        QVector<DeltaEntry> delta;
+        QSet<QString> deltaPaths;
+        for(const DeltaEntry &deltaEntry : m_delta)
+        {
+            if(deltaEntry.removed)
+            {
+                continue;
+            }
+            deltaPaths.insert(deltaEntry.path);
+            if(findEntry(deltaEntry.path)==-1)
+            {
+                delta.append(deltaEntry);
+            }
+        }
+        m_delta=delta;
+        m_deltaRows.clear();
+        for(int i=0; i<m_delta.size(); ++i)
+        {
+            m_deltaRows.insert(m_delta.at(i).path, i);
+        }
+        m_removedEntries.clear();
+        QStringList removedPaths;
+        for(const QString &removedPath : m_removedPaths)
+        {
+            //The path which is created again after it is removed is kept.
+            int entryId=findEntry(removedPath);
+            if(entryId!=-1 && !deltaPaths.contains(removedPath))
+            {
+                m_removedEntries.insert(entryId);
+                removedPaths.append(removedPath);
+            }
+        }
+        m_removedPaths=removedPaths;
+        m_ready=true;
+    }
+    m_readyCondition.wakeAll();
+    emit indexUpdated();
+}
+
+void KNFileIndex::onActionCacheChecked(bool valid)
+{
+    //The saved index is replaced when a build is finished first.
+    if(m_cacheData==nullptr)
+    {
+        return;
+    }
+    if(!valid)
+    {
+        m_cacheData=nullptr;
+        m_cacheFile.close();
+        return;
+    }
+    {
+        QWriteLocker locker(&m_lock);
+        setIndexData(m_cacheData, m_cacheFile.size());
+    }
+    m_readyCondition.wakeAll();
+    emit indexUpdated();
+}
+
+void KNFileIndex::onActionInotifyActivated()
+{
+#ifdef Q_OS_LINUX
+    KN_TRACE_SCOPE("KNFileIndex::applyInotify");
+    alignas(inotify_event) char buffer[InotifyBufferSize];
+    bool changed=false, rescan=false;
+    ssize_t length;
+    while((length=::read(m_inotifyFd, buffer, sizeof(buffer)))>0)
+    {
+        for(char *position=buffer; position<buffer+length; )
+        {
+            const inotify_event *event=
+                    reinterpret_cast<const inotify_event *>(position);
+            position+=sizeof(inotify_event)+event->len;
+            //The queue is overflowed, the changes are lost.
+            if(event->mask & IN_Q_OVERFLOW)
+            {
+                rescan=true;
+                continue;
+            }
+            if(event->mask & IN_IGNORED)
+            {
+                QWriteLocker locker(&m_lock);
+                m_watches.remove(event->wd);
+                continue;
+            }
+            //The rest of the changes are found by walking the tree again.
+            if(rescan)
+            {
+                continue;
+            }
+            //Ignore the events of the hidden entries and the unknown
+            //watches, the walkers add the watches at the same time.
+            if(event->len==0 || event->name[0]=='.')
+            {
+                continue;
+            }
+            QString directoryPath;
+            {
+                QReadLocker locker(&m_lock);
+                QHash<int, QString>::const_iterator watch=
+                        m_watches.constFind(event->wd);
+                if(watch==m_watches.constEnd())
+                {
+                    continue;
+                }
+                directoryPath=watch.value();
+            }
+            QString relativePath=QFile::decodeName(event->name);
+            if(!directoryPath.isEmpty())
+            {
+                relativePath.prepend(directoryPath+"/");
+            }
+            if(event->mask & (IN_CREATE | IN_MOVED_TO))
+            {
+                //The children of a directory moved in are found by walking
+                //the tree again.
+                rescan=addDeltaEntry(relativePath, event->mask & IN_ISDIR) ||
+                        m_delta.size()>DeltaRebuildThreshold;
+                changed=true;
+            }
+            else if(event->mask & (IN_DELETE | IN_MOVED_FROM))
+            {
+                removePath(relativePath);
+                //The watches of a directory moved out keep the old paths
+                //until they are removed, walk the tree again.
+                if((event->mask & IN_MOVED_FROM) && (event->mask & IN_ISDIR))
+                {
+                    rescan=true;
+                }
+                changed=true;
+            }
+        }
+    }
+    if(rescan)
+    {
+        m_rebuildTimer->start();
+    }
+    if(changed)
+    {
+        emit indexUpdated();
+    }
+#endif
+}
+
+KNFileIndex::BuildResult KNFileIndex::buildIndex(const QString &rootPath,
+                                                 int inotifyFd,
+                                                 QHash<int, QString> *watches,
+                                                 QReadWriteLock *watchLock,
+                                                 const QAtomicInt *generation,
+                                                 int buildGeneration)
+{
+    KN_TRACE_SCOPE("KNFileIndex::buildIndex");
+    BuildResult result;
+    WatchTarget target;
+    target.inotifyFd=inotifyFd;
+    target.watches=watches;
+    target.lock=watchLock;
+    QVector<EntryRecord> entries;
+    QByteArray names;
+    //The entry 0 is the root.
+    appendEntry(entries, names, "", NoParent, true);
+    result.watchesComplete=watchDirectory(target, rootPath, QString());
+    //Read the root, the top level directories are walked in parallel.
+    QVector<quint32> topEntries;
+    QList<QFuture<LocalTree> > walkers;
+    KNDirectoryReader::read(rootPath, false,
+                            [&](const char *name, bool isDir, bool)
+    {
+        if(isDir)
+        {
+            QString topPath=QFile::decodeName(name);
+            topEntries.append(entries.size());
+            walkers.append(QtConcurrent::run(walkTree, rootPath, topPath,
+                                             target, generation,
+                                             buildGeneration));
+        }
+        appendEntry(entries, names, name, 0, isDir);
+        return true;
+    });
+    //Merge the trees, the local ids are moved after the entries.
+    for(int i=0; i<walkers.size(); ++i)
+    {
+        LocalTree tree=walkers[i].result();
+        quint32 entryBase=entries.size(), nameBase=names.size();
+        for(const EntryRecord &localEntry : tree.entries)
+        {
+            EntryRecord entry=localEntry;
+            entry.nameOffset+=nameBase;
+            entry.parent=(localEntry.parent==NoParent)?
+                        topEntries.at(i):localEntry.parent+entryBase;
+            entries.append(entry);
+        }
+        names.append(tree.names);
+        result.watchesComplete=result.watchesComplete && tree.watchesComplete;
+    }
+    if(generation->loadAcquire()!=buildGeneration)
+    {
+        return result;
+    }
+    //Collect the trigrams in parallel chunks, then merge the sorted chunks.
+    int chunkCount=qMax(1, QThread::idealThreadCount()),
+        chunkSize=(entries.size()+chunkCount-1)/chunkCount;
+    QList<QFuture<QVector<quint64> > > collectors;
+    for(int first=0; first<entries.size(); first+=chunkSize)
+    {
+        collectors.append(QtConcurrent::run(
+                              collectTrigrams,
+                              entries.constData(),
+                              names.constData(),
+                              first,
+                              qMin(first+chunkSize, entries.size())));
+    }
+    QVector<quint64> pairs, merged;
+    for(int i=0; i<collectors.size(); ++i)
+    {
+        QVector<quint64> chunk=collectors[i].result();
+        merged.resize(pairs.size()+chunk.size());
+        std::merge(pairs.constBegin(), pairs.constEnd(),
+                   chunk.constBegin(), chunk.constEnd(),
+                   merged.begin());
+        pairs.swap(merged);
+    }
+    //Group the pairs by the trigram.
+    QVector<TrigramRecord> trigrams;
+    QVector<quint32> postings;
+    postings.reserve(pairs.size());
+    for(quint64 pair : pairs)
+    {
+        quint32 trigram=pair>>32;
+        if(trigrams.isEmpty() || trigrams.last().trigram!=trigram)
+        {
+            TrigramRecord record;
+            record.trigram=trigram;
+            record.postingOffset=postings.size();
+            record.postingCount=0;
+            trigrams.append(record);
+        }
+        ++trigrams.last().postingCount;
+        postings.append((quint32)pair);
+    }
+    //Write the index.
+    IndexHeader header;
+    header.magic=IndexMagic;
+    header.version=IndexVersion;
+    header.entryCount=entries.size();
+    header.trigramCount=trigrams.size();
+    header.postingCount=postings.size();
+    header.nameSize=names.size();
+    result.data.reserve(sizeof(IndexHeader)+
+                        entries.size()*sizeof(EntryRecord)+
+                        trigrams.size()*sizeof(TrigramRecord)+
+                        postings.size()*sizeof(quint32)+
+                        names.size());
+    result.data.append(reinterpret_cast<const char *>(&header),
+                       sizeof(IndexHeader));
+    result.data.append(reinterpret_cast<const char *>(entries.constData()),
+                       entries.size()*sizeof(EntryRecord));
+    result.data.append(reinterpret_cast<const char *>(trigrams.constData()),
+                       trigrams.size()*sizeof(TrigramRecord));
+    result.data.append(reinterpret_cast<const char *>(postings.constData()),
+                       postings.size()*sizeof(quint32));
+    result.data.append(names);
+    //Save the index for the next launch. A canceled build doesn't replace the
+    //file, the generation is checked while the file is locked, so the file
+    //of a newer build is never replaced by an older build.
+    QDir().mkpath(QFileInfo(cachePath(rootPath)).absolutePath());
+    QSaveFile indexFile(cachePath(rootPath));
+    if(indexFile.open(QIODevice::WriteOnly) &&
+            indexFile.write(result.data)==result.data.size())
+    {
+        QMutexLocker cacheLocker(&cacheFileLock);
+        if(generation->loadAcquire()==buildGeneration)
+        {
+            result.saved=indexFile.commit();
+        }
+    }
+    return result;
+}
+
+QByteArray KNFileIndex::foldName(const QByteArray &name)
+{
+    QByteArray foldedName=name;
+    for(int i=0; i<foldedName.size(); ++i)
+    {
+        foldedName[i]=foldByte(foldedName.at(i));
+    }
+    return foldedName;
+}
+
+bool KNFileIndex::checkIndexData(const uchar *data, qint64 size)
+{
+    //Check the header and the sizes of the tables.
+    if(size<(qint64)sizeof(IndexHeader))
+    {
+        return false;
+    }
+    const IndexHeader *header=reinterpret_cast<const IndexHeader *>(data);
+    if(header->magic!=IndexMagic || header->version!=IndexVersion ||
+            header->entryCount==0 ||
+            (qint64)sizeof(IndexHeader)+
+            (qint64)header->entryCount*sizeof(EntryRecord)+
+            (qint64)header->trigramCount*sizeof(TrigramRecord)+
+            (qint64)header->postingCount*sizeof(quint32)+
+            (qint64)header->nameSize!=size)
+    {
+        return false;
+    }
+    //Check the ranges of the records.
+    const EntryRecord *entries=reinterpret_cast<const EntryRecord *>(
+                data+sizeof(IndexHeader));
+    for(quint32 i=0; i<header->entryCount; ++i)
+    {
+        const EntryRecord &entry=entries[i];
+        if((quint64)entry.nameOffset+entry.nameLength>header->nameSize ||
+                (i>0 && entry.parent>=i) ||
+                (i==0)!=(entry.parent==NoParent))
+        {
+            return false;
+        }
+    }
+    //The trigrams are searched by binary search, and the posting lists are
+    //intersected, they must be sorted, and the postings must be the entries.
+    const TrigramRecord *trigrams=reinterpret_cast<const TrigramRecord *>(
+                entries+header->entryCount);
+    const quint32 *postings=reinterpret_cast<const quint32 *>(
+                trigrams+header->trigramCount);
+    for(quint32 i=0; i<header->trigramCount; ++i)
+    {
+        const TrigramRecord &record=trigrams[i];
+        if((i>0 && record.trigram<=trigrams[i-1].trigram) ||
+                (quint64)record.postingOffset+record.postingCount>
+                header->postingCount)
+        {
+            return false;
+        }
+        const quint32 *posting=postings+record.postingOffset;
+        for(quint32 j=0; j<record.postingCount; ++j)
+        {
+            if(posting[j]>=header->entryCount ||
+                    (j>0 && posting[j]<=posting[j-1]))
+            {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+inline void KNFileIndex::setIndexData(const uchar *data, qint64 size)
+{
+    m_data=data;
+    m_dataSize=size;
+    m_ready=true;
+}
+
+QString KNFileIndex::cachePath(const QString &rootPath)
+{
+    return QStandardPaths::writableLocation(
+                QStandardPaths::GenericCacheLocation)+
+            "/kreogist/fileindex/"+
+            QCryptographicHash::hash(rootPath.toUtf8(),
+                                     QCryptographicHash::Sha1).toHex()+
+            ".bin";
+}
+
+inline int KNFileIndex::findEntry(const QString &relativePath) const
+{
+    if(m_data==nullptr)
+    {
+        return -1;
+    }
+    const IndexHeader *header=reinterpret_cast<const IndexHeader *>(m_data);
+    const EntryRecord *entries=reinterpret_cast<const EntryRecord *>(
+                m_data+sizeof(IndexHeader));
+    const TrigramRecord *trigrams=reinterpret_cast<const TrigramRecord *>(
+                entries+header->entryCount);
+    const quint32 *postings=reinterpret_cast<const quint32 *>(
+                trigrams+header->trigramCount);
+    const char *names=reinterpret_cast<const char *>(m_data)+m_dataSize-
+            header->nameSize;
+    //Find the children one level after another.
+    quint32 current=0;
+    for(const QString &component : relativePath.split('/',
+                                                      QString::SkipEmptyParts))
+    {
+        QByteArray name=QFile::encodeName(component);
+        auto isChild=[&](quint32 entryId)
+        {
+            const EntryRecord &entry=entries[entryId];
+            return entry.parent==current &&
+                    entry.nameLength==name.size() &&
+                    memcmp(names+entry.nameOffset,
+                           name.constData(),
+                           name.size())==0;
+        };
+        int child=-1;
+        if(name.size()>=3)
+        {
+            //Only check the entries having the first trigram of the name.
+            quint32 trigram=trigramAt(name.constData());
+            const TrigramRecord *record=std::lower_bound(
+                        trigrams, trigrams+header->trigramCount, trigram,
+                        [](const TrigramRecord &record, quint32 value)
+            {
+                return record.trigram<value;
+            });
+            if(record!=trigrams+header->trigramCount &&
+                    record->trigram==trigram)
+            {
+                //The entries of a directory are always after the directory.
+                const quint32 *postingEnd=
+                        postings+record->postingOffset+record->postingCount;
+                for(const quint32 *posting=std::upper_bound(
+                        postings+record->postingOffset, postingEnd, current);
+                    posting<postingEnd; ++posting)
+                {
+                    if(isChild(*posting))
+                    {
+                        child=*posting;
+                        break;
+                    }
+                }
+            }
+        }
+        else
+        {
+            for(quint32 i=current+1; i<header->entryCount; ++i)
+            {
+                if(isChild(i))
+                {
+                    child=i;
+                    break;
+                }
+            }
+        }
+        if(child==-1)
+        {
+            return -1;
+        }
+        current=child;
+    }
+    return current;
+}
+
+inline bool KNFileIndex::isRemoved(int entryId) const
+{
+    if(m_removedEntries.isEmpty())
+    {
+        return false;
+    }
+    //An entry is removed with its directory.
+    const EntryRecord *entries=reinterpret_cast<const EntryRecord *>(
+                m_data+sizeof(IndexHeader));
+    for(quint32 current=entryId; current!=NoParent;
+        current=entries[current].parent)
+    {
+        if(m_removedEntries.contains(current))
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+inline bool KNFileIndex::addDeltaEntry(const QString &relativePath,
+                                       bool isDir)
+{
+    {
+        QWriteLocker locker(&m_lock);
+        //Skip the entry which is already indexed.
+        int entryId=findEntry(relativePath);
+        bool indexed=(entryId!=-1 && !isRemoved(entryId)) ||
+                m_deltaRows.contains(relativePath);
+        //An entry created again after it is removed is added to the delta,
+        //the children of the removed entry are not back.
+        if(!indexed)
+        {
+            DeltaEntry deltaEntry;
+            deltaEntry.path=relativePath;
+            deltaEntry.foldedName=foldName(QFile::encodeName(
+                                               relativePath.mid(
+                                                   relativePath.lastIndexOf(
+                                                       '/')+1)));
+            deltaEntry.removed=false;
+            m_deltaRows.insert(relativePath, m_delta.size());
+            m_delta.append(deltaEntry);
+        }
+    }
+    if(!isDir)
+    {
+        return false;
+    }
+    //Watch the directory. A directory could be moved in with its children,
+    //only check whether it has any child, the tree is not walked here.
+    addWatch(relativePath);
+    bool hasChildren=false;
+    KNDirectoryReader::read(m_rootPath+"/"+relativePath, false,
+                            [&](const char *, bool, bool)
+    {
+        hasChildren=true;
+        return false;
+    });
+    return hasChildren;
+}
+
+inline void KNFileIndex::removePath(const QString &relativePath)
+{
+    QWriteLocker locker(&m_lock);
+    int entryId=findEntry(relativePath);
+    if(entryId!=-1 && !m_removedEntries.contains(entryId))
+    {
+        m_removedEntries.insert(entryId);
+        m_removedPaths.append(relativePath);
+    }
+    //Remove the delta entries of the path and its children.
+    QString childPrefix=relativePath+"/";
+    for(DeltaEntry &deltaEntry : m_delta)
+    {
+        if(!deltaEntry.removed &&
+                (deltaEntry.path==relativePath ||
+                 deltaEntry.path.startsWith(childPrefix)))
+        {
+            deltaEntry.removed=true;
+            m_deltaRows.remove(deltaEntry.path);
+        }
+    }
+}
+
+inline void KNFileIndex::addWatch(const QString &relativePath)
+{
+    WatchTarget target;
+    target.inotifyFd=m_inotifyFd;
+    target.watches=&m_watches;
+    target.lock=&m_lock;
+    if(!watchDirectory(target, m_rootPath+"/"+relativePath, relativePath) &&
+            !m_pollTimer->isActive())
+    {
+        m_pollTimer->start();
+    }
+}
@@ -0,0 +1,179 @@
+/*
+ * Copyright (C) Kreogist Dev Team
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#ifndef KNFILEINDEX_H
+#define KNFILEINDEX_H
+
+#include <QFile>
+#include <QFuture>
+#include <QHash>
+#include <QObject>
+#include <QReadWriteLock>
+#include <QSet>
+#include <QSharedPointer>
+#include <QStringList>
+#include <QVector>
+#include <QWaitCondition>
+
+class QSocketNotifier;
+class QThreadPool;
+class QTimer;
+/*!
+ * \brief The KNFileIndex is a trigram index of all the file names under a root
+ * directory, it finds the files by a part of their names without walking the
+ * tree.\n
+ * The tree is walked in parallel, one task for each top level directory. The
+ * index is saved in a memory mappable file under the user cache directory, a
+ * saved index is mapped at once and rebuilt in the background.\n
+ * The directories are watched with inotify on Linux, the created and removed
+ * entries are kept in a small delta beside the mapped index until the next
+ * rebuild. When the directories couldn't all be watched, the tree is walked
+ * again periodically.\n
+ * search() and filePath() could be called from any thread.
+ */
+class KNFileIndex : public QObject
+{
+    Q_OBJECT
+public:
+    /*!
+     * \brief Get the shared index of a root directory. The index is shared
+     * while it is referenced, and deleted after the last reference is
+     * released. It must be called on the main thread.
+     * \param rootPath The root directory path.
+     * \return The index of the root.
+     */
+    static QSharedPointer<KNFileIndex> index(const QString &rootPath);
+
+    ~KNFileIndex();
+
+    /*!
+     * \brief Get the root directory of the index.
+     * \return The root directory path.
+     */
+    QString rootPath() const;
+
+    /*!
+     * \brief Get whether the index could be searched. A saved index is ready
+     * at once, a new index is ready after the tree is walked.
+     * \return If the index is ready, return true.
+     */
+    bool isReady() const;
+
+    /*!
+     * \brief Block until the index is ready or the time is out.
+     * \param msecs The maximum waiting time in milliseconds.
+     * \return If the index is ready, return true.
+     */
+    bool waitForReady(int msecs) const;
+
+    /*!
+     * \brief Find the entries whose names contain the query, case-insensitive
+     * for the ASCII characters. The exact names rank first, then the names
+     * starting with the query, the shorter names and the shallower paths.
+     * \param query The query text.
+     * \param limit The maximum number of the results.
+     * \return The entry ids of the results, the ids are valid until the index
+     * is updated.
+     */
+    QVector<int> search(const QString &query, int limit) const;
+
+    /*!
+     * \brief Get the absolute path of an entry.
+     * \param entryId The entry id.
+     * \return The file path. If the entry doesn't exist, return an empty
+     * string.
+     */
+    QString filePath(int entryId) const;
+
+signals:
+    /*!
+     * \brief When the index is built, loaded or changed, this signal will be
+     * emitted. The ids of the previous results are invalid.
+     */
+    void indexUpdated();
+
+public slots:
+    /*!
+     * \brief Walk the tree again in the background, the current index is
+     * searched until the new index is ready.
+     */
+    void rebuild();
+
+private slots:
+    void onActionIndexBuilt(int generation);
+    void onActionCacheChecked(bool valid);
+    void onActionInotifyActivated();
+
+private:
+    struct BuildResult
+    {
+        QByteArray data;
+        bool watchesComplete;
+        bool saved;
+        BuildResult() :
+            watchesComplete(true),
+            saved(false)
+        {
+        }
+    };
+    struct DeltaEntry
+    {
+        QString path;
+        QByteArray foldedName;
+        bool removed;
+    };
+    explicit KNFileIndex(const QString &rootPath, QObject *parent = 0);
+    static BuildResult buildIndex(const QString &rootPath, int inotifyFd,
+                                  QHash<int, QString> *watches,
+                                  QReadWriteLock *watchLock,
+                                  const QAtomicInt *generation,
+                                  int buildGeneration);
+    static QByteArray foldName(const QByteArray &name);
+    static bool checkIndexData(const uchar *data, qint64 size);
+    inline void setIndexData(const uchar *data, qint64 size);
+    static QString cachePath(const QString &rootPath);
+    inline int findEntry(const QString &relativePath) const;
+    inline bool isRemoved(int entryId) const;
+    inline bool addDeltaEntry(const QString &relativePath, bool isDir);
+    inline void removePath(const QString &relativePath);
+    inline void addWatch(const QString &relativePath);
+    static QHash<QString, QWeakPointer<KNFileIndex> > m_indexes;
+    QString m_rootPath;
+    QFile m_cacheFile;
+    QByteArray m_builtData;
+    const uchar *m_cacheData;
+    const uchar *m_data;
+    qint64 m_dataSize;
+    QHash<int, QString> m_watches;
+    QVector<DeltaEntry> m_delta;
+    QHash<QString, int> m_deltaRows;
+    QStringList m_removedPaths;
+    QSet<int> m_removedEntries;
+    QFuture<BuildResult> m_builder;
+    QFuture<void> m_cacheChecker;
+    QThreadPool *m_buildPool;
+    QAtomicInt m_generation;
+    mutable QReadWriteLock m_lock;
+    mutable QWaitCondition m_readyCondition;
+    QSocketNotifier *m_inotifyNotifier;
+    QTimer *m_rebuildTimer, *m_pollTimer;
+    int m_inotifyFd;
+    bool m_ready;
+};
+
+#endif // KNFILEINDEX_H
@@ -0,0 +1,879 @@
+/*
+ * Copyright (C) Kreogist Dev Team
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+#include <QDateTime>
+#include <QDir>
+#include <QFileIconProvider>
+#include <QFileInfo>
+#include <QFileSystemWatcher>
+#include <QLocale>
+#include <QSocketNotifier>
+#include <QThreadPool>
+#include <QTimer>
+#include <QtConcurrent/QtConcurrent>
+
+#include <algorithm>
+
+#ifdef Q_OS_LINUX
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+#include "kndirectoryreader.h"
+#include "kntrace.h"
+
+#include "knfilesystemmodel.h"
+
+//The first batch is small so the first rows appear at once, the later
+//batches grow up to the maximum batch size.
+#define FirstBatchSize 64
+#define MaxBatchSize 4096
+//The size of the inotify event buffer.
+#define InotifyBufferSize 65536
+//The number of the entries stated in one batch.
+#define StatBatchSize 256
+//The number of the threads stating the entries.
+#define StatThreadCount 2
+//The number of the removed row ranges, above which the model is reset
+//instead of removing the ranges one by one.
+#define RemoveRangeThreshold 32
+
+KNFileSystemModel::KNFileSystemModel(QObject *parent) :
+    QAbstractTableModel(parent),
+    m_generation(0),
+    m_listPool(new QThreadPool(this)),
+    m_statPool(new QThreadPool(this)),
+    m_statTimer(new QTimer(this)),
+    m_sortTimer(new QTimer(this)),
+    m_inotifyNotifier(nullptr),
+    m_directoryWatcher(nullptr),
+    m_inotifyFd(-1),
+    m_inotifyWatch(-1),
+    m_sortedCount(0),
+    m_sortColumn(-1),
+    m_sortOrder(Qt::AscendingOrder),
+    m_loading(false),
+    m_showHidden(false)
+{
+    qRegisterMetaType<KNFileEntryList>("KNFileEntryList");
+    m_statPool->setMaxThreadCount(StatThreadCount);
+    //The stat requests of the painted rows are sent together.
+    m_statTimer->setSingleShot(true);
+    m_statTimer->setInterval(0);
+    connect(m_statTimer, &QTimer::timeout,
+            this, &KNFileSystemModel::onActionFlushStatRequests);
+    //All the batches arrived in one event loop iteration are sorted once.
+    m_sortTimer->setSingleShot(true);
+    m_sortTimer->setInterval(0);
+    connect(m_sortTimer, &QTimer::timeout,
+            this, &KNFileSystemModel::onActionSortEntries);
+#ifdef Q_OS_LINUX
+    //Watch the directory with inotify.
+    m_inotifyFd=inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if(m_inotifyFd!=-1)
+    {
+        m_inotifyNotifier=new QSocketNotifier(m_inotifyFd,
+                                              QSocketNotifier::Read,
+                                              this);
+        connect(m_inotifyNotifier, &QSocketNotifier::activated,
+                this, &KNFileSystemModel::onActionInotifyActivated);
+    }
+#endif
+    //List the directory again when it is changed.
+    if(m_inotifyNotifier==nullptr)
+    {
+        m_directoryWatcher=new QFileSystemWatcher(this);
+        connect(m_directoryWatcher, &QFileSystemWatcher::directoryChanged,
+                this, &KNFileSystemModel::refresh);
+    }
+}
+
+KNFileSystemModel::~KNFileSystemModel()
+{
+    //Stop the workers, they check the generation for every batch.
+    m_generation.fetchAndAddOrdered(1);
+    m_listPool->clear();
+    m_listPool->waitForDone();
+    m_statPool->clear();
+    m_statPool->waitForDone();
+#ifdef Q_OS_LINUX
+    if(m_inotifyFd!=-1)
+    {
+        ::close(m_inotifyFd);
+    }
+#endif
+}
+
+int KNFileSystemModel::rowCount(const QModelIndex &parent) const
+{
+    //Table model doesn't have any child.
+    return parent.isValid()?0:m_entries.size();
+}
+
+int KNFileSystemModel::columnCount(const QModelIndex &parent) const
+{
+    return parent.isValid()?0:ColumnCount;
+}
+
+QVariant KNFileSystemModel::data(const QModelIndex &index, int role) const
+{
+    if(!index.isValid())
+    {
+        return QVariant();
+    }
+    const KNFileEntry &fileEntry=m_entries.at(index.row());
+    switch(role)
+    {
+    case Qt::DisplayRole:
+        switch(index.column())
+        {
+        case NameColumn:
+            return fileEntry.name;
+        case SizeColumn:
+            //Load the size when the row is shown.
+            if(!fileEntry.stated)
+            {
+                requestStat(index.row());
+                return QVariant();
+            }
+            return fileEntry.isDir?QVariant():
+                                   QVariant(QLocale().toString(fileEntry.size));
+        case ModifiedColumn:
+            if(!fileEntry.stated)
+            {
+                requestStat(index.row());
+                return QVariant();
+            }
+            return QDateTime::fromMSecsSinceEpoch(fileEntry.modified);
+        default:
+            return QVariant();
+        }
+    case Qt::DecorationRole:
+    {
+        if(index.column()!=NameColumn)
+        {
+            return QVariant();
+        }
+        //The type of a link is known after it is stated.
+        if(fileEntry.isSymLink && !fileEntry.stated)
+        {
+            requestStat(index.row());
+        }
+        static QFileIconProvider iconProvider;
+        return iconProvider.icon(fileEntry.isDir?QFileIconProvider::Folder:
+                                                 QFileIconProvider::File);
+    }
+    case Qt::TextAlignmentRole:
+        return index.column()==SizeColumn?
+                    QVariant(Qt::AlignRight | Qt::AlignVCenter):QVariant();
+    default:
+        return QVariant();
+    }
+}
+
+QVariant KNFileSystemModel::headerData(int section,
+                                       Qt::Orientation orientation,
+                                       int role) const
+{
+    if(orientation!=Qt::Horizontal || role!=Qt::DisplayRole)
+    {
+        return QVariant();
+    }
+    switch(section)
+    {
+    case NameColumn:
+        return tr("Name");
+    case SizeColumn:
+        return tr("Size");
+    case ModifiedColumn:
+        return tr("Modified");
+    default:
+        return QVariant();
+    }
+}
+
+void KNFileSystemModel::sort(int column, Qt::SortOrder order)
+{
+    m_sortColumn=column;
+    m_sortOrder=order;
+    //All the rows are sorted again.
+    m_sortedCount=0;
+    m_unsortedNames.clear();
+    if(column==-1)
+    {
+        return;
+    }
+    //Load the size and the modified time of all the entries.
+    if(column!=NameColumn)
+    {
+        for(int i=0; i<m_entries.size(); ++i)
+        {
+            if(!m_entries.at(i).stated)
+            {
+                requestStat(i);
+            }
+        }
+    }
+    onActionSortEntries();
+}
+
+QString KNFileSystemModel::rootPath() const
+{
+    return m_rootPath;
+}
+
+KNFileEntry KNFileSystemModel::entry(int row) const
+{
+    return m_entries.at(row);
+}
+
+QString KNFileSystemModel::filePath(const QModelIndex &index) const
+{
+    if(!index.isValid())
+    {
+        return m_rootPath;
+    }
+    return QDir(m_rootPath).filePath(m_entries.at(index.row()).name);
+}
+
+int KNFileSystemModel::rowOf(const QString &name) const
+{
+    return m_rows.value(name, -1);
+}
+
+bool KNFileSystemModel::isLoading() const
+{
+    return m_loading;
+}
+
+bool KNFileSystemModel::showHidden() const
+{
+    return m_showHidden;
+}
+
+void KNFileSystemModel::setShowHidden(bool showHidden)
+{
+    if(m_showHidden==showHidden)
+    {
+        return;
+    }
+    m_showHidden=showHidden;
+    refresh();
+}
+
+void KNFileSystemModel::setRootPath(const QString &path)
+{
+    KN_TRACE_SCOPE("KNFileSystemModel::setRootPath");
+    //Abandon the previous listing and the stat requests.
+    int generation=m_generation.fetchAndAddOrdered(1)+1;
+    m_statPool->clear();
+    m_statTimer->stop();
+    m_sortTimer->stop();
+    m_statPending.clear();
+    m_statQueue.clear();
+    m_removedNames.clear();
+    m_unsortedNames.clear();
+    //Clear the model, the entries will be appended in batches.
+    beginResetModel();
+    m_entries.clear();
+    m_sortKeys.clear();
+    m_rows.clear();
+    m_sortedCount=0;
+    m_rootPath=QDir::cleanPath(path);
+    endResetModel();
+    //Start watching before listing, so no change is missed.
+    watchDirectory(m_rootPath);
+    m_loading=true;
+    //The previous listers might be still running, they are owned by the pool,
+    //so the model waits for all of them when it is deleted.
+    QtConcurrent::run(m_listPool,
+                      &KNFileSystemModel::listEntries,
+                      this,
+                      m_rootPath,
+                      m_showHidden,
+                      generation);
+    emit rootPathChanged(m_rootPath);
+}
+
+void KNFileSystemModel::refresh()
+{
+    setRootPath(m_rootPath);
+}
+
+void KNFileSystemModel::onActionEntriesListed(int generation,
+                                              const KNFileEntryList &entries)
+{
+    //Ignore the batches of the abandoned listing.
+    if(generation!=m_generation.loadAcquire())
+    {
+        return;
+    }
+    appendEntries(entries);
+}
+
+void KNFileSystemModel::onActionListFinished(int generation)
+{
+    if(generation!=m_generation.loadAcquire())
+    {
+        return;
+    }
+    m_loading=false;
+    m_removedNames.clear();
+    emit directoryLoaded(m_rootPath);
+}
+
+void KNFileSystemModel::onActionEntriesStated(int generation,
+                                              const KNFileEntryList &entries)
+{
+    if(generation!=m_generation.loadAcquire())
+    {
+        return;
+    }
+    //Update the stated rows, and notify the changed range once.
+    int firstRow=-1, lastRow=-1;
+    for(const KNFileEntry &statedEntry:entries)
+    {
+        m_statPending.remove(statedEntry.name);
+        int row=m_rows.value(statedEntry.name, -1);
+        if(row==-1)
+        {
+            continue;
+        }
+        KNFileEntry &fileEntry=m_entries[row];
+        //The stated values change the order of the size and time columns,
+        //the type changes the order of all the columns.
+        if(m_sortColumn==SizeColumn || m_sortColumn==ModifiedColumn ||
+                (m_sortColumn!=-1 && fileEntry.isDir!=statedEntry.isDir))
+        {
+            m_unsortedNames.insert(statedEntry.name);
+        }
+        fileEntry.size=statedEntry.size;
+        fileEntry.modified=statedEntry.modified;
+        fileEntry.isDir=statedEntry.isDir;
+        fileEntry.stated=true;
+        firstRow=(firstRow==-1)?row:qMin(firstRow, row);
+        lastRow=qMax(lastRow, row);
+    }
+    if(firstRow!=-1)
+    {
+        emit dataChanged(index(firstRow, 0), index(lastRow, ColumnCount-1));
+    }
+    //Move the changed rows to their sorted places.
+    if(!m_unsortedNames.isEmpty())
+    {
+        scheduleSort();
+    }
+}
+
+void KNFileSystemModel::onActionFlushStatRequests()
+{
+    if(m_statQueue.isEmpty())
+    {
+        return;
+    }
+    //Send the requests to the worker in batches.
+    int generation=m_generation.loadAcquire();
+    for(int i=0; i<m_statQueue.size(); i+=StatBatchSize)
+    {
+        QtConcurrent::run(m_statPool,
+                          &KNFileSystemModel::statEntries,
+                          this,
+                          m_rootPath,
+                          m_statQueue.mid(i, StatBatchSize),
+                          generation);
+    }
+    m_statQueue.clear();
+}
+
+void KNFileSystemModel::onActionSortEntries()
+{
+    KN_TRACE_SCOPE("KNFileSystemModel::sortEntries");
+    m_sortTimer->stop();
+    if(m_sortColumn==-1 || m_entries.isEmpty() ||
+            (m_sortedCount==m_entries.size() && m_unsortedNames.isEmpty()))
+    {
+        return;
+    }
+    emit layoutAboutToBeChanged(QList<QPersistentModelIndex>(),
+                                QAbstractItemModel::VerticalSortHint);
+    //The rows before the sorted count are already sorted, except the changed
+    //rows. Keep the order of the sorted rows, only sort the new and the
+    //changed rows, then merge them into the sorted rows.
+    QVector<int> sortedRows;
+    sortedRows.reserve(m_entries.size());
+    QVector<int> changedRows;
+    for(const QString &name:m_unsortedNames)
+    {
+        int row=m_rows.value(name, -1);
+        if(row!=-1 && row<m_sortedCount)
+        {
+            changedRows.append(row);
+        }
+    }
+    std::sort(changedRows.begin(), changedRows.end());
+    for(int i=0, j=0; i<m_sortedCount; ++i)
+    {
+        if(j<changedRows.size() && changedRows.at(j)==i)
+        {
+            ++j;
+            continue;
+        }
+        sortedRows.append(i);
+    }
+    int mergeStart=sortedRows.size();
+    sortedRows+=changedRows;
+    for(int i=m_sortedCount; i<m_entries.size(); ++i)
+    {
+        sortedRows.append(i);
+    }
+    auto rowLess=[this](int left, int right)
+    {
+        return lessThan(left, right);
+    };
+    std::stable_sort(sortedRows.begin()+mergeStart, sortedRows.end(),
+                     rowLess);
+    std::inplace_merge(sortedRows.begin(),
+                       sortedRows.begin()+mergeStart,
+                       sortedRows.end(),
+                       rowLess);
+    //Move the entries and their keys by the sorted rows.
+    KNFileEntryList sortedEntries;
+    sortedEntries.reserve(m_entries.size());
+    QVector<QCollatorSortKey> sortedKeys;
+    sortedKeys.reserve(m_sortKeys.size());
+    QVector<int> newRows(m_entries.size());
+    for(int i=0; i<sortedRows.size(); ++i)
+    {
+        sortedEntries.append(m_entries.at(sortedRows.at(i)));
+        sortedKeys.append(m_sortKeys.at(sortedRows.at(i)));
+        newRows[sortedRows.at(i)]=i;
+        m_rows.insert(sortedEntries.last().name, i);
+    }
+    m_entries=sortedEntries;
+    m_sortKeys=sortedKeys;
+    m_sortedCount=m_entries.size();
+    m_unsortedNames.clear();
+    //Move the persistent indexes, e.g. the current index of the view.
+    QModelIndexList persistentIndexes=persistentIndexList();
+    for(const QModelIndex &persistentIndex:persistentIndexes)
+    {
+        changePersistentIndex(persistentIndex,
+                              index(newRows.at(persistentIndex.row()),
+                                    persistentIndex.column()));
+    }
+    emit layoutChanged(QList<QPersistentModelIndex>(),
+                       QAbstractItemModel::VerticalSortHint);
+}
+
+void KNFileSystemModel::onActionInotifyActivated()
+{
+#ifdef Q_OS_LINUX
+    KN_TRACE_SCOPE("KNFileSystemModel::applyInotify");
+    //Read all the pending events, the changes are applied in order, the
+    //adjacent events of the same kind are applied together as one batch, the
+    //removed rows of a batch are removed in contiguous ranges.
+    alignas(inotify_event) char buffer[InotifyBufferSize];
+    KNFileEntryList addedEntries;
+    QStringList removedNames, changedNames;
+    bool rescan=false;
+    ssize_t length;
+    while((length=::read(m_inotifyFd, buffer, sizeof(buffer)))>0)
+    {
+        for(char *position=buffer; position<buffer+length; )
+        {
+            const inotify_event *event=
+                    reinterpret_cast<const inotify_event *>(position);
+            position+=sizeof(inotify_event)+event->len;
+            //The queue is overflowed, the changes are lost.
+            if(event->mask & IN_Q_OVERFLOW)
+            {
+                rescan=true;
+                continue;
+            }
+            //Ignore the events of the previous directory.
+            if(event->wd!=m_inotifyWatch)
+            {
+                continue;
+            }
+            //The directory itself is moved or deleted.
+            if(event->mask & (IN_DELETE_SELF | IN_MOVE_SELF))
+            {
+                rescan=true;
+                continue;
+            }
+            if(event->len==0)
+            {
+                continue;
+            }
+            QString name=QFile::decodeName(event->name);
+            if(!m_showHidden && name.startsWith('.'))
+            {
+                continue;
+            }
+            if(event->mask & (IN_CREATE | IN_MOVED_TO))
+            {
+                //Apply the removes before this add.
+                if(!removedNames.isEmpty())
+                {
+                    removeEntries(removedNames);
+                    removedNames.clear();
+                }
+                KNFileEntry fileEntry;
+                fileEntry.name=name;
+                fileEntry.isDir=(event->mask & IN_ISDIR);
+                addedEntries.append(fileEntry);
+            }
+            else if(event->mask & (IN_DELETE | IN_MOVED_FROM))
+            {
+                //Apply the adds before this remove.
+                if(!addedEntries.isEmpty())
+                {
+                    appendEntries(addedEntries);
+                    addedEntries.clear();
+                }
+                removedNames.append(name);
+            }
+            else if(event->mask & (IN_ATTRIB | IN_CLOSE_WRITE))
+            {
+                changedNames.append(name);
+            }
+        }
+    }
+    if(rescan)
+    {
+        refresh();
+        return;
+    }
+    appendEntries(addedEntries);
+    removeEntries(removedNames);
+    invalidateEntries(changedNames);
+#endif
+}
+
+void KNFileSystemModel::listEntries(KNFileSystemModel *model,
+                                    const QString &path,
+                                    bool showHidden,
+                                    int generation)
+{
+    KN_TRACE_SCOPE("KNFileSystemModel::listEntries");
+    KNFileEntryList batch;
+    int batchSize=FirstBatchSize;
+    batch.reserve(batchSize);
+    //Send the batch to the model, the next batch is larger.
+    auto sendBatch=[&]()
+    {
+        QMetaObject::invokeMethod(model,
+                                  "onActionEntriesListed",
+                                  Qt::QueuedConnection,
+                                  Q_ARG(int, generation),
+                                  Q_ARG(KNFileEntryList, batch));
+        batch.clear();
+        batchSize=qMin(batchSize*4, MaxBatchSize);
+        batch.reserve(batchSize);
+    };
+    KNDirectoryReader::read(
+                path,
+                showHidden,
+                [&](const char *name, bool isDir, bool isSymLink)
+                {
+                    KNFileEntry fileEntry;
+                    fileEntry.name=QFile::decodeName(name);
+                    fileEntry.isDir=isDir;
+                    //The type of the link is known after the entry is stated.
+                    fileEntry.isSymLink=isSymLink;
+                    batch.append(fileEntry);
+                    if(batch.size()>=batchSize)
+                    {
+                        sendBatch();
+                    }
+                    //Stop when the directory is changed.
+                    return model->m_generation.loadAcquire()==generation;
+                });
+    //Send the rest entries.
+    if(!batch.isEmpty())
+    {
+        sendBatch();
+    }
+    QMetaObject::invokeMethod(model,
+                              "onActionListFinished",
+                              Qt::QueuedConnection,
+                              Q_ARG(int, generation));
+}
+
+void KNFileSystemModel::statEntries(KNFileSystemModel *model,
+                                    const QString &path,
+                                    const QStringList &names,
+                                    int generation)
+{
+    KNFileEntryList statedEntries;
+    statedEntries.reserve(names.size());
+    QDir directory(path);
+    for(const QString &name:names)
+    {
+        //Stop when the directory is changed.
+        if(model->m_generation.loadAcquire()!=generation)
+        {
+            return;
+        }
+        QFileInfo fileInfo(directory.filePath(name));
+        KNFileEntry statedEntry;
+        statedEntry.name=name;
+        statedEntry.size=fileInfo.size();
+        statedEntry.modified=fileInfo.lastModified().toMSecsSinceEpoch();
+        statedEntry.isDir=fileInfo.isDir();
+        statedEntry.stated=true;
+        statedEntries.append(statedEntry);
+    }
+    QMetaObject::invokeMethod(model,
+                              "onActionEntriesStated",
+                              Qt::QueuedConnection,
+                              Q_ARG(int, generation),
+                              Q_ARG(KNFileEntryList, statedEntries));
+}
+
+inline void KNFileSystemModel::requestStat(int row) const
+{
+    //Queue the entry once, the requests are sent at the next event loop.
+    const QString &name=m_entries.at(row).name;
+    if(m_statPending.contains(name))
+    {
+        return;
+    }
+    m_statPending.insert(name);
+    m_statQueue.append(name);
+    if(!m_statTimer->isActive())
+    {
+        m_statTimer->start();
+    }
+}
+
+inline void KNFileSystemModel::appendEntries(const KNFileEntryList &entries)
+{
+    //Skip the entries which are already listed, or removed while the
+    //directory was being listed.
+    KNFileEntryList newEntries;
+    newEntries.reserve(entries.size());
+    for(const KNFileEntry &fileEntry:entries)
+    {
+        if(!m_rows.contains(fileEntry.name) &&
+                !m_removedNames.contains(fileEntry.name))
+        {
+            newEntries.append(fileEntry);
+        }
+        else
+        {
+            //The entry is created again after it was removed.
+            m_removedNames.remove(fileEntry.name);
+        }
+    }
+    if(newEntries.isEmpty())
+    {
+        return;
+    }
+    //Insert the whole batch at once.
+    beginInsertRows(QModelIndex(),
+                    m_entries.size(),
+                    m_entries.size()+newEntries.size()-1);
+    m_sortKeys.reserve(m_sortKeys.size()+newEntries.size());
+    for(const KNFileEntry &fileEntry:newEntries)
+    {
+        m_rows.insert(fileEntry.name, m_entries.size());
+        m_entries.append(fileEntry);
+        //The key is only computed once, the sort compares the keys.
+        m_sortKeys.append(m_collator.sortKey(fileEntry.name));
+    }
+    endInsertRows();
+    //Merge the new rows into their sorted places.
+    if(m_sortColumn!=-1)
+    {
+        scheduleSort();
+    }
+}
+
+inline void KNFileSystemModel::removeEntries(const QStringList &names)
+{
+    QVector<int> removedRows;
+    removedRows.reserve(names.size());
+    for(const QString &name:names)
+    {
+        int row=m_rows.value(name, -1);
+        if(row!=-1)
+        {
+            removedRows.append(row);
+        }
+        //The removed entry may be in a batch which hasn't arrived.
+        else if(m_loading)
+        {
+            m_removedNames.insert(name);
+        }
+    }
+    if(removedRows.isEmpty())
+    {
+        return;
+    }
+    std::sort(removedRows.begin(), removedRows.end());
+    removedRows.erase(std::unique(removedRows.begin(), removedRows.end()),
+                      removedRows.end());
+    //Group the removed rows into the ranges of the contiguous rows.
+    QVector<QPair<int, int>> ranges;
+    for(int row:removedRows)
+    {
+        if(!ranges.isEmpty() && ranges.last().second+1==row)
+        {
+            ranges.last().second=row;
+        }
+        else
+        {
+            ranges.append(qMakePair(row, row));
+        }
+    }
+    for(int row:removedRows)
+    {
+        m_rows.remove(m_entries.at(row).name);
+    }
+    //The sorted rows are still sorted without the removed rows.
+    int removedSortedCount=
+            std::lower_bound(removedRows.constBegin(), removedRows.constEnd(),
+                             m_sortedCount)-removedRows.constBegin();
+    if(ranges.size()>RemoveRangeThreshold)
+    {
+        //Too many scattered rows are removed, compact the entries once
+        //instead of moving the rows after each range.
+        beginResetModel();
+        int count=0, rangeIndex=0;
+        for(int i=0; i<m_entries.size(); ++i)
+        {
+            if(rangeIndex<ranges.size() && i>=ranges.at(rangeIndex).first)
+            {
+                //Skip the whole range.
+                i=ranges.at(rangeIndex++).second;
+                continue;
+            }
+            if(count!=i)
+            {
+                m_entries[count]=m_entries.at(i);
+                m_sortKeys[count]=m_sortKeys.at(i);
+            }
+            ++count;
+        }
+        m_entries.resize(count);
+        m_sortKeys.erase(m_sortKeys.begin()+count, m_sortKeys.end());
+        endResetModel();
+    }
+    else
+    {
+        //Remove the ranges from the bottom, so the rows above are not moved.
+        for(int i=ranges.size()-1; i>-1; --i)
+        {
+            int first=ranges.at(i).first,
+                    count=ranges.at(i).second-first+1;
+            beginRemoveRows(QModelIndex(), first, ranges.at(i).second);
+            m_entries.remove(first, count);
+            m_sortKeys.remove(first, count);
+            endRemoveRows();
+        }
+    }
+    m_sortedCount-=removedSortedCount;
+    //Update the rows after the first removed row.
+    for(int i=removedRows.first(); i<m_entries.size(); ++i)
+    {
+        m_rows.insert(m_entries.at(i).name, i);
+    }
+}
+
+inline void KNFileSystemModel::invalidateEntries(const QStringList &names)
+{
+    //State the changed entries again when they are shown.
+    for(const QString &name:names)
+    {
+        int row=m_rows.value(name, -1);
+        if(row==-1)
+        {
+            continue;
+        }
+        m_entries[row].stated=false;
+        m_statPending.remove(name);
+        emit dataChanged(index(row, SizeColumn), index(row, ModifiedColumn));
+    }
+}
+
+inline void KNFileSystemModel::scheduleSort()
+{
+    if(!m_sortTimer->isActive())
+    {
+        m_sortTimer->start();
+    }
+}
+
+inline void KNFileSystemModel::watchDirectory(const QString &path)
+{
+#ifdef Q_OS_LINUX
+    if(m_inotifyFd!=-1)
+    {
+        //Replace the watch of the previous directory.
+        if(m_inotifyWatch!=-1)
+        {
+            inotify_rm_watch(m_inotifyFd, m_inotifyWatch);
+        }
+        m_inotifyWatch=inotify_add_watch(
+                    m_inotifyFd,
+                    QFile::encodeName(path).constData(),
+                    IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO |
+                    IN_ATTRIB | IN_CLOSE_WRITE | IN_DELETE_SELF |
+                    IN_MOVE_SELF | IN_ONLYDIR);
+        return;
+    }
+#endif
+    if(!m_directoryWatcher->directories().isEmpty())
+    {
+        m_directoryWatcher->removePaths(m_directoryWatcher->directories());
+    }
+    m_directoryWatcher->addPath(path);
+}
+
+inline bool KNFileSystemModel::lessThan(int leftRow, int rightRow) const
+{
+    const KNFileEntry &left=m_entries.at(leftRow),
+            &right=m_entries.at(rightRow);
+    //The directories are always in front of the files.
+    if(left.isDir!=right.isDir)
+    {
+        return left.isDir;
+    }
+    bool ascending=(m_sortOrder==Qt::AscendingOrder);
+    switch(m_sortColumn)
+    {
+    case SizeColumn:
+        if(left.size!=right.size)
+        {
+            return ascending?left.size<right.size:left.size>right.size;
+        }
+        break;
+    case ModifiedColumn:
+        if(left.modified!=right.modified)
+        {
+            return ascending?left.modified<right.modified:
+                             left.modified>right.modified;
+        }
+        break;
+    default:
+        break;
+    }
+    //Sort by the name at last.
+    int result=m_sortKeys.at(leftRow).compare(m_sortKeys.at(rightRow));
+    return ascending?result<0:result>0;
+}
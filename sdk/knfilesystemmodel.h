@@ -0,0 +1,216 @@
+/*
+ * Copyright (C) Kreogist Dev Team
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#ifndef KNFILESYSTEMMODEL_H
+#define KNFILESYSTEMMODEL_H
+
+#include <QAbstractTableModel>
+#include <QAtomicInt>
+#include <QCollator>
+#include <QHash>
+#include <QSet>
+#include <QStringList>
+
+#include "knfileentry.h"
+
+class QFileSystemWatcher;
+class QSocketNotifier;
+class QThreadPool;
+class QTimer;
+/*!
+ * \brief The KNFileSystemModel lists one directory without blocking the GUI
+ * thread.\n
+ * The directory is read on a worker thread with batched getdents64() calls on
+ * Linux, and the entries are streamed into the model in growing batches, so
+ * the first rows appear at once. The size and the modified time are stated on
+ * the worker threads only for the rows which are shown, the entries are only
+ * sorted when a sort is requested. The name keys are collated once, and the
+ * new and changed rows are merged into the sorted rows.\n
+ * The directory is watched with inotify on Linux, the changes are applied as
+ * row inserts, removes and updates. On the other platforms, the directory is
+ * listed again when it is changed.
+ */
+class KNFileSystemModel : public QAbstractTableModel
+{
+    Q_OBJECT
+public:
+    enum Columns
+    {
+        NameColumn,
+        SizeColumn,
+        ModifiedColumn,
+        ColumnCount
+    };
+
+    /*!
+     * \brief Construct a KNFileSystemModel.
+     * \param parent The parent object.
+     */
+    explicit KNFileSystemModel(QObject *parent = 0);
+    ~KNFileSystemModel();
+
+    /*!
+     * \brief Reimplemented from QAbstractTableModel::rowCount().
+     */
+    int rowCount(const QModelIndex &parent=QModelIndex()) const Q_DECL_OVERRIDE;
+
+    /*!
+     * \brief Reimplemented from QAbstractTableModel::columnCount().
+     */
+    int columnCount(const QModelIndex &parent=QModelIndex()) const
+    Q_DECL_OVERRIDE;
+
+    /*!
+     * \brief Reimplemented from QAbstractTableModel::data().
+     */
+    QVariant data(const QModelIndex &index,
+                  int role=Qt::DisplayRole) const Q_DECL_OVERRIDE;
+
+    /*!
+     * \brief Reimplemented from QAbstractTableModel::headerData().
+     */
+    QVariant headerData(int section,
+                        Qt::Orientation orientation,
+                        int role=Qt::DisplayRole) const Q_DECL_OVERRIDE;
+
+    /*!
+     * \brief Reimplemented from QAbstractTableModel::sort(). The size and the
+     * modified time of all the entries will be loaded when sorting by them.
+     * Sorting by the column -1 keeps the listed order.
+     */
+    void sort(int column, Qt::SortOrder order=Qt::AscendingOrder)
+    Q_DECL_OVERRIDE;
+
+    /*!
+     * \brief Get the listed directory.
+     * \return The directory path.
+     */
+    QString rootPath() const;
+
+    /*!
+     * \brief Get the entry of a row.
+     * \param row The row of the entry.
+     * \return The file entry.
+     */
+    KNFileEntry entry(int row) const;
+
+    /*!
+     * \brief Get the path of the entry at an index.
+     * \param index The model index.
+     * \return The file path.
+     */
+    QString filePath(const QModelIndex &index) const;
+
+    /*!
+     * \brief Find the row of an entry.
+     * \param name The file name.
+     * \return The row of the entry, or -1 if it is not listed.
+     */
+    int rowOf(const QString &name) const;
+
+    /*!
+     * \brief Get whether the directory is still being listed.
+     * \return If the listing hasn't finished, return true.
+     */
+    bool isLoading() const;
+
+    /*!
+     * \brief Get whether the hidden entries are listed.
+     * \return If the hidden entries are listed, return true.
+     */
+    bool showHidden() const;
+
+    /*!
+     * \brief Set whether the hidden entries are listed, the directory will be
+     * listed again.
+     * \param showHidden To list the hidden entries, set it to true.
+     */
+    void setShowHidden(bool showHidden);
+
+signals:
+    /*!
+     * \brief When the listed directory is changed, this signal will be
+     * emitted.
+     * \param path The directory path.
+     */
+    void rootPathChanged(const QString &path);
+
+    /*!
+     * \brief When all the entries of the directory are listed, this signal
+     * will be emitted.
+     * \param path The directory path.
+     */
+    void directoryLoaded(const QString &path);
+
+public slots:
+    /*!
+     * \brief List a directory, the previous listing is abandoned.
+     * \param path The directory path.
+     */
+    void setRootPath(const QString &path);
+
+    /*!
+     * \brief List the current directory again.
+     */
+    void refresh();
+
+private slots:
+    void onActionEntriesListed(int generation, const KNFileEntryList &entries);
+    void onActionListFinished(int generation);
+    void onActionEntriesStated(int generation, const KNFileEntryList &entries);
+    void onActionFlushStatRequests();
+    void onActionSortEntries();
+    void onActionInotifyActivated();
+
+private:
+    static void listEntries(KNFileSystemModel *model,
+                            const QString &path,
+                            bool showHidden,
+                            int generation);
+    static void statEntries(KNFileSystemModel *model,
+                            const QString &path,
+                            const QStringList &names,
+                            int generation);
+    inline void requestStat(int row) const;
+    inline void appendEntries(const KNFileEntryList &entries);
+    inline void removeEntries(const QStringList &names);
+    inline void invalidateEntries(const QStringList &names);
+    inline void scheduleSort();
+    inline void watchDirectory(const QString &path);
+    inline bool lessThan(int leftRow, int rightRow) const;
+    KNFileEntryList m_entries;
+    QCollator m_collator;
+    QVector<QCollatorSortKey> m_sortKeys;
+    QHash<QString, int> m_rows;
+    QSet<QString> m_removedNames, m_unsortedNames;
+    mutable QSet<QString> m_statPending;
+    mutable QStringList m_statQueue;
+    QString m_rootPath;
+    QAtomicInt m_generation;
+    QThreadPool *m_listPool, *m_statPool;
+    QTimer *m_statTimer, *m_sortTimer;
+    QSocketNotifier *m_inotifyNotifier;
+    QFileSystemWatcher *m_directoryWatcher;
+    int m_inotifyFd, m_inotifyWatch;
+    int m_sortedCount;
+    int m_sortColumn;
+    Qt::SortOrder m_sortOrder;
+    bool m_loading, m_showHidden;
+};
+
+#endif // KNFILESYSTEMMODEL_H
@@ -0,0 +1,582 @@
+/*
+ * Copyright (C) Kreogist Dev Team
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+#include <QCoreApplication>
+#include <QFontDatabase>
+#include <QFontInfo>
+#include <QThread>
+#include <QtConcurrent/QtConcurrentMap>
+#include <QtConcurrent/QtConcurrentRun>
+
+#include "knfontcatalogcache.h"
+#include "knfontfamilymodel.h"
+#include "knfontfileparser.h"
+
+#include "kntrace.h"
+#include "knfontcatalog.h"
+
+//The number of families in one loading batch.
+#define FamilyBatchSize 256
+//The cache data names of the coverage and similarity index.
+#define CoverageCacheName "fontcoverage.bin"
+#define SimilarityCacheName "fontsimilarity.bin"
+
+QBasicAtomicPointer<KNFontCatalog> KNFontCatalog::m_instance=
+        Q_BASIC_ATOMIC_INITIALIZER(nullptr);
+KNFontCatalog::LoadMode KNFontCatalog::m_loadMode=
+        KNFontCatalog::LoadSynchronous;
+bool KNFontCatalog::m_cacheEnabled=true;
+
+KNFontCatalog *KNFontCatalog::instance()
+{
+    KNFontCatalog *catalog=m_instance.loadAcquire();
+    if(catalog!=nullptr)
+    {
+        return catalog;
+    }
+    //The catalog must live in the main thread. When it is requested from a
+    //worker thread, generate it on the main thread and wait for it.
+    if(QThread::currentThread()!=qApp->thread())
+    {
+        QMetaObject::invokeMethod(qApp,
+                                  []{ KNFontCatalog::instance(); },
+                                  Qt::BlockingQueuedConnection);
+        return m_instance.loadAcquire();
+    }
+    //Generate the catalog at the first time, it will be deleted with the
+    //application. Only the main thread reaches here, so it is generated once.
+    catalog=new KNFontCatalog(qApp);
+    m_instance.storeRelease(catalog);
+    return catalog;
+}
+
+void KNFontCatalog::setLoadMode(KNFontCatalog::LoadMode mode)
+{
+    m_loadMode=mode;
+}
+
+void KNFontCatalog::setCacheEnabled(bool enabled)
+{
+    m_cacheEnabled=enabled;
+}
+
+QAbstractItemModel *KNFontCatalog::model() const
+{
+    return m_familyModel;
+}
+
+QStringList KNFontCatalog::families() const
+{
+    return m_familyModel->families();
+}
+
+KNFontFamilyInfo KNFontCatalog::familyInfo(int row) const
+{
+    return m_familyInfos.at(row);
+}
+
+const KNFontSearchIndex &KNFontCatalog::searchIndex() const
+{
+    return m_searchIndex;
+}
+
+const KNFontCoverageIndex &KNFontCatalog::coverageIndex() const
+{
+    return m_coverageIndex;
+}
+
+bool KNFontCatalog::isCoverageReady() const
+{
+    return m_coverageReady;
+}
+
+const KNFontSimilarityIndex &KNFontCatalog::similarityIndex() const
+{
+    return m_similarityIndex;
+}
+
+bool KNFontCatalog::isSimilarityReady() const
+{
+    return m_similarityReady;
+}
+
+int KNFontCatalog::indexOf(const QString &family, int from) const
+{
+    return m_familyModel->indexOf(family, from);
+}
+
+int KNFontCatalog::familyRow(const QFont &font) const
+{
+    //Find the family which the font is actually resolved to, this is the same
+    //rule of the QFontComboBox.
+    int row=indexOf(QFontInfo(font).family());
+    //If the resolved family cannot be found, try the requested one.
+    return row==-1?indexOf(font.family()):row;
+}
+
+bool KNFontCatalog::isLoading() const
+{
+    return m_loading;
+}
+
+KNFontCatalog::~KNFontCatalog()
+{
+    //Stop the loader, the worker checks the generation for every family.
+    m_generation.fetchAndAddOrdered(1);
+    m_loader.waitForFinished();
+    //Stop computing the coverage and the features.
+    m_coverageWatcher->cancel();
+    m_coverageWatcher->waitForFinished();
+    m_similarityWatcher->cancel();
+    m_similarityWatcher->waitForFinished();
+}
+
+void KNFontCatalog::refresh()
+{
+    //The installed fonts might be changed, check the configuration again.
+    KNFontCatalogCache::resetFingerprint();
+    //Enumerate the families again.
+    loadCatalog();
+}
+
+void KNFontCatalog::loadCatalog()
+{
+    //Abandon the previous loading and the indexes.
+    int generation=resetCatalog();
+    m_customCatalog=false;
+    //Check the load mode.
+    if(m_loadMode==LoadFontFiles)
+    {
+        //Clear the model, the parsed families will be appended at once.
+        setFamilies(KNFontFamilyInfoList());
+        m_loading=true;
+        //Parse the font files on the worker threads.
+        m_loader=QtConcurrent::run(&KNFontCatalog::loadFontFiles,
+                                   this,
+                                   generation);
+        //Emit changed signal.
+        emit catalogChanged();
+        return;
+    }
+    if(m_loadMode==LoadAsynchronous &&
+            QFontDatabase::supportsThreadedFontRendering())
+    {
+        //Clear the model, the families will be appended in batches.
+        setFamilies(KNFontFamilyInfoList());
+        m_loading=true;
+        //Start loading on the worker thread.
+        m_loader=QtConcurrent::run(&KNFontCatalog::loadFamilies,
+                                   this,
+                                   generation);
+        //Emit changed signal.
+        emit catalogChanged();
+        return;
+    }
+    //Enumerate the families directly.
+    KNFontFamilyInfoList familyInfos=enumerateFamilies();
+    if(m_cacheEnabled)
+    {
+        KNFontCatalogCache::save(familyInfos);
+    }
+    setFamilies(familyInfos);
+    m_loading=false;
+    //Emit changed signal.
+    emit catalogChanged();
+    emit loadFinished();
+    //Build the requested indexes.
+    buildRequestedIndexes();
+}
+
+void KNFontCatalog::loadCustomFamilies(const KNFontFamilyInfoList &families)
+{
+    //Abandon the previous loading and the indexes.
+    resetCatalog();
+    //Use the families directly, they are never saved to the cache.
+    m_customCatalog=true;
+    setFamilies(families);
+    m_loading=false;
+    //Emit changed signal.
+    emit catalogChanged();
+    emit loadFinished();
+    //Build the requested indexes.
+    buildRequestedIndexes();
+}
+
+void KNFontCatalog::buildCoverage()
+{
+    //Check whether the index is built or building.
+    if(m_coverageReady || m_coverageWatcher->isRunning())
+    {
+        return;
+    }
+    //The index could only be built after all the families are loaded. The
+    //fonts of the custom families are not installed, the index will be built
+    //after the next refresh().
+    if(m_loading || m_customCatalog)
+    {
+        m_coverageRequested=true;
+        return;
+    }
+    m_coverageRequested=false;
+    m_coverageFamilies=families();
+    //Try to load the index from the cache.
+    QByteArray coverageData;
+    if(m_cacheEnabled &&
+            KNFontCatalogCache::loadData(CoverageCacheName, coverageData) &&
+            m_coverageIndex.load(coverageData, m_coverageFamilies))
+    {
+        m_coverageReady=true;
+        emit coverageReady();
+        return;
+    }
+    //Compute the coverages directly when the fonts cannot be used in threads.
+    if(!QFontDatabase::supportsThreadedFontRendering())
+    {
+        QVector<KNFontCoverage> coverages;
+        coverages.reserve(m_coverageFamilies.size());
+        for(const QString &family:m_coverageFamilies)
+        {
+            coverages.append(KNFontCoverageIndex::familyCoverage(family));
+        }
+        setCoverages(coverages);
+        return;
+    }
+    //Compute the coverages of all the families in parallel.
+    m_coverageWatcher->setFuture(
+                QtConcurrent::mapped(m_coverageFamilies,
+                                     &KNFontCoverageIndex::familyCoverage));
+}
+
+void KNFontCatalog::onActionFamiliesLoaded(
+        int generation,
+        const KNFontFamilyInfoList &families)
+{
+    //Abandon the batch from the previous loading.
+    if(generation==m_generation.loadAcquire())
+    {
+        appendFamilies(families);
+    }
+}
+
+void KNFontCatalog::onActionLoadFinished(int generation)
+{
+    if(generation==m_generation.loadAcquire())
+    {
+        //Reset the loading flag.
+        m_loading=false;
+        //Emit finished signal.
+        emit loadFinished();
+        //Build the requested indexes.
+        buildRequestedIndexes();
+    }
+}
+
+void KNFontCatalog::buildSimilarity()
+{
+    //Check whether the index is built or building.
+    if(m_similarityReady || m_similarityWatcher->isRunning())
+    {
+        return;
+    }
+    //The index could only be built after all the families are loaded. The
+    //fonts of the custom families are not installed, the index will be built
+    //after the next refresh().
+    if(m_loading || m_customCatalog)
+    {
+        m_similarityRequested=true;
+        return;
+    }
+    m_similarityRequested=false;
+    m_similarityFamilies=families();
+    //Try to load the index from the cache.
+    QByteArray similarityData;
+    if(m_cacheEnabled &&
+            KNFontCatalogCache::loadData(SimilarityCacheName,
+                                         similarityData) &&
+            m_similarityIndex.load(similarityData, m_similarityFamilies))
+    {
+        m_similarityReady=true;
+        emit similarityReady();
+        return;
+    }
+    //Compute the features directly when the fonts cannot be used in threads.
+    if(!QFontDatabase::supportsThreadedFontRendering())
+    {
+        QVector<KNFontFeatures> features;
+        features.reserve(m_similarityFamilies.size());
+        for(const QString &family:m_similarityFamilies)
+        {
+            features.append(KNFontSimilarityIndex::familyFeatures(family));
+        }
+        setFeatures(features);
+        return;
+    }
+    //Compute the features of all the families in parallel.
+    m_similarityWatcher->setFuture(
+                QtConcurrent::mapped(m_similarityFamilies,
+                                     &KNFontSimilarityIndex::familyFeatures));
+}
+
+void KNFontCatalog::onActionCoverageComputed()
+{
+    //Ignore the abandoned computation.
+    if(m_coverageWatcher->isCanceled())
+    {
+        return;
+    }
+    setCoverages(m_coverageWatcher->future().results().toVector());
+}
+
+void KNFontCatalog::onActionSimilarityComputed()
+{
+    //Ignore the abandoned computation.
+    if(m_similarityWatcher->isCanceled())
+    {
+        return;
+    }
+    setFeatures(m_similarityWatcher->future().results().toVector());
+}
+
+KNFontCatalog::KNFontCatalog(QObject *parent) :
+    QObject(parent),
+    m_generation(0),
+    m_familyModel(new KNFontFamilyModel(this)),
+    m_coverageWatcher(new QFutureWatcher<KNFontCoverage>(this)),
+    m_similarityWatcher(new QFutureWatcher<KNFontFeatures>(this)),
+    m_loading(false),
+    m_coverageRequested(false),
+    m_coverageReady(false),
+    m_similarityRequested(false),
+    m_similarityReady(false),
+    m_customCatalog(false)
+{
+    connect(m_coverageWatcher, &QFutureWatcher<KNFontCoverage>::finished,
+            this, &KNFontCatalog::onActionCoverageComputed);
+    connect(m_similarityWatcher, &QFutureWatcher<KNFontFeatures>::finished,
+            this, &KNFontCatalog::onActionSimilarityComputed);
+    //Register the family batch type for the worker.
+    qRegisterMetaType<KNFontFamilyInfoList>("KNFontFamilyInfoList");
+    //Try to load the catalog from the cache file first.
+    KNFontFamilyInfoList familyInfos;
+    if(m_cacheEnabled && m_loadMode!=LoadFontFiles &&
+            KNFontCatalogCache::load(familyInfos))
+    {
+        setFamilies(familyInfos);
+        return;
+    }
+    //Enumerate the font database, the fingerprint computed by the cache is
+    //still valid.
+    loadCatalog();
+}
+
+KNFontFamilyInfo KNFontCatalog::enumerateFamily(QFontDatabase &fontDatabase,
+                                                const QString &family)
+{
+    KNFontFamilyInfo familyInfo;
+    familyInfo.family=family;
+    familyInfo.styles=fontDatabase.styles(family);
+    familyInfo.pointSizes=fontDatabase.pointSizes(family);
+    for(QFontDatabase::WritingSystem writingSystem:
+        fontDatabase.writingSystems(family))
+    {
+        familyInfo.writingSystems|=(Q_UINT64_C(1) << writingSystem);
+    }
+    return familyInfo;
+}
+
+KNFontFamilyInfoList KNFontCatalog::enumerateFamilies()
+{
+    KN_TRACE_SCOPE("KNFontCatalog::enumerateFamilies");
+    QFontDatabase fontDatabase;
+    KNFontFamilyInfoList familyInfos;
+    //Enumerate all the families, private system families are ignored.
+    for(const QString &family:fontDatabase.families())
+    {
+        if(!fontDatabase.isPrivateFamily(family))
+        {
+            familyInfos.append(enumerateFamily(fontDatabase, family));
+        }
+    }
+    return familyInfos;
+}
+
+QStringList KNFontCatalog::familyNames(const KNFontFamilyInfoList &families)
+{
+    QStringList names;
+    names.reserve(families.size());
+    for(const KNFontFamilyInfo &familyInfo:families)
+    {
+        names.append(familyInfo.family);
+    }
+    return names;
+}
+
+void KNFontCatalog::setFamilies(const KNFontFamilyInfoList &families)
+{
+    KN_TRACE_SCOPE("KNFontCatalog::setFamilies");
+    //Rebuild the search index, and reset the model with the families.
+    QStringList names=familyNames(families);
+    m_familyInfos=families;
+    m_searchIndex.clear();
+    m_searchIndex.append(names);
+    m_familyModel->setFamilies(names);
+}
+
+void KNFontCatalog::appendFamilies(const KNFontFamilyInfoList &families)
+{
+    KN_TRACE_SCOPE("KNFontCatalog::appendFamilies");
+    //Append the family names to the search index and the model.
+    QStringList names=familyNames(families);
+    m_familyInfos.append(families);
+    m_searchIndex.append(names);
+    m_familyModel->appendFamilies(names);
+}
+
+void KNFontCatalog::loadFamilies(KNFontCatalog *catalog, int generation)
+{
+    QFontDatabase fontDatabase;
+    KNFontFamilyInfoList familyBatch, familyInfos;
+    //Enumerate all the families, private system families are ignored.
+    for(const QString &family:fontDatabase.families())
+    {
+        //Check whether the loading is abandoned.
+        if(generation!=catalog->m_generation.loadAcquire())
+        {
+            return;
+        }
+        if(fontDatabase.isPrivateFamily(family))
+        {
+            continue;
+        }
+        familyBatch.append(enumerateFamily(fontDatabase, family));
+        //Send the batch to the catalog.
+        if(familyBatch.size()==FamilyBatchSize)
+        {
+            QMetaObject::invokeMethod(catalog,
+                                      "onActionFamiliesLoaded",
+                                      Qt::QueuedConnection,
+                                      Q_ARG(int, generation),
+                                      Q_ARG(KNFontFamilyInfoList,
+                                            familyBatch));
+            familyInfos.append(familyBatch);
+            familyBatch.clear();
+        }
+    }
+    //Send the last batch.
+    QMetaObject::invokeMethod(catalog,
+                              "onActionFamiliesLoaded",
+                              Qt::QueuedConnection,
+                              Q_ARG(int, generation),
+                              Q_ARG(KNFontFamilyInfoList, familyBatch));
+    familyInfos.append(familyBatch);
+    //Save the catalog to the cache file.
+    if(m_cacheEnabled)
+    {
+        KNFontCatalogCache::save(familyInfos);
+    }
+    QMetaObject::invokeMethod(catalog,
+                              "onActionLoadFinished",
+                              Qt::QueuedConnection,
+                              Q_ARG(int, generation));
+}
+
+void KNFontCatalog::loadFontFiles(KNFontCatalog *catalog, int generation)
+{
+    //The files are parsed in parallel, no font engine is loaded.
+    KNFontFamilyInfoList familyInfos=KNFontFileParser::parseFamilies(
+                KNFontFileParser::fontFiles(
+                    KNFontFileParser::fontDirectories()));
+    //Check whether the loading is abandoned.
+    if(generation!=catalog->m_generation.loadAcquire())
+    {
+        return;
+    }
+    QMetaObject::invokeMethod(catalog,
+                              "onActionFamiliesLoaded",
+                              Qt::QueuedConnection,
+                              Q_ARG(int, generation),
+                              Q_ARG(KNFontFamilyInfoList, familyInfos));
+    QMetaObject::invokeMethod(catalog,
+                              "onActionLoadFinished",
+                              Qt::QueuedConnection,
+                              Q_ARG(int, generation));
+}
+
+void KNFontCatalog::setCoverages(const QVector<KNFontCoverage> &coverages)
+{
+    //Save the index and the cache.
+    m_coverageIndex.setCoverages(coverages);
+    if(m_cacheEnabled && !m_customCatalog)
+    {
+        KNFontCatalogCache::saveData(CoverageCacheName,
+                                     m_coverageIndex.save(m_coverageFamilies));
+    }
+    m_coverageReady=true;
+    emit coverageReady();
+}
+
+void KNFontCatalog::setFeatures(const QVector<KNFontFeatures> &features)
+{
+    //Save the index and the cache.
+    m_similarityIndex.setFeatures(features);
+    if(m_cacheEnabled && !m_customCatalog)
+    {
+        KNFontCatalogCache::saveData(
+                    SimilarityCacheName,
+                    m_similarityIndex.save(m_similarityFamilies));
+    }
+    m_similarityReady=true;
+    emit similarityReady();
+}
+
+void KNFontCatalog::buildRequestedIndexes()
+{
+    if(m_coverageRequested)
+    {
+        buildCoverage();
+    }
+    if(m_similarityRequested)
+    {
+        buildSimilarity();
+    }
+}
+
+int KNFontCatalog::resetCatalog()
+{
+    //Increase the generation, all the batches of the previous loading will be
+    //abandoned.
+    int generation=m_generation.fetchAndAddOrdered(1)+1;
+    //The coverage index is invalid, build it again after loading when it has
+    //been requested.
+    if(m_coverageReady || m_coverageWatcher->isRunning())
+    {
+        m_coverageRequested=true;
+    }
+    m_coverageWatcher->cancel();
+    m_coverageWatcher->waitForFinished();
+    m_coverageIndex.clear();
+    m_coverageReady=false;
+    if(m_similarityReady || m_similarityWatcher->isRunning())
+    {
+        m_similarityRequested=true;
+    }
+    m_similarityWatcher->cancel();
+    m_similarityWatcher->waitForFinished();
+    m_similarityIndex.clear();
+    m_similarityReady=false;
+    return generation;
+}
@@ -0,0 +1,263 @@
+/*
+ * Copyright (C) Kreogist Dev Team
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#ifndef KNFONTCATALOG_H
+#define KNFONTCATALOG_H
+
+#include <QAtomicInt>
+#include <QAtomicPointer>
+#include <QFuture>
+#include <QFutureWatcher>
+#include <QObject>
+#include <QStringList>
+
+#include "knfontcoverageindex.h"
+#include "knfontfamilyinfo.h"
+#include "knfontsearchindex.h"
+#include "knfontsimilarityindex.h"
+
+class QFont;
+class QFontDatabase;
+class QAbstractItemModel;
+class KNFontFamilyModel;
+/*!
+ * \brief The KNFontCatalog is the process-wide font family catalog. The font
+ * database is enumerated only once, and the family model is shared read-only
+ * by all the font dialogs.\n
+ * The catalog could enumerate the families on a worker thread, the families
+ * will be appended to the model in batches.\n
+ * The enumerated catalog is saved in the KNFontCatalogCache, the next process
+ * loads the catalog from the cache file without a live enumeration.\n
+ * The Unicode coverage and the metric feature vectors of the families are
+ * computed in parallel only when they are requested, and they are cached with
+ * the catalog.
+ */
+class KNFontCatalog : public QObject
+{
+    Q_OBJECT
+public:
+    enum LoadMode
+    {
+        LoadSynchronous,
+        LoadAsynchronous,
+        LoadFontFiles
+    };
+
+    /*!
+     * \brief Get the global font catalog instance. The catalog will be
+     * generated and enumerated at the first call. It is thread-safe, the
+     * catalog is always generated on the main thread. When it is first called
+     * from a worker thread, the main thread must be running its event loop.
+     * \return The font catalog instance.
+     */
+    static KNFontCatalog *instance();
+
+    /*!
+     * \brief Set how the catalog enumerates the font database. It should be
+     * called before the first call of instance(), or the mode will only be
+     * used at the next refresh().\n
+     * If the platform doesn't support font access in threads, the catalog
+     * will always be loaded synchronously.\n
+     * LoadFontFiles reads the font files with the KNFontFileParser on worker
+     * threads without the font engines, it works on all the platforms. The
+     * family names are the typographic names in the files, so the catalog is
+     * not shared with the cache of the font database enumeration.
+     * \param mode The load mode.
+     */
+    static void setLoadMode(LoadMode mode);
+
+    /*!
+     * \brief Set whether the catalog is loaded from and saved to the on-disk
+     * cache. It is enabled by default, it should be disabled if the
+     * application adds its own application fonts.
+     * \param enabled To enable the cache, set it to true.
+     */
+    static void setCacheEnabled(bool enabled);
+
+    /*!
+     * \brief Get the font family model. The model should be treated as read
+     * only, it is shared by all the catalog users.
+     * \return The family model.
+     */
+    QAbstractItemModel *model() const;
+
+    /*!
+     * \brief Get all the font families in the catalog.
+     * \return The font family list.
+     */
+    QStringList families() const;
+
+    /*!
+     * \brief Get the detail information of a family.
+     * \param row The row of the family in the family model.
+     * \return The family information.
+     */
+    KNFontFamilyInfo familyInfo(int row) const;
+
+    /*!
+     * \brief Get the search index of the family names. The index is always
+     * updated before the rows are inserted to the family model.
+     * \return The family search index.
+     */
+    const KNFontSearchIndex &searchIndex() const;
+
+    /*!
+     * \brief Get the Unicode coverage index of the families. It is empty
+     * until buildCoverage() is called and coverageReady() is emitted.
+     * \return The family coverage index.
+     */
+    const KNFontCoverageIndex &coverageIndex() const;
+
+    /*!
+     * \brief Get whether the coverage index is built for the current
+     * families.
+     * \return If the coverage index could be used, return true.
+     */
+    bool isCoverageReady() const;
+
+    /*!
+     * \brief Get the metric similarity index of the families. It is empty
+     * until buildSimilarity() is called and similarityReady() is emitted.
+     * \return The family similarity index.
+     */
+    const KNFontSimilarityIndex &similarityIndex() const;
+
+    /*!
+     * \brief Get whether the similarity index is built for the current
+     * families.
+     * \return If the similarity index could be used, return true.
+     */
+    bool isSimilarityReady() const;
+
+    /*!
+     * \brief Find the row of a font family in the family model.
+     * \param family The font family name, case insensitive.
+     * \param from The first row to search from.
+     * \return The row of the family, or -1 if the family is not in the catalog.
+     */
+    int indexOf(const QString &family, int from=0) const;
+
+    /*!
+     * \brief Find the row of the family which the font would be resolved to.
+     * \param font The font.
+     * \return The row of the family, or -1 if the family cannot be found.
+     */
+    int familyRow(const QFont &font) const;
+
+    /*!
+     * \brief Get whether the catalog is still enumerating on the worker thread.
+     * \return If the families are still loading, return true.
+     */
+    bool isLoading() const;
+
+    ~KNFontCatalog();
+
+signals:
+    /*!
+     * \brief When the catalog is enumerated again, this signal will be
+     * emitted.
+     */
+    void catalogChanged();
+
+    /*!
+     * \brief When all the families are loaded, this signal will be emitted.
+     */
+    void loadFinished();
+
+    /*!
+     * \brief When the coverage index is built, this signal will be emitted.
+     */
+    void coverageReady();
+
+    /*!
+     * \brief When the similarity index is built, this signal will be emitted.
+     */
+    void similarityReady();
+
+public slots:
+    /*!
+     * \brief Enumerate the font database again and update the cache. This
+     * should be called only when the installed fonts are changed.
+     */
+    void refresh();
+
+    /*!
+     * \brief Build the coverage index of the families. The index is loaded
+     * from the cache, or computed on the worker threads. If the catalog is
+     * still loading, the index will be built after the loading finished.
+     */
+    void buildCoverage();
+
+    /*!
+     * \brief Replace the catalog with the given families instead of the font
+     * database, e.g. a synthetic catalog used to measure the dialogs with
+     * a large number of families. The families are never saved to the cache,
+     * and the coverage and similarity indexes are not built for them, since
+     * their fonts are not installed. Call refresh() to go back to the font
+     * database.
+     * \param families The family list.
+     */
+    void loadCustomFamilies(const KNFontFamilyInfoList &families);
+
+    /*!
+     * \brief Build the similarity index of the families. The index is loaded
+     * from the cache, or computed on the worker threads. If the catalog is
+     * still loading, the index will be built after the loading finished.
+     */
+    void buildSimilarity();
+
+private slots:
+    void onActionFamiliesLoaded(int generation,
+                                const KNFontFamilyInfoList &families);
+    void onActionLoadFinished(int generation);
+    void onActionCoverageComputed();
+    void onActionSimilarityComputed();
+
+private:
+    explicit KNFontCatalog(QObject *parent = 0);
+    static KNFontFamilyInfo enumerateFamily(QFontDatabase &fontDatabase,
+                                            const QString &family);
+    static KNFontFamilyInfoList enumerateFamilies();
+    static QStringList familyNames(const KNFontFamilyInfoList &families);
+    inline void setFamilies(const KNFontFamilyInfoList &families);
+    inline void appendFamilies(const KNFontFamilyInfoList &families);
+    static void loadFamilies(KNFontCatalog *catalog, int generation);
+    static void loadFontFiles(KNFontCatalog *catalog, int generation);
+    inline void setCoverages(const QVector<KNFontCoverage> &coverages);
+    inline void setFeatures(const QVector<KNFontFeatures> &features);
+    inline void buildRequestedIndexes();
+    inline int resetCatalog();
+    void loadCatalog();
+    static QBasicAtomicPointer<KNFontCatalog> m_instance;
+    static LoadMode m_loadMode;
+    static bool m_cacheEnabled;
+    KNFontFamilyInfoList m_familyInfos;
+    KNFontSearchIndex m_searchIndex;
+    KNFontCoverageIndex m_coverageIndex;
+    KNFontSimilarityIndex m_similarityIndex;
+    QStringList m_coverageFamilies, m_similarityFamilies;
+    QFuture<void> m_loader;
+    QAtomicInt m_generation;
+    KNFontFamilyModel *m_familyModel;
+    QFutureWatcher<KNFontCoverage> *m_coverageWatcher;
+    QFutureWatcher<KNFontFeatures> *m_similarityWatcher;
+    bool m_loading, m_coverageRequested, m_coverageReady,
+         m_similarityRequested, m_similarityReady, m_customCatalog;
+};
+
+#endif // KNFONTCATALOG_H
@@ -0,0 +1,379 @@
+/*
+ * Copyright (C) Kreogist Dev Team
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+#include <QCryptographicHash>
+#include <QDateTime>
+#include <QDir>
+#include <QDirIterator>
+#include <QFile>
+#include <QFileInfo>
+#include <QMutex>
+#include <QSaveFile>
+#include <QStandardPaths>
+
+#include <cstring>
+
+#include "knfontfileparser.h"
+
+#include "knfontcatalogcache.h"
+
+//Cache file magic number "KNFC" and the format version.
+#define CacheMagic 0x43464E4B
+#define CacheVersion 1
+//Cache data file magic number "KNFD".
+#define CacheDataMagic 0x44464E4B
+
+namespace
+{
+//Layout of the cache file:
+//  Header | Family[familyCount] | Style[styleCount] |
+//  quint16 size[sizeCount, aligned to 2] | ushort string[stringLength]
+struct CacheHeader
+{
+    quint32 magic;
+    quint32 version;
+    quint64 fingerprint;
+    quint32 familyCount;
+    quint32 styleCount;
+    quint32 sizeCount;
+    quint32 stringLength;
+};
+
+struct CacheFamily
+{
+    quint32 nameOffset;
+    quint32 nameLength;
+    quint32 styleFirst;
+    quint32 styleCount;
+    quint32 sizeFirst;
+    quint32 sizeCount;
+    quint64 writingSystems;
+};
+
+struct CacheString
+{
+    quint32 offset;
+    quint32 length;
+};
+
+struct CacheDataHeader
+{
+    quint32 magic;
+    quint32 version;
+    quint64 fingerprint;
+};
+
+//The fingerprint calculated in this process.
+QMutex fingerprintLock;
+quint64 cachedFingerprint=0;
+bool fingerprintValid=false;
+
+inline quint32 alignedSizeCount(quint32 sizeCount)
+{
+    //Keep the string arena aligned to 4 bytes.
+    return (sizeCount+1) & ~1U;
+}
+
+inline void hashPath(QCryptographicHash &hash, const QString &path)
+{
+    QFileInfo pathInfo(path);
+    //Ignore the path which doesn't exist.
+    if(!pathInfo.exists())
+    {
+        return;
+    }
+    hash.addData(path.toUtf8());
+    hash.addData(QByteArray::number(
+                     pathInfo.lastModified().toMSecsSinceEpoch()));
+}
+}
+
+bool KNFontCatalogCache::load(KNFontFamilyInfoList &families)
+{
+    QFile cacheFile(cachePath());
+    //Open the cache file.
+    if(!cacheFile.open(QIODevice::ReadOnly))
+    {
+        return false;
+    }
+    qint64 fileSize=cacheFile.size();
+    if(fileSize<(qint64)sizeof(CacheHeader))
+    {
+        return false;
+    }
+    //Map the whole file.
+    const uchar *cacheData=cacheFile.map(0, fileSize);
+    if(cacheData==nullptr)
+    {
+        return false;
+    }
+    //Check the header.
+    const CacheHeader *header=
+            reinterpret_cast<const CacheHeader *>(cacheData);
+    if(header->magic!=CacheMagic || header->version!=CacheVersion ||
+            header->fingerprint!=fingerprint())
+    {
+        return false;
+    }
+    //Check the file size.
+    qint64 stylesOffset=(qint64)sizeof(CacheHeader)+
+            (qint64)header->familyCount*sizeof(CacheFamily),
+           sizesOffset=stylesOffset+
+            (qint64)header->styleCount*sizeof(CacheString),
+           stringsOffset=sizesOffset+
+            (qint64)alignedSizeCount(header->sizeCount)*sizeof(quint16);
+    if(stringsOffset+(qint64)header->stringLength*sizeof(ushort)!=fileSize)
+    {
+        return false;
+    }
+    const CacheFamily *familyRecords=reinterpret_cast<const CacheFamily *>(
+                cacheData+sizeof(CacheHeader));
+    const CacheString *styleRecords=reinterpret_cast<const CacheString *>(
+                cacheData+stylesOffset);
+    const quint16 *sizeRecords=reinterpret_cast<const quint16 *>(
+                cacheData+sizesOffset);
+    const QChar *stringArena=reinterpret_cast<const QChar *>(
+                cacheData+stringsOffset);
+    //Read the families.
+    KNFontFamilyInfoList cachedFamilies;
+    cachedFamilies.resize(header->familyCount);
+    for(quint32 i=0; i<header->familyCount; ++i)
+    {
+        const CacheFamily &familyRecord=familyRecords[i];
+        //Check the ranges of the record.
+        if((quint64)familyRecord.nameOffset+familyRecord.nameLength>
+                header->stringLength ||
+                (quint64)familyRecord.styleFirst+familyRecord.styleCount>
+                header->styleCount ||
+                (quint64)familyRecord.sizeFirst+familyRecord.sizeCount>
+                header->sizeCount)
+        {
+            return false;
+        }
+        KNFontFamilyInfo &familyInfo=cachedFamilies[i];
+        familyInfo.family=QString(stringArena+familyRecord.nameOffset,
+                                  familyRecord.nameLength);
+        familyInfo.writingSystems=familyRecord.writingSystems;
+        for(quint32 j=0; j<familyRecord.styleCount; ++j)
+        {
+            const CacheString &styleRecord=
+                    styleRecords[familyRecord.styleFirst+j];
+            if((quint64)styleRecord.offset+styleRecord.length>
+                    header->stringLength)
+            {
+                return false;
+            }
+            familyInfo.styles.append(QString(stringArena+styleRecord.offset,
+                                             styleRecord.length));
+        }
+        for(quint32 j=0; j<familyRecord.sizeCount; ++j)
+        {
+            familyInfo.pointSizes.append(
+                        sizeRecords[familyRecord.sizeFirst+j]);
+        }
+    }
+    families=cachedFamilies;
+    return true;
+}
+
+bool KNFontCatalogCache::save(const KNFontFamilyInfoList &families)
+{
+    QVector<CacheFamily> familyRecords;
+    QVector<CacheString> styleRecords;
+    QVector<quint16> sizeRecords;
+    QString stringArena;
+    familyRecords.reserve(families.size());
+    //Generate the records.
+    for(const KNFontFamilyInfo &familyInfo:families)
+    {
+        CacheFamily familyRecord;
+        familyRecord.nameOffset=stringArena.size();
+        familyRecord.nameLength=familyInfo.family.size();
+        stringArena.append(familyInfo.family);
+        familyRecord.styleFirst=styleRecords.size();
+        familyRecord.styleCount=familyInfo.styles.size();
+        for(const QString &style:familyInfo.styles)
+        {
+            CacheString styleRecord;
+            styleRecord.offset=stringArena.size();
+            styleRecord.length=style.size();
+            stringArena.append(style);
+            styleRecords.append(styleRecord);
+        }
+        familyRecord.sizeFirst=sizeRecords.size();
+        familyRecord.sizeCount=familyInfo.pointSizes.size();
+        for(int pointSize:familyInfo.pointSizes)
+        {
+            sizeRecords.append((quint16)qBound(0, pointSize, 0xFFFF));
+        }
+        familyRecord.writingSystems=familyInfo.writingSystems;
+        familyRecords.append(familyRecord);
+    }
+    //Generate the header.
+    CacheHeader header;
+    header.magic=CacheMagic;
+    header.version=CacheVersion;
+    header.fingerprint=fingerprint();
+    header.familyCount=familyRecords.size();
+    header.styleCount=styleRecords.size();
+    header.sizeCount=sizeRecords.size();
+    header.stringLength=stringArena.size();
+    sizeRecords.resize(alignedSizeCount(header.sizeCount));
+    //Write the cache file.
+    if(!QDir().mkpath(cacheDirectory()))
+    {
+        return false;
+    }
+    QSaveFile cacheFile(cachePath());
+    if(!cacheFile.open(QIODevice::WriteOnly))
+    {
+        return false;
+    }
+    cacheFile.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    cacheFile.write(reinterpret_cast<const char *>(familyRecords.constData()),
+                    familyRecords.size()*sizeof(CacheFamily));
+    cacheFile.write(reinterpret_cast<const char *>(styleRecords.constData()),
+                    styleRecords.size()*sizeof(CacheString));
+    cacheFile.write(reinterpret_cast<const char *>(sizeRecords.constData()),
+                    sizeRecords.size()*sizeof(quint16));
+    cacheFile.write(reinterpret_cast<const char *>(stringArena.utf16()),
+                    stringArena.size()*sizeof(ushort));
+    return cacheFile.commit();
+}
+
+bool KNFontCatalogCache::loadData(const QString &name, QByteArray &data)
+{
+    QFile dataFile(cacheDirectory()+"/"+name);
+    //Open the data file.
+    if(!dataFile.open(QIODevice::ReadOnly))
+    {
+        return false;
+    }
+    //Check the header.
+    CacheDataHeader header;
+    if(dataFile.read(reinterpret_cast<char *>(&header), sizeof(header))!=
+            sizeof(header) ||
+            header.magic!=CacheDataMagic || header.version!=CacheVersion ||
+            header.fingerprint!=fingerprint())
+    {
+        return false;
+    }
+    data=dataFile.readAll();
+    return true;
+}
+
+bool KNFontCatalogCache::saveData(const QString &name, const QByteArray &data)
+{
+    //Prepare the cache directory.
+    if(!QDir().mkpath(cacheDirectory()))
+    {
+        return false;
+    }
+    QSaveFile dataFile(cacheDirectory()+"/"+name);
+    if(!dataFile.open(QIODevice::WriteOnly))
+    {
+        return false;
+    }
+    //Write the header and the data.
+    CacheDataHeader header;
+    header.magic=CacheDataMagic;
+    header.version=CacheVersion;
+    header.fingerprint=fingerprint();
+    dataFile.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    dataFile.write(data);
+    return dataFile.commit();
+}
+
+quint64 KNFontCatalogCache::fingerprint()
+{
+    //The cache could be saved on the loader thread, guard the result.
+    QMutexLocker fingerprintLocker(&fingerprintLock);
+    if(fingerprintValid)
+    {
+        return cachedFingerprint;
+    }
+    QCryptographicHash hash(QCryptographicHash::Sha1);
+    //The enumeration result depends on the Qt version.
+    hash.addData(qVersion());
+    //Check the fontconfig configurations.
+    QString configHome=QString::fromLocal8Bit(qgetenv("XDG_CONFIG_HOME"));
+    if(configHome.isEmpty())
+    {
+        configHome=QDir::homePath()+"/.config";
+    }
+    QStringList configPaths;
+    configPaths << QString::fromLocal8Bit(qgetenv("FONTCONFIG_FILE"))
+                << "/etc/fonts/fonts.conf"
+                << "/etc/fonts/local.conf"
+                << "/etc/fonts/conf.d"
+                << QDir::homePath()+"/.fonts.conf"
+                << QDir::homePath()+"/.fonts.conf.d"
+                << configHome+"/fontconfig/fonts.conf"
+                << configHome+"/fontconfig/conf.d";
+    for(const QString &configPath:configPaths)
+    {
+        if(configPath.isEmpty())
+        {
+            continue;
+        }
+        hashPath(hash, configPath);
+        //The files in the configuration directory could be changed without
+        //touching the directory.
+        QDirIterator configIterator(configPath, QDir::Files);
+        while(configIterator.hasNext())
+        {
+            hashPath(hash, configIterator.next());
+        }
+    }
+    //Check the font directories, adding or removing a font file changes the
+    //modified time of its directory.
+    for(const QString &fontDir:KNFontFileParser::fontDirectories())
+    {
+        hashPath(hash, fontDir);
+        QDirIterator dirIterator(fontDir,
+                                 QDir::Dirs | QDir::NoDotAndDotDot,
+                                 QDirIterator::Subdirectories);
+        while(dirIterator.hasNext())
+        {
+            hashPath(hash, dirIterator.next());
+        }
+    }
+    //Use the first 8 bytes of the hash result.
+    QByteArray hashResult=hash.result();
+    std::memcpy(&cachedFingerprint, hashResult.constData(),
+                sizeof(cachedFingerprint));
+    fingerprintValid=true;
+    return cachedFingerprint;
+}
+
+void KNFontCatalogCache::resetFingerprint()
+{
+    QMutexLocker fingerprintLocker(&fingerprintLock);
+    fingerprintValid=false;
+}
+
+QString KNFontCatalogCache::cachePath()
+{
+    return cacheDirectory()+"/fontcatalog.bin";
+}
+
+QString KNFontCatalogCache::cacheDirectory()
+{
+    //The font catalog is shared by all the applications.
+    return QStandardPaths::writableLocation(
+                QStandardPaths::GenericCacheLocation)+"/kreogist";
+}
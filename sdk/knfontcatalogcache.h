@@ -0,0 +1,93 @@
+/*
+ * Copyright (C) Kreogist Dev Team
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#ifndef KNFONTCATALOGCACHE_H
+#define KNFONTCATALOGCACHE_H
+
+#include "knfontfamilyinfo.h"
+
+/*!
+ * \brief The KNFontCatalogCache stores the font catalog in a compact binary
+ * file under the user cache directory. The file is memory mapped when it is
+ * loaded.\n
+ * The cache is invalidated when the fontconfig configuration or any font
+ * directory is modified.
+ */
+class KNFontCatalogCache
+{
+public:
+    /*!
+     * \brief Load the font families from the cache file.
+     * \param families The family list to save the cached families.
+     * \return If the cache file exists and is still valid, return true.
+     */
+    static bool load(KNFontFamilyInfoList &families);
+
+    /*!
+     * \brief Save the font families to the cache file.
+     * \param families The family list.
+     * \return If the cache file is written, return true.
+     */
+    static bool save(const KNFontFamilyInfoList &families);
+
+    /*!
+     * \brief Load the data which is cached with the catalog, e.g. the data
+     * computed from the families in the catalog. The data is invalidated with
+     * the catalog.
+     * \param name The cache data name.
+     * \param data The byte array to save the cached data.
+     * \return If the cache data exists and is still valid, return true.
+     */
+    static bool loadData(const QString &name, QByteArray &data);
+
+    /*!
+     * \brief Save the data to the catalog cache directory.
+     * \param name The cache data name.
+     * \param data The data.
+     * \return If the cache data is written, return true.
+     */
+    static bool saveData(const QString &name, const QByteArray &data);
+
+    /*!
+     * \brief Get the fingerprint of the current font configuration. It is
+     * calculated from the modified time of the fontconfig configuration files
+     * and the font directories. Walking the directories is expensive, the
+     * fingerprint is calculated once and reused by the catalog and all the
+     * cache data files until resetFingerprint() is called.
+     * \return The font configuration fingerprint.
+     */
+    static quint64 fingerprint();
+
+    /*!
+     * \brief Calculate the fingerprint again at the next fingerprint() call,
+     * e.g. after the installed fonts are changed.
+     */
+    static void resetFingerprint();
+
+    /*!
+     * \brief Get the path of the catalog cache file.
+     * \return The cache file path.
+     */
+    static QString cachePath();
+
+private:
+    KNFontCatalogCache();
+    static QString cacheDirectory();
+};
+
+#endif // KNFONTCATALOGCACHE_H
@@ -0,0 +1,402 @@
+/*
+ * Copyright (C) Kreogist Dev Team
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+#include <QDataStream>
+#include <QFont>
+#include <QRawFont>
+#include <QtEndian>
+
+#include <algorithm>
+
+#include "knfontcoverageindex.h"
+
+//The number of Unicode code points.
+#define CodePointCount 0x110000
+//Each page contains 256 code points, which are 4 words.
+#define PageWords 4
+
+namespace
+{
+inline quint16 readUInt16(const uchar *data)
+{
+    return qFromBigEndian<quint16>(data);
+}
+
+inline quint32 readUInt32(const uchar *data)
+{
+    return qFromBigEndian<quint32>(data);
+}
+
+inline void setCodePoint(QVector<quint64> &bitmap, quint32 codePoint)
+{
+    if(codePoint<CodePointCount)
+    {
+        bitmap[codePoint>>6]|=(Q_UINT64_C(1) << (codePoint & 63));
+    }
+}
+
+bool parseCmapFormat12(const uchar *table, quint32 size,
+                       QVector<quint64> &bitmap)
+{
+    //Format 12 header: format, reserved, length, language, numGroups.
+    if(size<16)
+    {
+        return false;
+    }
+    //The sizes are computed in 64 bits, the fields of a malformed table could
+    //overflow 32 bits.
+    qint64 groupCount=readUInt32(table+12);
+    if(16+groupCount*12>size)
+    {
+        return false;
+    }
+    for(qint64 i=0; i<groupCount; ++i)
+    {
+        const uchar *group=table+16+i*12;
+        quint32 startCode=readUInt32(group),
+                endCode=qMin(readUInt32(group+4), (quint32)CodePointCount-1),
+                startGlyph=readUInt32(group+8);
+        //Glyph 0 is the missing glyph.
+        for(quint32 codePoint=startCode; codePoint<=endCode; ++codePoint)
+        {
+            if(startGlyph+(codePoint-startCode)!=0)
+            {
+                setCodePoint(bitmap, codePoint);
+            }
+        }
+    }
+    return true;
+}
+
+bool parseCmapFormat4(const uchar *table, quint32 size,
+                      QVector<quint64> &bitmap)
+{
+    //Format 4 header: format, length, language, segCountX2, searchRange,
+    //entrySelector, rangeShift.
+    if(size<14)
+    {
+        return false;
+    }
+    //The offsets are computed in 64 bits. The 16-bit length of a large
+    //subtable may wrap, so the subtable is bounded by the cmap table instead.
+    qint64 segmentCount=readUInt16(table+6)>>1;
+    //endCode[], reservedPad, startCode[], idDelta[], idRangeOffset[].
+    qint64 endCodes=14,
+           startCodes=endCodes+segmentCount*2+2,
+           idDeltas=startCodes+segmentCount*2,
+           idRangeOffsets=idDeltas+segmentCount*2;
+    if(idRangeOffsets+segmentCount*2>size)
+    {
+        return false;
+    }
+    for(qint64 i=0; i<segmentCount; ++i)
+    {
+        quint32 endCode=readUInt16(table+endCodes+i*2),
+                startCode=readUInt16(table+startCodes+i*2),
+                idRangeOffset=readUInt16(table+idRangeOffsets+i*2);
+        quint16 idDelta=readUInt16(table+idDeltas+i*2);
+        for(quint32 codePoint=startCode;
+            codePoint<=endCode && codePoint<0xFFFF;
+            ++codePoint)
+        {
+            quint16 glyph;
+            if(idRangeOffset==0)
+            {
+                glyph=(quint16)(codePoint+idDelta);
+            }
+            else
+            {
+                //The offset is relative to the idRangeOffset entry.
+                qint64 glyphOffset=idRangeOffsets+i*2+idRangeOffset+
+                        (qint64)(codePoint-startCode)*2;
+                if(glyphOffset+2>size)
+                {
+                    break;
+                }
+                glyph=readUInt16(table+glyphOffset);
+                if(glyph!=0)
+                {
+                    glyph=(quint16)(glyph+idDelta);
+                }
+            }
+            if(glyph!=0)
+            {
+                setCodePoint(bitmap, codePoint);
+            }
+        }
+    }
+    return true;
+}
+
+bool parseCmap(const QByteArray &cmap, QVector<quint64> &bitmap)
+{
+    const uchar *data=reinterpret_cast<const uchar *>(cmap.constData());
+    quint32 size=cmap.size();
+    if(size<4)
+    {
+        return false;
+    }
+    //Find the best Unicode subtable, format 12 covers all the planes.
+    quint32 tableCount=readUInt16(data+2), format4Offset=0, format12Offset=0;
+    for(quint32 i=0; i<tableCount && 4+(i+1)*8<=size; ++i)
+    {
+        const uchar *record=data+4+i*8;
+        quint16 platformId=readUInt16(record),
+                encodingId=readUInt16(record+2);
+        quint32 offset=readUInt32(record+4);
+        //Only use the Unicode platform and the Windows Unicode encodings.
+        if((platformId!=0 && platformId!=3) ||
+                (platformId==3 && encodingId!=1 && encodingId!=10) ||
+                (qint64)offset+2>size)
+        {
+            continue;
+        }
+        quint16 format=readUInt16(data+offset);
+        if(format==12 && format12Offset==0)
+        {
+            format12Offset=offset;
+        }
+        else if(format==4 && format4Offset==0)
+        {
+            format4Offset=offset;
+        }
+    }
+    if(format12Offset!=0)
+    {
+        return parseCmapFormat12(data+format12Offset,
+                                 size-format12Offset,
+                                 bitmap);
+    }
+    if(format4Offset!=0)
+    {
+        return parseCmapFormat4(data+format4Offset,
+                                size-format4Offset,
+                                bitmap);
+    }
+    return false;
+}
+
+void lookupBmp(const QRawFont &rawFont, QVector<quint64> &bitmap)
+{
+    //Check the basic multilingual plane page by page through the font engine.
+    QChar pageChars[256];
+    quint32 glyphIndexes[256];
+    for(quint32 page=0; page<256; ++page)
+    {
+        //Skip the surrogates.
+        if(page>=0xD8 && page<=0xDF)
+        {
+            continue;
+        }
+        for(quint32 i=0; i<256; ++i)
+        {
+            pageChars[i]=QChar((ushort)((page<<8) | i));
+        }
+        int glyphCount=256;
+        if(!rawFont.glyphIndexesForChars(pageChars, 256,
+                                         glyphIndexes, &glyphCount))
+        {
+            continue;
+        }
+        for(int i=0; i<glyphCount; ++i)
+        {
+            if(glyphIndexes[i]!=0)
+            {
+                setCodePoint(bitmap, (page<<8) | i);
+            }
+        }
+    }
+}
+
+inline bool coversPage(const KNFontCoverage &coverage,
+                       quint16 page,
+                       const quint64 *pageBits)
+{
+    //Find the page of the family.
+    auto pageIterator=std::lower_bound(coverage.pages.constBegin(),
+                                       coverage.pages.constEnd(),
+                                       page);
+    if(pageIterator==coverage.pages.constEnd() || *pageIterator!=page)
+    {
+        return false;
+    }
+    const quint64 *familyBits=coverage.bits.constData()+
+            (pageIterator-coverage.pages.constBegin())*PageWords;
+    for(int i=0; i<PageWords; ++i)
+    {
+        if((familyBits[i] & pageBits[i])!=pageBits[i])
+        {
+            return false;
+        }
+    }
+    return true;
+}
+}
+
+KNFontCoverageIndex::KNFontCoverageIndex()
+{
+}
+
+KNFontCoverage KNFontCoverageIndex::familyCoverage(const QString &family)
+{
+    QVector<quint64> bitmap(CodePointCount>>6, 0);
+    //Read the character map of the font file, or ask the font engine when the
+    //font doesn't have a cmap table.
+    QRawFont rawFont=QRawFont::fromFont(QFont(family));
+    if(rawFont.isValid() && !parseCmap(rawFont.fontTable("cmap"), bitmap))
+    {
+        lookupBmp(rawFont, bitmap);
+    }
+    //Compress the bitmap to pages.
+    KNFontCoverage coverage;
+    const quint64 *bitmapData=bitmap.constData();
+    for(int page=0; page<(CodePointCount>>8); ++page)
+    {
+        const quint64 *pageBits=bitmapData+page*PageWords;
+        if(pageBits[0] || pageBits[1] || pageBits[2] || pageBits[3])
+        {
+            coverage.pages.append(page);
+            for(int i=0; i<PageWords; ++i)
+            {
+                coverage.bits.append(pageBits[i]);
+            }
+        }
+    }
+    return coverage;
+}
+
+QVector<uint> KNFontCoverageIndex::codePoints(const QString &text)
+{
+    QVector<uint> textCodePoints;
+    for(uint codePoint:text.toUcs4())
+    {
+        //Every font could show the white spaces, and the control characters
+        //are never shown.
+        QChar::Category category=QChar::category(codePoint);
+        if(!QChar::isSpace(codePoint) &&
+                category!=QChar::Other_Control &&
+                category!=QChar::Other_Format)
+        {
+            textCodePoints.append(codePoint);
+        }
+    }
+    //Remove the duplicated code points.
+    std::sort(textCodePoints.begin(), textCodePoints.end());
+    textCodePoints.erase(std::unique(textCodePoints.begin(),
+                                     textCodePoints.end()),
+                         textCodePoints.end());
+    return textCodePoints;
+}
+
+void KNFontCoverageIndex::setCoverages(const QVector<KNFontCoverage> &coverages)
+{
+    m_coverages=coverages;
+}
+
+void KNFontCoverageIndex::clear()
+{
+    m_coverages.clear();
+}
+
+int KNFontCoverageIndex::size() const
+{
+    return m_coverages.size();
+}
+
+QVector<int> KNFontCoverageIndex::filter(const QVector<uint> &codePoints,
+                                         const QVector<int> &rows) const
+{
+    //Generate the query pages, the code points are sorted so the same pages
+    //are continuous.
+    QVector<quint16> queryPages;
+    QVector<quint64> queryBits;
+    for(uint codePoint:codePoints)
+    {
+        quint16 page=codePoint>>8;
+        if(queryPages.isEmpty() || queryPages.last()!=page)
+        {
+            queryPages.append(page);
+            queryBits.resize(queryBits.size()+PageWords);
+        }
+        quint32 pageCode=codePoint & 0xFF;
+        queryBits[(queryPages.size()-1)*PageWords+(pageCode>>6)]|=
+                (Q_UINT64_C(1) << (pageCode & 63));
+    }
+    //Check the families, the families without coverage are ignored.
+    QVector<int> matchedRows;
+    for(int row:rows)
+    {
+        if(row>=m_coverages.size())
+        {
+            continue;
+        }
+        const KNFontCoverage &coverage=m_coverages.at(row);
+        bool supported=true;
+        for(int i=0; i<queryPages.size() && supported; ++i)
+        {
+            supported=coversPage(coverage,
+                                 queryPages.at(i),
+                                 queryBits.constData()+i*PageWords);
+        }
+        if(supported)
+        {
+            matchedRows.append(row);
+        }
+    }
+    return matchedRows;
+}
+
+QByteArray KNFontCoverageIndex::save(const QStringList &families) const
+{
+    QByteArray data;
+    QDataStream dataStream(&data, QIODevice::WriteOnly);
+    dataStream << families;
+    for(const KNFontCoverage &coverage:m_coverages)
+    {
+        dataStream << coverage.pages << coverage.bits;
+    }
+    return data;
+}
+
+bool KNFontCoverageIndex::load(const QByteArray &data,
+                               const QStringList &families)
+{
+    QDataStream dataStream(data);
+    //The cached coverages must be computed for the same families.
+    QStringList cachedFamilies;
+    dataStream >> cachedFamilies;
+    if(cachedFamilies!=families)
+    {
+        return false;
+    }
+    QVector<KNFontCoverage> coverages;
+    coverages.resize(families.size());
+    for(KNFontCoverage &coverage:coverages)
+    {
+        dataStream >> coverage.pages >> coverage.bits;
+        if(coverage.bits.size()!=coverage.pages.size()*PageWords)
+        {
+            return false;
+        }
+    }
+    if(dataStream.status()!=QDataStream::Ok)
+    {
+        return false;
+    }
+    m_coverages=coverages;
+    return true;
+}
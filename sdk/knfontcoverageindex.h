@@ -0,0 +1,124 @@
+/*
+ * Copyright (C) Kreogist Dev Team
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#ifndef KNFONTCOVERAGEINDEX_H
+#define KNFONTCOVERAGEINDEX_H
+
+#include <QByteArray>
+#include <QMetaType>
+#include <QStringList>
+#include <QVector>
+
+/*!
+ * \brief The KNFontCoverage is the Unicode coverage bitset of a family. The
+ * code points are split into pages of 256 code points, only the pages which
+ * contain any supported code point are stored.
+ */
+struct KNFontCoverage
+{
+    /*!
+     * \brief The page numbers in ascending order.
+     */
+    QVector<quint16> pages;
+    /*!
+     * \brief The bits of the pages, each page takes 4 words.
+     */
+    QVector<quint64> bits;
+};
+
+Q_DECLARE_METATYPE(KNFontCoverage)
+
+/*!
+ * \brief The KNFontCoverageIndex keeps the Unicode coverage bitsets of all
+ * the families in the font catalog. Checking whether a family supports a text
+ * is an intersection of the bitsets instead of a font lookup.
+ */
+class KNFontCoverageIndex
+{
+public:
+    /*!
+     * \brief Construct an empty KNFontCoverageIndex.
+     */
+    KNFontCoverageIndex();
+
+    /*!
+     * \brief Compute the coverage of a font family from the cmap table of its
+     * font file. It could be called in threads when the platform supports
+     * threaded font rendering.
+     * \param family The family name.
+     * \return The coverage bitset of the family.
+     */
+    static KNFontCoverage familyCoverage(const QString &family);
+
+    /*!
+     * \brief Get the code points which should be checked for a text, the
+     * white spaces and the control characters are ignored.
+     * \param text The text.
+     * \return The sorted unique code points.
+     */
+    static QVector<uint> codePoints(const QString &text);
+
+    /*!
+     * \brief Set the coverages of the families, the index of the coverage is
+     * the row of the family in the catalog.
+     * \param coverages The family coverages.
+     */
+    void setCoverages(const QVector<KNFontCoverage> &coverages);
+
+    /*!
+     * \brief Remove all the coverages.
+     */
+    void clear();
+
+    /*!
+     * \brief Get the number of families in the index.
+     * \return The family count.
+     */
+    int size() const;
+
+    /*!
+     * \brief Find the families which support all the code points.
+     * \param codePoints The sorted unique code points.
+     * \param rows The rows of the families to be checked.
+     * \return The rows of the families which support all the code points, the
+     * order is kept.
+     */
+    QVector<int> filter(const QVector<uint> &codePoints,
+                        const QVector<int> &rows) const;
+
+    /*!
+     * \brief Serialize the index for the catalog cache.
+     * \param families The family names of the rows.
+     * \return The serialized index.
+     */
+    QByteArray save(const QStringList &families) const;
+
+    /*!
+     * \brief Load the index from the serialized data.
+     * \param data The serialized index.
+     * \param families The family names of the current rows, the data must be
+     * saved with the same families.
+     * \return If the index is loaded, return true.
+     */
+    bool load(const QByteArray &data, const QStringList &families);
+
+private:
+    QVector<KNFontCoverage> m_coverages;
+};
+
+#endif // KNFONTCOVERAGEINDEX_H
@@ -18,51 +18,122 @@
 #include <QBoxLayout>
 #include <QGridLayout>
 #include <QLabel>
+#include <QApplication>
 #include <QCheckBox>
 #include <QListView>
 #include <QListWidget>
 #include <QScrollBar>
 #include <QSignalMapper>
-#include <QFontComboBox>
 #include <QFontDatabase>
+#include <QElapsedTimer>
+#include <QFontInfo>
+#include <QFutureInterface>
+#include <QFutureWatcher>
 #include <QPushButton>
 #include <QSlider>
+#include <QTimer>
 #include <QScopedPointer>
-#include <QSortFilterProxyModel>
 
+#include "knfontcatalog.h"
+#include "knfontfamilyfiltermodel.h"
+#include "knfontpreviewdelegate.h"
+#include "knfontsizemodel.h"
+#include "knfontstylemodel.h"
 #include "knsearchbox.h"
+#include "kntrace.h"
 #include "knfontdialog.h"
 
 #include <QDebug>
 
+//The number of the similar fonts shown in the side panel.
+#define SimilarFontCount 8
+//The slider steps of one point for the scalable families.
+#define SizeSliderScale 10
+//The number of the rows above and below the current family whose faces are
+//prefetched.
+#define StylePrefetchRadius 16
+//The initial text of the previewer.
+#define DefaultPreviewText "AaBbXxYy"
+
+namespace
+{
+//Check whether a family which is not in the catalog is really missing. The
+//generic families and the aliases are never listed by the font database, but
+//they are resolved to the installed families.
+inline bool isFamilyMissing(const QFont &font)
+{
+    const QString &family=font.family();
+    //The family is resolved to itself, it may have a foundry, e.g.
+    //"Family [Foundry]".
+    QString resolvedFamily=QFontInfo(font).family();
+    if(resolvedFamily.compare(family, Qt::CaseInsensitive)==0 ||
+            (resolvedFamily.midRef(family.size(), 2)==QLatin1String(" [") &&
+             resolvedFamily.startsWith(family, Qt::CaseInsensitive)))
+    {
+        return false;
+    }
+    //The family has the substitutes.
+    if(!QFont::substitutes(family).isEmpty())
+    {
+        return false;
+    }
+    //The generic families of the fontconfig and the CSS.
+    static const char *genericFamilies[]=
+    {
+        "sans", "sans serif", "sans-serif", "serif", "mono", "monospace",
+        "cursive", "fantasy", "system-ui"
+    };
+    for(const char *genericFamily:genericFamilies)
+    {
+        if(family.compare(QLatin1String(genericFamily),
+                          Qt::CaseInsensitive)==0)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+}
+
+bool KNFontDialog::m_poolingEnabled=false;
+QHash<QWidget *, QPointer<KNFontDialog>> KNFontDialog::m_dialogPool;
+
 KNFontDialog::KNFontDialog(QWidget *parent) :
     QDialog(parent),
-    m_fontComboBox(new QFontComboBox(this)),
     m_fontFamilyList(new QListView(this)),
-    m_sizeListWidget(new QListWidget(this)),
+    m_fontSearcher(new KNSearchBox(this)),
+    m_coverageFilter(new QCheckBox(this)),
+    m_sizeListView(new QListView(this)),
     m_sizeEditor(new QLineEdit(this)),
     m_previewer(new QLineEdit(this)),
-    m_fontFamilyFilter(new QSortFilterProxyModel(this)),
-    m_sizeSlider(new QSlider(Qt::Vertical, this))
-{
-    //Configure the point size list.
-    m_pointSizeList << "6"
-                    << "8"
-                    << "9"
-                    << "10"
-                    << "11"
-                    << "12"
-                    << "13"
-                    << "14"
-                    << "18"
-                    << "24"
-                    << "36"
-                    << "48"
-                    << "64"
-                    << "72"
-                    << "96"
-                    << "144"
-                    << "288";
+    m_similarHint(new QLabel(tr("Similar fonts"), this)),
+    m_similarList(new QListWidget(this)),
+    m_similarButton(new QPushButton(tr("Similar fonts"), this)),
+    m_fontFamilyFilter(new KNFontFamilyFilterModel(this)),
+    m_sizeModel(new KNFontSizeModel(this)),
+    m_styleListView(new QListView(this)),
+    m_styleModel(new KNFontStyleModel(this)),
+    m_sizeSlider(new QSlider(Qt::Vertical, this)),
+    m_previewTimer(new QTimer(this)),
+    m_currentFontTimer(new QTimer(this)),
+    m_requestedSize(12.0),
+    m_searchMode(SubstringSearch),
+    m_currentFontInterval(0),
+    m_revertOnCancel(true),
+    m_pooled(false)
+{
+    KN_TRACE_SCOPE("KNFontDialog::construct");
+    //Configure the preview timer, all the changes of the preview font in one
+    //frame are applied together.
+    m_previewTimer->setSingleShot(true);
+    m_previewTimer->setInterval(16);
+    connect(m_previewTimer, &QTimer::timeout,
+            this, &KNFontDialog::onActionApplyPreviewFont);
+    //Configure the current font timer, it throttles the currentFontChanged()
+    //signal.
+    m_currentFontTimer->setSingleShot(true);
+    connect(m_currentFontTimer, &QTimer::timeout,
+            this, &KNFontDialog::onActionEmitCurrentFont);
 
     //Initial layout.
     QBoxLayout *mainLayout=new QBoxLayout(QBoxLayout::LeftToRight,
@@ -73,14 +144,30 @@ KNFontDialog::KNFontDialog(QWidget *parent) :
     //Configure view.
     m_fontFamilyList->setVerticalScrollMode(QAbstractItemView::ScrollPerPixel);
     m_fontFamilyList->setSelectionMode(QAbstractItemView::SingleSelection);
-    //Configure filter model.
-    m_fontFamilyFilter->setFilterCaseSensitivity(Qt::CaseInsensitive);
-    //Generate a font combo box, and we can get the font model.
-    m_fontComboBox->hide();
-    m_fontFamilyFilter->setSourceModel(m_fontComboBox->model());
+    //Use the shared font catalog model, the font database won't be enumerated
+    //again.
+    KNFontCatalog *fontCatalog=KNFontCatalog::instance();
+    m_fontFamilyFilter->setSourceModel(fontCatalog->model());
+    //When the catalog is loading, the initial family may arrive later.
+    connect(fontCatalog->model(), &QAbstractItemModel::rowsInserted,
+            this, &KNFontDialog::onActionFamiliesInserted);
+    connect(fontCatalog->model(), &QAbstractItemModel::modelReset,
+            this, &KNFontDialog::onActionFamiliesReset);
     m_fontFamilyList->setModel(m_fontFamilyFilter);
     m_fontFamilyList->setSelectionMode(QAbstractItemView::SingleSelection);
     m_fontFamilyList->setHorizontalScrollBarPolicy(Qt::ScrollBarAlwaysOff);
+    //All the rows have the same height, only lay out the rows in batches.
+    m_fontFamilyList->setUniformItemSizes(true);
+    m_fontFamilyList->setLayoutMode(QListView::Batched);
+    //Paint every family in its own face.
+    KNFontPreviewDelegate *fontPreviewDelegate=new KNFontPreviewDelegate(this);
+    m_fontFamilyList->setItemDelegate(fontPreviewDelegate);
+    connect(fontPreviewDelegate, &KNFontPreviewDelegate::thumbnailReady,
+            m_fontFamilyList->viewport(),
+            static_cast<void (QWidget::*)()>(&QWidget::update));
+    //Cancel the thumbnails of the rows scrolled out of the view.
+    connect(m_fontFamilyList->verticalScrollBar(), &QScrollBar::valueChanged,
+            fontPreviewDelegate, &KNFontPreviewDelegate::cancelPendingRequests);
     connect(m_fontFamilyList->selectionModel(),
             &QItemSelectionModel::currentChanged,
             [=](const QModelIndex &current)
@@ -88,24 +175,44 @@ KNFontDialog::KNFontDialog(QWidget *parent) :
                 //Sync the current font style to the editor.
                 if(current.isValid())
                 {
-                    QFont previewFont=m_previewer->font();
-                    previewFont.setFamily(
-                                current.data(Qt::DisplayRole).toString());
-                    m_previewer->setFont(previewFont);
+                    QString family=current.data(Qt::DisplayRole).toString();
+                    m_previewFont.setFamily(family);
+                    //Load the sizes of the family, and apply the requested
+                    //size again in case the family can't use it.
+                    m_sizeModel->setFamily(family);
+                    updateSizeRange();
+                    syncFontSize(m_requestedSize);
+                    //Load the faces of the family, keep the closest face of
+                    //the previous one.
+                    m_styleModel->setFamily(family);
+                    syncFontStyle();
+                    //Prefetch the faces of the families around it.
+                    prefetchFontStyles(current.row());
+                    //Update the similar fonts of the current family.
+                    updateSimilarFonts();
                 }
             });
+    //Configure the coverage filter, it checks the characters of the preview
+    //text.
+    m_coverageFilter->setText(tr("Only fonts supporting the preview text"));
+    connect(m_coverageFilter, &QCheckBox::toggled,
+            this, &KNFontDialog::onActionCoverageFilterToggle);
+    connect(fontCatalog, &KNFontCatalog::coverageReady,
+            this, &KNFontDialog::onActionCoverageReady);
+    connect(m_previewer, &QLineEdit::textChanged,
+            this, &KNFontDialog::onActionPreviewTextChange);
     //Generate the font selector keyword input box.
-    QLineEdit *fontSearcher=new KNSearchBox(this);
-    fontSearcher->setPlaceholderText(tr("Search Font"));
+    m_fontSearcher->setPlaceholderText(tr("Search Font"));
     //Link the searcher to the filter model.
-    connect(fontSearcher, &KNSearchBox::textChanged,
+    connect(m_fontSearcher, &KNSearchBox::textChanged,
             this, &KNFontDialog::onActionSearchFont);
     //Generate the font selector layout.
     QBoxLayout *fontFamilyLayout=new QBoxLayout(QBoxLayout::TopToBottom,
                                                 mainLayout->widget());
     fontFamilyLayout->addWidget(new QLabel(tr("Font"), this), 0, Qt::AlignLeft);
     fontFamilyLayout->addWidget(m_fontFamilyList, 1);
-    fontFamilyLayout->addWidget(fontSearcher);
+    fontFamilyLayout->addWidget(m_fontSearcher);
+    fontFamilyLayout->addWidget(m_coverageFilter);
     mainLayout->addLayout(fontFamilyLayout, 1);
 
     //Font options.
@@ -119,35 +226,62 @@ KNFontDialog::KNFontDialog(QWidget *parent) :
             });
     //Configure the size view and model.
     m_sizeEditor->setMaximumWidth(50);
-    m_sizeListWidget->setMaximumWidth(50);
-    m_sizeListWidget->setVerticalScrollMode(QAbstractItemView::ScrollPerPixel);
-    //Add font sizes to list widget.
-    for(QString fontSizeText:m_pointSizeList)
-    {
-        m_sizeListWidget->addItem(fontSizeText);
-    }
+    m_sizeListView->setMaximumWidth(50);
+    m_sizeListView->setVerticalScrollMode(QAbstractItemView::ScrollPerPixel);
+    m_sizeListView->setSelectionMode(QAbstractItemView::SingleSelection);
+    m_sizeListView->setModel(m_sizeModel);
     //Link the current change signal.
-    connect(m_sizeListWidget, &QListWidget::currentRowChanged,
-            [=](const int &currentRow)
+    connect(m_sizeListView->selectionModel(),
+            &QItemSelectionModel::currentChanged,
+            [=](const QModelIndex &current)
             {
-                syncFontSize(m_pointSizeList.at(currentRow).toDouble());
+                if(current.isValid())
+                {
+                    syncFontSize(m_sizeModel->pointSize(current.row()));
+                }
             });
     //Configure the slider.
+    updateSizeRange();
     connect(m_sizeSlider, &QSlider::valueChanged,
-            [=](const int &sliderFontSize)
+            [=](const int &sliderValue)
             {
-                syncFontSize(sliderFontSize);
+                //A scalable family uses the fractional sizes, a bitmap family
+                //uses the rows of its sizes.
+                syncFontSize(m_sizeModel->isScalable()?
+                                 (qreal)sliderValue/SizeSliderScale:
+                                 m_sizeModel->pointSize(sliderValue));
             });
     //Font size manager.
     QGridLayout *sizeLayout=new QGridLayout(mainLayout->widget());
     sizeLayout->addWidget(new QLabel(tr("Size"), this), 0, 0, 1, 2);
     sizeLayout->addWidget(m_sizeEditor, 1, 0, 1, 1);
-    sizeLayout->addWidget(m_sizeListWidget, 2, 0, 1, 1);
+    sizeLayout->addWidget(m_sizeListView, 2, 0, 1, 1);
     sizeLayout->addWidget(m_sizeSlider, 1, 1, 2, 1);
     //Font style manager.
     QBoxLayout *styleLayout=new QBoxLayout(QBoxLayout::TopToBottom,
                                            mainLayout->widget());
     styleLayout->addWidget(new QLabel(tr("Style"), this));
+    //Configure the face list.
+    m_styleListView->setMaximumWidth(160);
+    m_styleListView->setSelectionMode(QAbstractItemView::SingleSelection);
+    m_styleListView->setModel(m_styleModel);
+    //The faces which are not cached are loaded later, select the closest face
+    //when they arrive.
+    connect(m_styleModel, &KNFontStyleModel::facesLoaded,
+            [=]
+            {
+                syncFontStyle();
+            });
+    connect(m_styleListView->selectionModel(),
+            &QItemSelectionModel::currentChanged,
+            [=](const QModelIndex &current)
+            {
+                if(current.isValid())
+                {
+                    applyFontFace(current.row());
+                }
+            });
+    styleLayout->addWidget(m_styleListView, 1);
     //Generate style checked signal mapper.
     QSignalMapper *fontStyleMapper=new QSignalMapper(this);
     connect(fontStyleMapper,
@@ -156,8 +290,6 @@ KNFontDialog::KNFontDialog(QWidget *parent) :
             &KNFontDialog::onActionStyleStatusChange);
     //Generate style tweak check boxes.
     QString fontStyleCaptions[FontStylesCount];
-    fontStyleCaptions[Bold]=tr("Bold");
-    fontStyleCaptions[Italic]=tr("Italic");
     fontStyleCaptions[Underline]=tr("Underline");
     fontStyleCaptions[StrikeOut]=tr("Strike out");
     fontStyleCaptions[Kerning]=tr("Kerning");
@@ -172,7 +304,6 @@ KNFontDialog::KNFontDialog(QWidget *parent) :
         //Add the check box to layout.
         styleLayout->addWidget(m_fontStyles[i]);
     }
-    styleLayout->addStretch();
 
     //Ok and Cancel button.
     QPushButton *ok=new QPushButton(tr("Ok"), this),
@@ -191,6 +322,12 @@ KNFontDialog::KNFontDialog(QWidget *parent) :
     buttonLayout->addWidget(ok);
     buttonLayout->addWidget(cancel);
     buttonLayout->addStretch();
+    //The similar fonts panel is only opened by the user, or when the initial
+    //family is missing.
+    m_similarButton->setCheckable(true);
+    connect(m_similarButton, &QPushButton::toggled,
+            this, &KNFontDialog::updateSimilarPanel);
+    buttonLayout->addWidget(m_similarButton);
 
     //Add size manager and style manager to options layout.
     QBoxLayout *fontOptionsLayout=new QBoxLayout(QBoxLayout::LeftToRight,
@@ -201,7 +338,7 @@ KNFontDialog::KNFontDialog(QWidget *parent) :
 
     //Previewer.
     //Configure the initial text of the previewer.
-    m_previewer->setText("AaBbXxYy");
+    m_previewer->setText(DefaultPreviewText);
     m_previewer->setFixedSize(249, 100);
     m_previewer->setAlignment(Qt::AlignCenter);
     //We will get the font here.
@@ -211,6 +348,39 @@ KNFontDialog::KNFontDialog(QWidget *parent) :
     centerLayout->addWidget(new QLabel(tr("Preview"), this));
     centerLayout->addWidget(m_previewer);
     mainLayout->addLayout(centerLayout);
+
+    //Similar fonts.
+    m_similarHint->setWordWrap(true);
+    m_similarList->setMaximumWidth(160);
+    connect(m_similarList, &QListWidget::itemClicked,
+            this, &KNFontDialog::onActionSimilarFontClicked);
+    connect(fontCatalog, &KNFontCatalog::similarityReady,
+            this, &KNFontDialog::updateSimilarFonts);
+    QBoxLayout *similarLayout=new QBoxLayout(QBoxLayout::TopToBottom,
+                                             mainLayout->widget());
+    similarLayout->addWidget(m_similarHint);
+    similarLayout->addWidget(m_similarList, 1);
+    mainLayout->addLayout(similarLayout);
+    //The feature vectors of the families are computed when the similar fonts
+    //are shown at the first time, the panel is hidden until it is needed.
+    m_similarHint->hide();
+    m_similarList->hide();
+    m_similarList->installEventFilter(this);
+
+    //Name the controls, the benchmarks and replay scripts find them by name.
+    m_fontFamilyList->setObjectName("fontFamilyList");
+    m_fontSearcher->setObjectName("fontSearcher");
+    m_sizeEditor->setObjectName("sizeEditor");
+    m_sizeSlider->setObjectName("sizeSlider");
+    m_styleListView->setObjectName("styleList");
+    m_fontStyles[Underline]->setObjectName("underline");
+    m_fontStyles[StrikeOut]->setObjectName("strikeOut");
+    m_fontStyles[Kerning]->setObjectName("kerning");
+    m_previewer->setObjectName("previewer");
+    m_previewTimer->setObjectName("previewTimer");
+    m_similarButton->setObjectName("similarFonts");
+    ok->setObjectName("ok");
+    cancel->setObjectName("cancel");
 }
 
 QFont KNFontDialog::resultFont() const
@@ -223,38 +393,119 @@ void KNFontDialog::setInitialFont(const QFont &font)
     //Save the initial font as the result font.
     m_resultFont=font;
     //Set the font to previewer.
-    m_previewer->setFont(font);
+    m_previewFont=font;
     //Sync the font size.
     syncFontSize(font.pointSizeF());
     //Sync the font family.
     //Clear the filter of proxy model first.
-    m_fontFamilyFilter->setFilterFixedString("");
+    m_searchQuery.clear();
+    m_fontFamilyFilter->clearFilter();
     //Find and select the font family.
-    m_fontComboBox->setCurrentFont(font);
-    QModelIndex fontProxyIndex=
-            m_fontFamilyFilter->mapFromSource(
-                m_fontComboBox->model()->index(m_fontComboBox->currentIndex(),
-                                               0));
-    m_fontFamilyList->setCurrentIndex(fontProxyIndex);
-    m_fontFamilyList->scrollTo(fontProxyIndex);
+    KNFontCatalog *fontCatalog=KNFontCatalog::instance();
+    int familyRow=fontCatalog->familyRow(font);
+    m_pendingFamily.clear();
+    //Check whether the requested family is installed, the similar fonts of the
+    //requested font will be shown if it is missing.
+    m_missingFamily.clear();
+    if(!font.family().isEmpty() && !fontCatalog->isLoading() &&
+            fontCatalog->indexOf(font.family())==-1 && isFamilyMissing(font))
+    {
+        m_missingFamily=font.family();
+        m_missingFont=font;
+    }
+    updateSimilarPanel();
+    if(familyRow==-1 && fontCatalog->isLoading())
+    {
+        //The family hasn't been loaded, select it when it is inserted.
+        m_pendingFamily=QFontInfo(font).family();
+    }
+    else
+    {
+        selectFamilyRow(familyRow);
+    }
     //Sync the font style.
-    m_fontStyles[Bold]->setChecked(font.bold());
-    m_fontStyles[Italic]->setChecked(font.italic());
+    syncFontStyle();
     m_fontStyles[Underline]->setChecked(font.underline());
     m_fontStyles[StrikeOut]->setChecked(font.strikeOut());
     m_fontStyles[Kerning]->setChecked(font.kerning());
+    //Apply the initial font to the previewer directly.
+    onActionApplyPreviewFont();
+    //The initial font is not a change made by the user, don't emit it. The
+    //resolved font may differ from the requested one, remember it so cancel
+    //only reverts the fonts which are really emitted.
+    m_currentFontTimer->stop();
+    m_emittedFont=m_previewFont;
+    m_initialPreviewFont=m_previewFont;
+    updateSimilarFonts();
+}
+
+KNFontDialog::SearchMode KNFontDialog::searchMode() const
+{
+    return m_searchMode;
+}
+
+void KNFontDialog::setSearchMode(KNFontDialog::SearchMode mode)
+{
+    m_searchMode=mode;
+    //Search again with the new mode.
+    m_searchQuery.clear();
+    applySearch(m_fontSearcher->text());
+}
+
+bool KNFontDialog::isFamilySorted() const
+{
+    return m_fontFamilyFilter->isSorted();
+}
+
+void KNFontDialog::setFamilySorted(bool sorted)
+{
+    if(m_fontFamilyFilter->isSorted()==sorted)
+    {
+        return;
+    }
+    m_fontFamilyFilter->setSorted(sorted);
+    //Search again, so the results get back the ranked order.
+    if(m_fontFamilyFilter->isFiltered())
+    {
+        m_searchQuery.clear();
+        applySearch(m_fontSearcher->text());
+    }
+    //Select the current family again.
+    int familyRow=KNFontCatalog::instance()->familyRow(m_previewFont);
+    if(familyRow!=-1)
+    {
+        selectFamilyRow(familyRow);
+    }
+}
+
+int KNFontDialog::currentFontInterval() const
+{
+    return m_currentFontInterval;
+}
+
+void KNFontDialog::setCurrentFontInterval(int msecs)
+{
+    m_currentFontInterval=qMax(0, msecs);
+}
+
+bool KNFontDialog::revertOnCancel() const
+{
+    return m_revertOnCancel;
+}
+
+void KNFontDialog::setRevertOnCancel(bool revert)
+{
+    m_revertOnCancel=revert;
 }
 
 QFont KNFontDialog::getFont(QWidget *parent,
                             const QString &title,
                             const QFont &initialFont)
 {
-    //Generate a font dialog.
-    QScopedPointer<KNFontDialog> fontDialog(new KNFontDialog(parent));
-    //Set the title and initial font.
-    fontDialog->setWindowTitle(title.isEmpty()?tr("Font"):title);
-    //Set the initial font.
-    fontDialog->setInitialFont(initialFont);
+    //Use a scoped pointer for the dialog which is not pooled.
+    KNFontDialog *fontDialog=prepareDialog(parent, title, initialFont);
+    QScopedPointer<KNFontDialog> dialogDeleter(
+                fontDialog->m_pooled?nullptr:fontDialog);
     //Launch the font dialog. Return the result font if accept the tweak.
     if(QDialog::Accepted==fontDialog->exec())
     {
@@ -263,11 +514,122 @@ QFont KNFontDialog::getFont(QWidget *parent,
     return initialFont;
 }
 
+QFuture<QFont> KNFontDialog::getFontAsync(QWidget *parent,
+                                          const QString &title,
+                                          const QFont &initialFont)
+{
+    KNFontDialog *fontDialog=prepareDialog(parent, title, initialFont);
+    //Delete the dialog which is not pooled after it is closed.
+    if(!fontDialog->m_pooled)
+    {
+        fontDialog->setAttribute(Qt::WA_DeleteOnClose);
+    }
+    //Report the result through the future interface.
+    QFutureInterface<QFont> resultInterface(QFutureInterfaceBase::Started);
+    //The watcher lives until the dialog is closed, it closes the dialog when
+    //the caller cancels the future.
+    QFutureWatcher<QFont> *cancelWatcher=new QFutureWatcher<QFont>(fontDialog);
+    connect(cancelWatcher, &QFutureWatcher<QFont>::canceled,
+            fontDialog, &QDialog::reject);
+    cancelWatcher->setFuture(resultInterface.future());
+    //Finish the future when the dialog is deleted before it is closed.
+    connect(cancelWatcher, &QObject::destroyed,
+            [=]() mutable
+            {
+                if(!resultInterface.isFinished())
+                {
+                    resultInterface.reportCanceled();
+                    resultInterface.reportFinished();
+                }
+            });
+    connect(fontDialog, &QDialog::finished,
+            cancelWatcher,
+            [=](int result) mutable
+            {
+                //A canceled future doesn't have a result.
+                if(!resultInterface.isCanceled())
+                {
+                    QFont resultFont=(result==QDialog::Accepted)?
+                                fontDialog->resultFont():initialFont;
+                    resultInterface.reportResult(resultFont);
+                }
+                resultInterface.reportFinished();
+                //Disconnect the pooled dialog from this call.
+                cancelWatcher->disconnect(fontDialog);
+                fontDialog->disconnect(cancelWatcher);
+                cancelWatcher->deleteLater();
+            });
+    //Show the dialog without a nested event loop.
+    fontDialog->open();
+    return resultInterface.future();
+}
+
+void KNFontDialog::setPoolingEnabled(bool enabled)
+{
+    m_poolingEnabled=enabled;
+    //Release the pooled dialogs.
+    if(!enabled)
+    {
+        for(QPointer<KNFontDialog> &fontDialog:m_dialogPool)
+        {
+            if(!fontDialog.isNull())
+            {
+                fontDialog->deleteLater();
+            }
+        }
+        m_dialogPool.clear();
+    }
+}
+
+void KNFontDialog::prewarm(QWidget *parent)
+{
+    if(m_poolingEnabled)
+    {
+        pooledDialog(parent);
+    }
+}
+
+void KNFontDialog::done(int result)
+{
+    //Drop the throttled signal, the final font is emitted here.
+    m_currentFontTimer->stop();
+    if(result==QDialog::Accepted)
+    {
+        //Flush the last change before the dialog is closed.
+        onActionEmitCurrentFont();
+    }
+    else if(m_revertOnCancel && m_emittedFont!=m_initialPreviewFont)
+    {
+        //Give back the initial font to the host application.
+        m_emittedFont=m_initialPreviewFont;
+        emit currentFontChanged(m_resultFont);
+    }
+    QDialog::done(result);
+}
+
+bool KNFontDialog::eventFilter(QObject *watched, QEvent *event)
+{
+    //Build the similarity index when the similar font list is shown.
+    if(watched==m_similarList && event->type()==QEvent::Show &&
+            !KNFontCatalog::instance()->isSimilarityReady())
+    {
+        requestSimilarity();
+    }
+    return QDialog::eventFilter(watched, event);
+}
+
+void KNFontDialog::paintEvent(QPaintEvent *event)
+{
+    KN_TRACE_SCOPE("KNFontDialog::paintEvent");
+    QDialog::paintEvent(event);
+}
+
 void KNFontDialog::onActionOk(const bool &checked)
 {
     Q_UNUSED(checked);
     //Set the result font.
-    m_resultFont=m_previewer->font();
+    m_resultFont=m_previewFont;
+    emit fontSelected(m_resultFont);
     //Set accept flag.
     done(QDialog::Accepted);
 }
@@ -280,8 +642,11 @@ void KNFontDialog::onActionCancel(const bool &checked)
 
 void KNFontDialog::onActionSearchFont(const QString &filterText)
 {
-    //Set the filter text.
-    m_fontFamilyFilter->setFilterFixedString(filterText);
+    //User is searching, stop waiting for the initial family.
+    m_pendingFamily.clear();
+    m_missingFamily.clear();
+    //Update the filter rows.
+    applySearch(filterText);
     //Check if there's any filter's row.
     if(m_fontFamilyFilter->rowCount()>0)
     {
@@ -290,37 +655,209 @@ void KNFontDialog::onActionSearchFont(const QString &filterText)
     }
 }
 
+void KNFontDialog::onActionFamiliesInserted(const QModelIndex &parent,
+                                            int first,
+                                            int last)
+{
+    KN_TRACE_SCOPE("KNFontDialog::familiesInserted");
+    Q_UNUSED(parent);
+    KNFontCatalog *fontCatalog=KNFontCatalog::instance();
+    //Check the new rows when the filter is working.
+    if(m_fontFamilyFilter->isFiltered())
+    {
+        QVector<int> insertedRows;
+        insertedRows.reserve(last-first+1);
+        for(int i=first; i<=last; ++i)
+        {
+            insertedRows.append(i);
+        }
+        //In the fuzzy mode, the new rows are only ranked among themselves.
+        const KNFontSearchIndex &searchIndex=fontCatalog->searchIndex();
+        if(!m_searchQuery.isEmpty())
+        {
+            insertedRows=m_searchMode==FuzzySearch?
+                        searchIndex.fuzzyNarrow(m_searchQuery, insertedRows):
+                        searchIndex.narrow(m_searchQuery, insertedRows);
+        }
+        //Check the coverage of the new rows.
+        if(m_coverageFilter->isChecked() && fontCatalog->isCoverageReady())
+        {
+            insertedRows=fontCatalog->coverageIndex().filter(
+                        m_coverageCodePoints,
+                        insertedRows);
+        }
+        m_fontFamilyFilter->appendFilterRows(insertedRows);
+    }
+    //Check whether we are waiting for the initial family.
+    if(m_pendingFamily.isEmpty())
+    {
+        return;
+    }
+    //Only search the inserted rows.
+    int familyRow=fontCatalog->indexOf(m_pendingFamily, first);
+    if(familyRow!=-1)
+    {
+        //Select the initial family.
+        m_pendingFamily.clear();
+        selectFamilyRow(familyRow);
+    }
+}
+
+void KNFontDialog::onActionFamiliesReset()
+{
+    //The filter rows are cleared by the catalog, search again.
+    m_searchQuery.clear();
+    applySearch(m_fontSearcher->text());
+}
+
+void KNFontDialog::onActionCoverageFilterToggle(bool checked)
+{
+    //Build the coverage index at the first time.
+    if(checked)
+    {
+        m_coverageCodePoints=
+                KNFontCoverageIndex::codePoints(m_previewer->text());
+        KNFontCatalog::instance()->buildCoverage();
+    }
+    //Search again with the coverage filter.
+    m_searchQuery.clear();
+    applySearch(m_fontSearcher->text());
+}
+
+void KNFontDialog::onActionCoverageReady()
+{
+    //Apply the coverage filter when it is waiting for the index.
+    if(m_coverageFilter->isChecked())
+    {
+        m_searchQuery.clear();
+        applySearch(m_fontSearcher->text());
+    }
+}
+
+void KNFontDialog::onActionPreviewTextChange(const QString &previewText)
+{
+    //Update the characters to be checked.
+    if(m_coverageFilter->isChecked())
+    {
+        m_coverageCodePoints=KNFontCoverageIndex::codePoints(previewText);
+        m_searchQuery.clear();
+        applySearch(m_fontSearcher->text());
+    }
+}
+
+void KNFontDialog::onActionSimilarFontClicked(QListWidgetItem *item)
+{
+    //The user picked an alternative font.
+    m_missingFamily.clear();
+    //Clear the search, the similar font may be filtered.
+    m_fontSearcher->clear();
+    selectFamilyRow(item->data(Qt::UserRole).toInt());
+}
+
+void KNFontDialog::updateSimilarPanel()
+{
+    bool panelVisible=m_similarButton->isChecked() ||
+            !m_missingFamily.isEmpty();
+    m_similarHint->setVisible(panelVisible);
+    m_similarList->setVisible(panelVisible);
+}
+
+void KNFontDialog::updateSimilarFonts()
+{
+    KNFontCatalog *fontCatalog=KNFontCatalog::instance();
+    //Check whether the feature vectors are computed.
+    if(!fontCatalog->isSimilarityReady())
+    {
+        //Build the index when the similar fonts are needed, the list will be
+        //updated when the index is ready.
+        if(!m_similarList->isHidden())
+        {
+            requestSimilarity();
+        }
+        return;
+    }
+    const KNFontSimilarityIndex &similarityIndex=
+            fontCatalog->similarityIndex();
+    QVector<int> similarRows;
+    if(m_missingFamily.isEmpty())
+    {
+        //Find the similar fonts of the current family.
+        int currentRow=m_fontFamilyFilter->mapToSource(
+                    m_fontFamilyList->currentIndex()).row();
+        if(currentRow>=0 && currentRow<similarityIndex.size())
+        {
+            similarRows=similarityIndex.nearest(
+                        similarityIndex.features(currentRow),
+                        SimilarFontCount,
+                        currentRow);
+        }
+        m_similarHint->setText(tr("Similar fonts"));
+    }
+    else
+    {
+        //Find the nearest installed fonts of the missing font.
+        similarRows=similarityIndex.nearest(
+                    KNFontSimilarityIndex::requestedFeatures(m_missingFont),
+                    SimilarFontCount);
+        m_similarHint->setText(tr("\"%1\" is not installed, similar fonts:")
+                               .arg(m_missingFamily));
+    }
+    //Update the similar font list.
+    m_similarList->clear();
+    for(int row:similarRows)
+    {
+        QListWidgetItem *item=new QListWidgetItem(
+                    fontCatalog->model()->index(row, 0).data().toString(),
+                    m_similarList);
+        item->setData(Qt::UserRole, row);
+    }
+}
+
 void KNFontDialog::onActionStyleStatusChange(const int &statusIndex)
 {
-    //Get the previewer font.
-    QFont previewFont=m_previewer->font();
     //Change the font status.
     switch(statusIndex)
     {
-    case Bold:
-        previewFont.setBold(m_fontStyles[Bold]->isChecked());
-        break;
-    case Italic:
-        previewFont.setItalic(m_fontStyles[Italic]->isChecked());
-        break;
     case Underline:
-        previewFont.setUnderline(m_fontStyles[Underline]->isChecked());
+        m_previewFont.setUnderline(m_fontStyles[Underline]->isChecked());
         break;
     case StrikeOut:
-        previewFont.setStrikeOut(m_fontStyles[StrikeOut]->isChecked());
+        m_previewFont.setStrikeOut(m_fontStyles[StrikeOut]->isChecked());
         break;
     case Kerning:
-        previewFont.setKerning(m_fontStyles[Kerning]->isChecked());
+        m_previewFont.setKerning(m_fontStyles[Kerning]->isChecked());
         break;
     }
-    //Set the new font to previewer.
-    m_previewer->setFont(previewFont);
+    //Update the previewer at the next frame.
+    updatePreviewFont();
+}
+
+void KNFontDialog::onActionApplyPreviewFont()
+{
+    KN_TRACE_SCOPE("KNFontDialog::applyPreviewFont");
+    //Apply all the pending changes at once.
+    m_previewTimer->stop();
+    m_previewer->setFont(m_previewFont);
+    //Notify the host application later.
+    scheduleCurrentFont();
+}
+
+void KNFontDialog::onActionEmitCurrentFont()
+{
+    //Check whether the font is changed since the last signal.
+    if(m_previewFont==m_emittedFont)
+    {
+        return;
+    }
+    m_emittedFont=m_previewFont;
+    m_currentFontClock.start();
+    emit currentFontChanged(m_emittedFont);
 }
 
 void KNFontDialog::syncFontSize(qreal pointSize, bool changeLineEdit)
 {
     //Block the signal senders.
-    m_sizeListWidget->blockSignals(true);
+    m_sizeListView->selectionModel()->blockSignals(true);
     m_sizeEditor->blockSignals(true);
     m_sizeSlider->blockSignals(true);
     //Set the data.
@@ -328,33 +865,265 @@ void KNFontDialog::syncFontSize(qreal pointSize, bool changeLineEdit)
     {
         pointSize=1.0000;
     }
-    QString textPointSize=QString::number(pointSize);
+    //Save the requested size, it will be applied to the next family.
+    m_requestedSize=pointSize;
+    //Get the size which could be used by the current family.
+    pointSize=m_sizeModel->validSize(pointSize);
     //Sync editor data to the point size.
     if(changeLineEdit)
     {
-        m_sizeEditor->setText(textPointSize);
+        m_sizeEditor->setText(QString::number(pointSize));
     }
     //Sync the list to the point size.
-    int sizeIndex=m_pointSizeList.indexOf(textPointSize);
+    int sizeRow=m_sizeModel->indexOf(pointSize);
     //If we find the size in the list,
-    if(sizeIndex==-1)
+    if(sizeRow==-1)
     {
         //Select nothing.
-        m_sizeListWidget->clearSelection();
+        m_sizeListView->clearSelection();
     }
     else
     {
         //Select the size item.
-        m_sizeListWidget->setCurrentRow(sizeIndex);
+        QModelIndex sizeIndex=m_sizeModel->index(sizeRow);
+        m_sizeListView->setCurrentIndex(sizeIndex);
+        m_sizeListView->scrollTo(sizeIndex);
     }
+    //The view doesn't receive the blocked selection signals, repaint it.
+    m_sizeListView->viewport()->update();
     //Sync the slider.
-    m_sizeSlider->setValue(pointSize);
+    m_sizeSlider->setValue(m_sizeModel->isScalable()?
+                               qRound(pointSize*SizeSliderScale):
+                               m_sizeModel->nearestRow(pointSize));
     //Sync to the editor.
-    QFont previewFont=m_previewer->font();
-    previewFont.setPointSizeF(pointSize);
-    m_previewer->setFont(previewFont);
+    m_previewFont.setPointSizeF(pointSize);
+    updatePreviewFont();
     //Unblock the signal senders.
-    m_sizeListWidget->blockSignals(false);
+    m_sizeListView->selectionModel()->blockSignals(false);
     m_sizeEditor->blockSignals(false);
     m_sizeSlider->blockSignals(false);
 }
+
+void KNFontDialog::updateSizeRange()
+{
+    //Changing the range may change the value.
+    m_sizeSlider->blockSignals(true);
+    if(m_sizeModel->isScalable())
+    {
+        //Use the fractional sizes up to the largest size in the list.
+        m_sizeSlider->setRange(SizeSliderScale,
+                               qRound(m_sizeModel->pointSizes().last()*
+                                      SizeSliderScale));
+        m_sizeSlider->setPageStep(SizeSliderScale);
+    }
+    else
+    {
+        //Only the real sizes could be used.
+        m_sizeSlider->setRange(0, m_sizeModel->rowCount()-1);
+        m_sizeSlider->setPageStep(1);
+    }
+    m_sizeSlider->blockSignals(false);
+}
+
+void KNFontDialog::syncFontStyle()
+{
+    //Find the face matching the preview font.
+    int faceRow=m_styleModel->matchRow(m_previewFont);
+    m_styleListView->selectionModel()->blockSignals(true);
+    if(faceRow==-1)
+    {
+        m_styleListView->clearSelection();
+    }
+    else
+    {
+        QModelIndex faceIndex=m_styleModel->index(faceRow);
+        m_styleListView->setCurrentIndex(faceIndex);
+        m_styleListView->scrollTo(faceIndex);
+    }
+    m_styleListView->viewport()->update();
+    m_styleListView->selectionModel()->blockSignals(false);
+    //Apply the matched face.
+    if(faceRow!=-1)
+    {
+        applyFontFace(faceRow);
+    }
+}
+
+void KNFontDialog::applyFontFace(int faceRow)
+{
+    KNFontFace fontFace=m_styleModel->face(faceRow);
+    //Use the real face instead of the synthetic bold and italic.
+    m_previewFont.setStyleName(fontFace.styleName);
+    m_previewFont.setWeight(fontFace.weight);
+    m_previewFont.setItalic(fontFace.italic);
+    updatePreviewFont();
+}
+
+void KNFontDialog::prefetchFontStyles(int proxyRow)
+{
+    //Collect the families around the current row of the view.
+    QStringList families;
+    int lastRow=qMin(proxyRow+StylePrefetchRadius,
+                     m_fontFamilyFilter->rowCount()-1);
+    for(int i=qMax(0, proxyRow-StylePrefetchRadius); i<=lastRow; ++i)
+    {
+        families.append(m_fontFamilyFilter->index(i, 0).data().toString());
+    }
+    KNFontStyleModel::prefetch(families);
+}
+
+void KNFontDialog::selectFamilyRow(int familyRow)
+{
+    //Map the catalog row to the filter model.
+    QModelIndex fontProxyIndex=
+            m_fontFamilyFilter->mapFromSource(
+                KNFontCatalog::instance()->model()->index(familyRow, 0));
+    m_fontFamilyList->setCurrentIndex(fontProxyIndex);
+    m_fontFamilyList->scrollTo(fontProxyIndex);
+}
+
+void KNFontDialog::applySearch(const QString &filterText)
+{
+    KN_TRACE_SCOPE("KNFontDialog::applySearch");
+    KNFontCatalog *fontCatalog=KNFontCatalog::instance();
+    QString query=KNFontSearchIndex::foldCase(filterText);
+    bool coverageFiltered=m_coverageFilter->isChecked() &&
+            fontCatalog->isCoverageReady();
+    //Clear the filter when there's nothing to filter.
+    if(query.isEmpty() && !coverageFiltered)
+    {
+        m_fontFamilyFilter->clearFilter();
+        m_searchQuery.clear();
+        return;
+    }
+    const KNFontSearchIndex &searchIndex=fontCatalog->searchIndex();
+    QElapsedTimer searchTimer;
+    searchTimer.start();
+    QVector<int> resultRows;
+    if(query.isEmpty())
+    {
+        //Check all the families with the coverage filter.
+        resultRows.reserve(searchIndex.size());
+        for(int i=0; i<searchIndex.size(); ++i)
+        {
+            resultRows.append(i);
+        }
+    }
+    else if(m_searchMode==FuzzySearch)
+    {
+        //Score and rank all the families.
+        resultRows=searchIndex.fuzzySearch(query);
+    }
+    else
+    {
+        //When the query contains the previous one, the result must be a
+        //subset of the previous result.
+        resultRows=(m_fontFamilyFilter->isFiltered() &&
+                    !m_searchQuery.isEmpty() &&
+                    query.contains(m_searchQuery))?
+                    searchIndex.narrow(query,
+                                       m_fontFamilyFilter->filterRows()):
+                    searchIndex.search(query);
+    }
+    //Only keep the families supporting the preview text.
+    if(coverageFiltered)
+    {
+        resultRows=fontCatalog->coverageIndex().filter(m_coverageCodePoints,
+                                                       resultRows);
+    }
+    qint64 searchTime=searchTimer.nsecsElapsed();
+    m_fontFamilyFilter->setFilterRows(resultRows);
+    //Save the query.
+    m_searchQuery=query;
+    emit searchFinished(resultRows.size(), searchTime);
+}
+
+void KNFontDialog::updatePreviewFont()
+{
+    //Start the timer if there's no pending update.
+    if(!m_previewTimer->isActive())
+    {
+        m_previewTimer->start();
+    }
+}
+
+void KNFontDialog::requestSimilarity()
+{
+    //Build the index from the event loop, it is computed on the GUI thread
+    //when the fonts cannot be used in threads.
+    QMetaObject::invokeMethod(KNFontCatalog::instance(),
+                              "buildSimilarity",
+                              Qt::QueuedConnection);
+}
+
+void KNFontDialog::scheduleCurrentFont()
+{
+    //A pending signal will pick up the latest font when it is emitted.
+    if(m_currentFontTimer->isActive())
+    {
+        return;
+    }
+    //Wait for the rest of the interval since the last signal, the signal is
+    //always emitted from the event loop, so setInitialFont() could cancel it.
+    qint64 remainTime=0;
+    if(m_currentFontClock.isValid())
+    {
+        remainTime=qMax<qint64>(0, m_currentFontInterval-
+                                   m_currentFontClock.elapsed());
+    }
+    m_currentFontTimer->start(static_cast<int>(remainTime));
+}
+
+KNFontDialog *KNFontDialog::pooledDialog(QWidget *parent)
+{
+    //The dialogs are pooled by the parent window.
+    QWidget *parentWindow=parent==nullptr?nullptr:parent->window();
+    QPointer<KNFontDialog> &fontDialog=m_dialogPool[parentWindow];
+    //The dialog is deleted with its parent window.
+    if(fontDialog.isNull())
+    {
+        fontDialog=new KNFontDialog(parentWindow);
+        fontDialog->m_pooled=true;
+        if(parentWindow==nullptr)
+        {
+            //Delete the dialog without parent when the application quits.
+            connect(qApp, &QCoreApplication::aboutToQuit,
+                    fontDialog.data(), &QObject::deleteLater);
+        }
+    }
+    return fontDialog;
+}
+
+KNFontDialog *KNFontDialog::prepareDialog(QWidget *parent,
+                                          const QString &title,
+                                          const QFont &initialFont)
+{
+    //Reuse the pooled dialog of the parent window, or generate a font dialog.
+    KNFontDialog *fontDialog=m_poolingEnabled?pooledDialog(parent):nullptr;
+    //The pooled dialog is still open for an earlier call, don't reset it
+    //while it is used, generate a dialog which is not pooled.
+    if(fontDialog==nullptr || fontDialog->isVisible())
+    {
+        fontDialog=new KNFontDialog(parent);
+    }
+    //Set the title.
+    fontDialog->setWindowTitle(title.isEmpty()?tr("Font"):title);
+    //Reset the coverage filter, the preview text and the search of the
+    //previous call, so the families are not filtered by them.
+    if(fontDialog->m_pooled)
+    {
+        fontDialog->m_coverageFilter->blockSignals(true);
+        fontDialog->m_coverageFilter->setChecked(false);
+        fontDialog->m_coverageFilter->blockSignals(false);
+        fontDialog->m_coverageCodePoints.clear();
+        fontDialog->m_previewer->setText(DefaultPreviewText);
+        //Reset the search of the previous call without searching, the
+        //initial font clears the filter and selects its own family.
+        fontDialog->m_fontSearcher->blockSignals(true);
+        fontDialog->m_fontSearcher->clear();
+        fontDialog->m_fontSearcher->blockSignals(false);
+    }
+    //Set the initial font.
+    fontDialog->setInitialFont(initialFont);
+    return fontDialog;
+}
@@ -20,14 +20,25 @@
 #define KNFONTDIALOG_H
 
 #include <QDialog>
+#include <QElapsedTimer>
+#include <QFuture>
+#include <QHash>
+#include <QPointer>
+#include <QVector>
 
+class QLabel;
 class QSlider;
+class QTimer;
 class QCheckBox;
 class QLineEdit;
 class QListView;
 class QListWidget;
-class QFontComboBox;
-class QSortFilterProxyModel;
+class QListWidgetItem;
+class QPushButton;
+class KNSearchBox;
+class KNFontFamilyFilterModel;
+class KNFontSizeModel;
+class KNFontStyleModel;
 /*!
  * \brief The KNFontDialog is a dialog to select a font, and tweak the style or
  * size of the font.
@@ -36,6 +47,12 @@ class KNFontDialog : public QDialog
 {
     Q_OBJECT
 public:
+    enum SearchMode
+    {
+        SubstringSearch,
+        FuzzySearch
+    };
+
     /*!
      * \brief Construct a KNFontDialog.
      * \param parent The parent widget.
@@ -54,6 +71,65 @@ public:
      */
     void setInitialFont(const QFont &font);
 
+    /*!
+     * \brief Get how the font search box matches the families.
+     * \return The search mode.
+     */
+    SearchMode searchMode() const;
+
+    /*!
+     * \brief Set how the font search box matches the families. In the fuzzy
+     * mode, all the families are scored and ranked, the best match is
+     * selected.
+     * \param mode The search mode.
+     */
+    void setSearchMode(SearchMode mode);
+
+    /*!
+     * \brief Get whether the family list is sorted by the family names.
+     * \return If the family list is sorted, return true.
+     */
+    bool isFamilySorted() const;
+
+    /*!
+     * \brief Set whether the family list is sorted by the family names in the
+     * collation order of the locale. The search results are sorted as well,
+     * instead of the ranked order.
+     * \param sorted To sort the family list, set it to true.
+     */
+    void setFamilySorted(bool sorted);
+
+    /*!
+     * \brief Get the minimum interval between two currentFontChanged()
+     * signals.
+     * \return The interval in milliseconds.
+     */
+    int currentFontInterval() const;
+
+    /*!
+     * \brief Set the minimum interval between two currentFontChanged()
+     * signals. The changes in the interval are coalesced, and the latest font
+     * is emitted when the interval is over. When it is 0, the signal is
+     * emitted at most once per preview update.
+     * \param msecs The interval in milliseconds.
+     */
+    void setCurrentFontInterval(int msecs);
+
+    /*!
+     * \brief Get whether the initial font is emitted by currentFontChanged()
+     * when the dialog is canceled.
+     * \return If the current font is reverted on cancel, return true.
+     */
+    bool revertOnCancel() const;
+
+    /*!
+     * \brief Set whether the initial font is emitted by currentFontChanged()
+     * when the dialog is canceled, so the live preview of the host application
+     * could be reverted. It is enabled by default.
+     * \param revert To revert the current font on cancel, set it to true.
+     */
+    void setRevertOnCancel(bool revert);
+
     /*!
      * \brief Executes a modal font dialog and returns a font.\n
      * If the user clicks OK, the selected font is returned. If the user clicks
@@ -69,24 +145,110 @@ public:
                          const QString &title=QString(),
                          const QFont &initialFont=QFont());
 
+    /*!
+     * \brief Set whether getFont() reuses the font dialogs. When it is
+     * enabled, one dialog is kept for each parent window, and it is only reset
+     * by setInitialFont() at the next getFont() call. When the pooled dialog
+     * is still open, the call uses a new dialog.
+     * \param enabled To enable the dialog pool, set it to true.
+     */
+    static void setPoolingEnabled(bool enabled);
+
+    /*!
+     * \brief Opens a window modal font dialog without blocking the caller, the
+     * event loop of the application keeps running while the dialog is shown.
+     * \n
+     * The returned future finishes when the dialog is closed. Its result is
+     * the selected font if the user clicks OK, or the initial font if the
+     * user clicks Cancel. Cancelling the future closes the dialog, and the
+     * canceled future has no result.
+     * \param parent The parent widget.
+     * \param title The font dialog title.
+     * \param initialFont The initial font.
+     * \return The future of the result font.
+     */
+    static QFuture<QFont> getFontAsync(QWidget *parent=0,
+                                       const QString &title=QString(),
+                                       const QFont &initialFont=QFont());
+
+    /*!
+     * \brief Construct the pooled dialog of a parent window in advance, so
+     * the first getFont() call doesn't need to build the dialog. It does
+     * nothing when the pooling is disabled.
+     * \param parent The parent widget.
+     */
+    static void prewarm(QWidget *parent=0);
+
 signals:
+    /*!
+     * \brief When the user clicks OK, this signal will be emitted with the
+     * selected font.
+     * \param font The selected font.
+     */
+    void fontSelected(const QFont &font);
+
+    /*!
+     * \brief When the previewing font is changed by the user, this signal will
+     * be emitted with the font. The signals are throttled by the current font
+     * interval, and the last change is always emitted.
+     * \param font The current font.
+     */
+    void currentFontChanged(const QFont &font);
+
+    /*!
+     * \brief When a search of the font families is done, this signal will be
+     * emitted.
+     * \param resultCount The number of matched families.
+     * \param nsecsElapsed The time the search took in nanoseconds.
+     */
+    void searchFinished(int resultCount, qint64 nsecsElapsed);
 
 public slots:
+    void done(int result) Q_DECL_OVERRIDE;
+
+protected:
+    bool eventFilter(QObject *watched, QEvent *event) Q_DECL_OVERRIDE;
+    void paintEvent(QPaintEvent *event) Q_DECL_OVERRIDE;
 
 private slots:
     void onActionOk(const bool &checked);
     void onActionCancel(const bool &checked);
 
     void onActionSearchFont(const QString &filterText);
+    void onActionFamiliesInserted(const QModelIndex &parent,
+                                  int first,
+                                  int last);
+    void onActionFamiliesReset();
     void onActionStyleStatusChange(const int &statusIndex);
+    void onActionApplyPreviewFont();
+    void onActionEmitCurrentFont();
+    void onActionCoverageFilterToggle(bool checked);
+    void onActionCoverageReady();
+    void onActionPreviewTextChange(const QString &previewText);
+    void onActionSimilarFontClicked(QListWidgetItem *item);
+    void updateSimilarPanel();
+    void updateSimilarFonts();
 
 private:
     inline void syncFontSize(qreal pointSize,
                              bool changeLineEdit=true);
+    inline void updateSizeRange();
+    inline void syncFontStyle();
+    inline void applyFontFace(int faceRow);
+    inline void prefetchFontStyles(int proxyRow);
+    inline void selectFamilyRow(int familyRow);
+    inline void applySearch(const QString &filterText);
+    inline void updatePreviewFont();
+    inline void scheduleCurrentFont();
+    inline void requestSimilarity();
+    static KNFontDialog *pooledDialog(QWidget *parent);
+    static KNFontDialog *prepareDialog(QWidget *parent,
+                                       const QString &title,
+                                       const QFont &initialFont);
+    static bool m_poolingEnabled;
+    static QHash<QWidget *, QPointer<KNFontDialog>> m_dialogPool;
     enum FontStyles
     {
-        Bold,
-        Italic,
         Underline,
         StrikeOut,
         Kerning,
@@ -94,14 +256,30 @@ private:
     };
     QCheckBox *m_fontStyles[FontStylesCount];
 
-    QFontComboBox *m_fontComboBox;
     QListView *m_fontFamilyList;
-    QListWidget *m_sizeListWidget;
+    KNSearchBox *m_fontSearcher;
+    QCheckBox *m_coverageFilter;
+    QListView *m_sizeListView;
     QLineEdit *m_sizeEditor, *m_previewer;
-    QSortFilterProxyModel *m_fontFamilyFilter;
+    QLabel *m_similarHint;
+    QListWidget *m_similarList;
+    QPushButton *m_similarButton;
+    KNFontFamilyFilterModel *m_fontFamilyFilter;
+    KNFontSizeModel *m_sizeModel;
+    QListView *m_styleListView;
+    KNFontStyleModel *m_styleModel;
     QSlider *m_sizeSlider;
-    QFont m_resultFont;
-    QStringList m_pointSizeList;
+    QTimer *m_previewTimer, *m_currentFontTimer;
+    QElapsedTimer m_currentFontClock;
+    QFont m_resultFont, m_previewFont, m_missingFont, m_emittedFont,
+          m_initialPreviewFont;
+    QString m_pendingFamily, m_searchQuery, m_missingFamily;
+    QVector<uint> m_coverageCodePoints;
+    qreal m_requestedSize;
+    SearchMode m_searchMode;
+    int m_currentFontInterval;
+    bool m_revertOnCancel;
+    bool m_pooled;
 };
 
 #endif // KNFONTDIALOG_H
@@ -0,0 +1,400 @@
+/*
+ * Copyright (C) Kreogist Dev Team
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+#include <algorithm>
+
+#include "knfontfamilymodel.h"
+#include "kntrace.h"
+#include "knfontfamilyfiltermodel.h"
+
+KNFontFamilyFilterModel::KNFontFamilyFilterModel(QObject *parent) :
+    QAbstractProxyModel(parent),
+    m_filtered(false),
+    m_sorted(false)
+{
+}
+
+void KNFontFamilyFilterModel::setSourceModel(QAbstractItemModel *sourceModel)
+{
+    beginResetModel();
+    //Disconnect the previous source model.
+    if(QAbstractProxyModel::sourceModel()!=nullptr)
+    {
+        disconnect(QAbstractProxyModel::sourceModel(), 0, this, 0);
+    }
+    QAbstractProxyModel::setSourceModel(sourceModel);
+    m_filterRows.clear();
+    m_filtered=false;
+    //Only the family model could be sorted.
+    m_sorted=m_sorted && familyModel()!=nullptr;
+    if(m_sorted)
+    {
+        familyModel()->enableSorting();
+    }
+    resetSortedRows();
+    //Link the source model.
+    if(familyModel()!=nullptr)
+    {
+        connect(familyModel(), &KNFontFamilyModel::sortOrderChanged,
+                this,
+                &KNFontFamilyFilterModel::onActionSourceSortOrderChanged);
+    }
+    if(sourceModel!=nullptr)
+    {
+        connect(sourceModel, &QAbstractItemModel::rowsAboutToBeInserted,
+                this,
+                &KNFontFamilyFilterModel::onActionSourceRowsAboutToBeInserted);
+        connect(sourceModel, &QAbstractItemModel::rowsInserted,
+                this, &KNFontFamilyFilterModel::onActionSourceRowsInserted);
+        connect(sourceModel, &QAbstractItemModel::modelAboutToBeReset,
+                this, &KNFontFamilyFilterModel::onActionSourceAboutToBeReset);
+        connect(sourceModel, &QAbstractItemModel::modelReset,
+                this, &KNFontFamilyFilterModel::onActionSourceReset);
+    }
+    endResetModel();
+}
+
+QModelIndex KNFontFamilyFilterModel::mapToSource(
+        const QModelIndex &proxyIndex) const
+{
+    if(!proxyIndex.isValid() || sourceModel()==nullptr)
+    {
+        return QModelIndex();
+    }
+    int proxyRow=proxyIndex.row();
+    return sourceModel()->index(m_filtered?
+                                    m_filterRows.at(proxyRow):
+                                    (m_sorted?
+                                         m_sortedRows.at(proxyRow):
+                                         proxyRow),
+                                proxyIndex.column());
+}
+
+QModelIndex KNFontFamilyFilterModel::mapFromSource(
+        const QModelIndex &sourceIndex) const
+{
+    if(!sourceIndex.isValid())
+    {
+        return QModelIndex();
+    }
+    //Find the source row in the reverse map of the filter or the sorted rows.
+    int proxyRow=sourceIndex.row();
+    if(m_filtered || m_sorted)
+    {
+        proxyRow=proxyRow<m_proxyRows.size()?m_proxyRows.at(proxyRow):-1;
+    }
+    return proxyRow==-1?
+                QModelIndex():
+                createIndex(proxyRow, sourceIndex.column());
+}
+
+QModelIndex KNFontFamilyFilterModel::index(int row,
+                                           int column,
+                                           const QModelIndex &parent) const
+{
+    //List model doesn't have any child.
+    if(parent.isValid() || row<0 || row>=rowCount() ||
+            column<0 || column>=columnCount())
+    {
+        return QModelIndex();
+    }
+    return createIndex(row, column);
+}
+
+QModelIndex KNFontFamilyFilterModel::parent(const QModelIndex &child) const
+{
+    Q_UNUSED(child);
+    return QModelIndex();
+}
+
+int KNFontFamilyFilterModel::rowCount(const QModelIndex &parent) const
+{
+    if(parent.isValid() || sourceModel()==nullptr)
+    {
+        return 0;
+    }
+    if(m_filtered)
+    {
+        return m_filterRows.size();
+    }
+    return m_sorted?m_sortedRows.size():sourceModel()->rowCount();
+}
+
+int KNFontFamilyFilterModel::columnCount(const QModelIndex &parent) const
+{
+    if(parent.isValid() || sourceModel()==nullptr)
+    {
+        return 0;
+    }
+    return sourceModel()->columnCount();
+}
+
+bool KNFontFamilyFilterModel::isFiltered() const
+{
+    return m_filtered;
+}
+
+QVector<int> KNFontFamilyFilterModel::filterRows() const
+{
+    return m_filterRows;
+}
+
+bool KNFontFamilyFilterModel::isSorted() const
+{
+    return m_sorted;
+}
+
+void KNFontFamilyFilterModel::setFilterRows(const QVector<int> &rows)
+{
+    KN_TRACE_SCOPE("KNFontFamilyFilterModel::setFilterRows");
+    beginResetModel();
+    m_filterRows=rows;
+    m_filtered=true;
+    if(m_sorted)
+    {
+        sortRows(m_filterRows);
+    }
+    updateProxyRows();
+    endResetModel();
+}
+
+void KNFontFamilyFilterModel::appendFilterRows(const QVector<int> &rows)
+{
+    //Only append the rows in the filtered mode.
+    if(!m_filtered || rows.isEmpty())
+    {
+        return;
+    }
+    //Insert the rows at their sorted positions.
+    if(m_sorted)
+    {
+        insertSortedRows(m_filterRows, rows);
+        return;
+    }
+    beginInsertRows(QModelIndex(),
+                    m_filterRows.size(),
+                    m_filterRows.size()+rows.size()-1);
+    int firstRow=m_filterRows.size();
+    m_filterRows.append(rows);
+    updateProxyRows(firstRow);
+    endInsertRows();
+}
+
+void KNFontFamilyFilterModel::clearFilter()
+{
+    //Check whether the filter is already cleared.
+    if(!m_filtered)
+    {
+        return;
+    }
+    beginResetModel();
+    m_filterRows.clear();
+    m_filtered=false;
+    resetSortedRows();
+    endResetModel();
+}
+
+void KNFontFamilyFilterModel::setSorted(bool sorted)
+{
+    //Only the family model could be sorted.
+    sorted=sorted && familyModel()!=nullptr;
+    if(m_sorted==sorted)
+    {
+        return;
+    }
+    beginResetModel();
+    m_sorted=sorted;
+    //The ranks of the families are computed when they are first sorted.
+    if(m_sorted)
+    {
+        familyModel()->enableSorting();
+    }
+    if(m_filtered && m_sorted)
+    {
+        sortRows(m_filterRows);
+    }
+    resetSortedRows();
+    endResetModel();
+}
+
+void KNFontFamilyFilterModel::onActionSourceRowsAboutToBeInserted(
+        const QModelIndex &parent,
+        int first,
+        int last)
+{
+    //Pass the inserted rows through when the filter is cleared, or else the
+    //filter owner decides which new rows should be shown.
+    //The sorted rows are inserted after the ranks are updated.
+    if(!m_filtered && !m_sorted && !parent.isValid())
+    {
+        beginInsertRows(QModelIndex(), first, last);
+    }
+}
+
+void KNFontFamilyFilterModel::onActionSourceRowsInserted(
+        const QModelIndex &parent,
+        int first,
+        int last)
+{
+    if(m_filtered || parent.isValid())
+    {
+        return;
+    }
+    if(!m_sorted)
+    {
+        endInsertRows();
+        return;
+    }
+    QVector<int> insertedRows;
+    insertedRows.reserve(last-first+1);
+    for(int i=first; i<=last; ++i)
+    {
+        insertedRows.append(i);
+    }
+    insertSortedRows(m_sortedRows, insertedRows);
+}
+
+void KNFontFamilyFilterModel::onActionSourceAboutToBeReset()
+{
+    beginResetModel();
+}
+
+void KNFontFamilyFilterModel::onActionSourceReset()
+{
+    //All the source rows are changed, the filter rows are invalid.
+    m_filterRows.clear();
+    m_filtered=false;
+    resetSortedRows();
+    endResetModel();
+}
+
+void KNFontFamilyFilterModel::onActionSourceSortOrderChanged()
+{
+    if(!m_sorted)
+    {
+        return;
+    }
+    //Keep the persistent indexes on the same source rows.
+    emit layoutAboutToBeChanged();
+    QModelIndexList proxyIndexes=persistentIndexList(), sourceIndexes;
+    for(const QModelIndex &proxyIndex : proxyIndexes)
+    {
+        sourceIndexes.append(mapToSource(proxyIndex));
+    }
+    if(m_filtered)
+    {
+        sortRows(m_filterRows);
+    }
+    resetSortedRows();
+    QModelIndexList sortedIndexes;
+    for(const QModelIndex &sourceIndex : sourceIndexes)
+    {
+        sortedIndexes.append(mapFromSource(sourceIndex));
+    }
+    changePersistentIndexList(proxyIndexes, sortedIndexes);
+    emit layoutChanged();
+}
+
+inline KNFontFamilyModel *KNFontFamilyFilterModel::familyModel() const
+{
+    return qobject_cast<KNFontFamilyModel *>(sourceModel());
+}
+
+inline void KNFontFamilyFilterModel::sortRows(QVector<int> &rows) const
+{
+    KN_TRACE_SCOPE("KNFontFamilyFilterModel::sortRows");
+    //The ranks are precomputed from the collation keys.
+    KNFontFamilyModel *model=familyModel();
+    std::sort(rows.begin(), rows.end(),
+              [model](int left, int right)
+    {
+        return model->sortRank(left)<model->sortRank(right);
+    });
+}
+
+inline void KNFontFamilyFilterModel::insertSortedRows(QVector<int> &proxyRows,
+                                                      QVector<int> rows)
+{
+    KN_TRACE_SCOPE("KNFontFamilyFilterModel::insertSortedRows");
+    KNFontFamilyModel *model=familyModel();
+    sortRows(rows);
+    //Append the whole batch at the end, then merge it into the sorted rows
+    //with one layout change, so a batch only sends a few signals.
+    int firstRow=proxyRows.size();
+    beginInsertRows(QModelIndex(), firstRow, firstRow+rows.size()-1);
+    proxyRows.append(rows);
+    updateProxyRows(firstRow);
+    endInsertRows();
+    //Keep the persistent indexes on the same source rows.
+    emit layoutAboutToBeChanged();
+    QModelIndexList proxyIndexes=persistentIndexList(), sourceIndexes;
+    for(const QModelIndex &proxyIndex : proxyIndexes)
+    {
+        sourceIndexes.append(mapToSource(proxyIndex));
+    }
+    std::inplace_merge(proxyRows.begin(),
+                       proxyRows.begin()+firstRow,
+                       proxyRows.end(),
+                       [model](int left, int right)
+    {
+        return model->sortRank(left)<model->sortRank(right);
+    });
+    updateProxyRows();
+    QModelIndexList sortedIndexes;
+    for(const QModelIndex &sourceIndex : sourceIndexes)
+    {
+        sortedIndexes.append(mapFromSource(sourceIndex));
+    }
+    changePersistentIndexList(proxyIndexes, sortedIndexes);
+    emit layoutChanged();
+}
+
+inline void KNFontFamilyFilterModel::resetSortedRows()
+{
+    m_sortedRows.clear();
+    if(m_sorted && sourceModel()!=nullptr)
+    {
+        //The rank of a row is its sorted position.
+        KNFontFamilyModel *model=familyModel();
+        m_sortedRows.resize(model->rowCount());
+        for(int i=0; i<m_sortedRows.size(); ++i)
+        {
+            m_sortedRows[model->sortRank(i)]=i;
+        }
+    }
+    updateProxyRows();
+}
+
+inline void KNFontFamilyFilterModel::updateProxyRows(int firstRow)
+{
+    //Only the filter rows and the sorted rows need the reverse map.
+    if((!m_filtered && !m_sorted) || sourceModel()==nullptr)
+    {
+        m_proxyRows.clear();
+        return;
+    }
+    const QVector<int> &rows=m_filtered?m_filterRows:m_sortedRows;
+    //Map the source rows which are not shown to -1.
+    int previousSize=firstRow==0?0:m_proxyRows.size();
+    m_proxyRows.resize(qMax(previousSize, sourceModel()->rowCount()));
+    std::fill(m_proxyRows.begin()+previousSize, m_proxyRows.end(), -1);
+    //Update the proxy rows of the given rows.
+    for(int i=firstRow; i<rows.size(); ++i)
+    {
+        m_proxyRows[rows.at(i)]=i;
+    }
+}
@@ -0,0 +1,155 @@
+/*
+ * Copyright (C) Kreogist Dev Team
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#ifndef KNFONTFAMILYFILTERMODEL_H
+#define KNFONTFAMILYFILTERMODEL_H
+
+#include <QVector>
+
+#include <QAbstractProxyModel>
+
+class KNFontFamilyModel;
+/*!
+ * \brief The KNFontFamilyFilterModel is a lightweight proxy of a list model.
+ * It doesn't filter the rows by itself, it shows the source rows given by
+ * setFilterRows() in the given order. When the filter is cleared, all the
+ * source rows are passed through.\n
+ * In the sorted mode, the rows are sorted by the collation ranks of a
+ * KNFontFamilyModel source, sorting the rows only compares integers.
+ */
+class KNFontFamilyFilterModel : public QAbstractProxyModel
+{
+    Q_OBJECT
+public:
+    /*!
+     * \brief Construct a KNFontFamilyFilterModel.
+     * \param parent The parent object.
+     */
+    explicit KNFontFamilyFilterModel(QObject *parent = 0);
+
+    /*!
+     * \brief Reimplemented from QAbstractProxyModel::setSourceModel().
+     */
+    void setSourceModel(QAbstractItemModel *sourceModel) Q_DECL_OVERRIDE;
+
+    /*!
+     * \brief Reimplemented from QAbstractProxyModel::mapToSource().
+     */
+    QModelIndex mapToSource(const QModelIndex &proxyIndex) const
+    Q_DECL_OVERRIDE;
+
+    /*!
+     * \brief Reimplemented from QAbstractProxyModel::mapFromSource().
+     */
+    QModelIndex mapFromSource(const QModelIndex &sourceIndex) const
+    Q_DECL_OVERRIDE;
+
+    /*!
+     * \brief Reimplemented from QAbstractProxyModel::index().
+     */
+    QModelIndex index(int row,
+                      int column,
+                      const QModelIndex &parent=QModelIndex()) const
+    Q_DECL_OVERRIDE;
+
+    /*!
+     * \brief Reimplemented from QAbstractProxyModel::parent().
+     */
+    QModelIndex parent(const QModelIndex &child) const Q_DECL_OVERRIDE;
+
+    /*!
+     * \brief Reimplemented from QAbstractProxyModel::rowCount().
+     */
+    int rowCount(const QModelIndex &parent=QModelIndex()) const
+    Q_DECL_OVERRIDE;
+
+    /*!
+     * \brief Reimplemented from QAbstractProxyModel::columnCount().
+     */
+    int columnCount(const QModelIndex &parent=QModelIndex()) const
+    Q_DECL_OVERRIDE;
+
+    /*!
+     * \brief Get whether the model is showing the filter rows.
+     * \return If the filter is set, return true.
+     */
+    bool isFiltered() const;
+
+    /*!
+     * \brief Get the source rows shown by the model.
+     * \return The filter rows, it is empty when the filter is cleared.
+     */
+    QVector<int> filterRows() const;
+
+    /*!
+     * \brief Get whether the rows are sorted by the family names.
+     * \return If the model is in the sorted mode, return true.
+     */
+    bool isSorted() const;
+
+signals:
+
+public slots:
+    /*!
+     * \brief Only show the source rows in the given order.
+     * \param rows The source rows.
+     */
+    void setFilterRows(const QVector<int> &rows);
+
+    /*!
+     * \brief Append source rows to the end of the filter rows.
+     * \param rows The source rows.
+     */
+    void appendFilterRows(const QVector<int> &rows);
+
+    /*!
+     * \brief Clear the filter, show all the source rows.
+     */
+    void clearFilter();
+
+    /*!
+     * \brief Set whether the rows are sorted by the family names. It only
+     * works with a KNFontFamilyModel source. When the sorted mode is turned
+     * off, the filter rows keep the sorted order until the next filter.
+     * \param sorted To sort the rows, set it to true.
+     */
+    void setSorted(bool sorted);
+
+private slots:
+    void onActionSourceRowsAboutToBeInserted(const QModelIndex &parent,
+                                             int first,
+                                             int last);
+    void onActionSourceRowsInserted(const QModelIndex &parent,
+                                    int first,
+                                    int last);
+    void onActionSourceAboutToBeReset();
+    void onActionSourceReset();
+    void onActionSourceSortOrderChanged();
+
+private:
+    inline KNFontFamilyModel *familyModel() const;
+    inline void sortRows(QVector<int> &rows) const;
+    inline void insertSortedRows(QVector<int> &proxyRows,
+                                 QVector<int> rows);
+    inline void resetSortedRows();
+    inline void updateProxyRows(int firstRow=0);
+    QVector<int> m_filterRows, m_sortedRows, m_proxyRows;
+    bool m_filtered, m_sorted;
+};
+
+#endif // KNFONTFAMILYFILTERMODEL_H
@@ -0,0 +1,59 @@
+/*
+ * Copyright (C) Kreogist Dev Team
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#ifndef KNFONTFAMILYINFO_H
+#define KNFONTFAMILYINFO_H
+
+#include <QList>
+#include <QMetaType>
+#include <QStringList>
+#include <QVector>
+
+/*!
+ * \brief The KNFontFamilyInfo describes one family in the font catalog.
+ */
+struct KNFontFamilyInfo
+{
+    /*!
+     * \brief The family name.
+     */
+    QString family;
+    /*!
+     * \brief The style names provided by the family.
+     */
+    QStringList styles;
+    /*!
+     * \brief The available point sizes of the family.
+     */
+    QList<int> pointSizes;
+    /*!
+     * \brief The supported writing systems, bit n is set when the family
+     * supports the QFontDatabase::WritingSystem n.
+     */
+    quint64 writingSystems;
+    KNFontFamilyInfo() :
+        writingSystems(0)
+    {
+    }
+};
+
+typedef QVector<KNFontFamilyInfo> KNFontFamilyInfoList;
+
+Q_DECLARE_METATYPE(KNFontFamilyInfo)
+
+#endif // KNFONTFAMILYINFO_H
@@ -0,0 +1,264 @@
+/*
+ * Copyright (C) Kreogist Dev Team
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+#include <algorithm>
+#include <numeric>
+
+#include "kntrace.h"
+
+#include "knfontfamilymodel.h"
+
+KNFontFamilyModel::KNFontFamilyModel(QObject *parent) :
+    QAbstractListModel(parent),
+    m_nameOffsets(1, 0),
+    m_sortingEnabled(false)
+{
+}
+
+int KNFontFamilyModel::rowCount(const QModelIndex &parent) const
+{
+    //List model doesn't have any child.
+    if(parent.isValid())
+    {
+        return 0;
+    }
+    QReadLocker nameLocker(&m_nameLock);
+    return m_nameOffsets.size()-1;
+}
+
+QVariant KNFontFamilyModel::data(const QModelIndex &index, int role) const
+{
+    //Only provide the display data.
+    if(!index.isValid() || role!=Qt::DisplayRole)
+    {
+        return QVariant();
+    }
+    return family(index.row());
+}
+
+QString KNFontFamilyModel::family(int row) const
+{
+    QReadLocker nameLocker(&m_nameLock);
+    return familyRef(row).toString();
+}
+
+QStringList KNFontFamilyModel::families() const
+{
+    QReadLocker nameLocker(&m_nameLock);
+    QStringList familyList;
+    familyList.reserve(m_nameOffsets.size()-1);
+    for(int i=0, rows=m_nameOffsets.size()-1; i<rows; ++i)
+    {
+        familyList.append(familyRef(i).toString());
+    }
+    return familyList;
+}
+
+int KNFontFamilyModel::indexOf(const QString &family, int from) const
+{
+    //Check the rows which have the same key, the rows of a key are few.
+    uint key=nameKey(family);
+    QReadLocker nameLocker(&m_nameLock);
+    int matchedRow=-1;
+    for(QMultiHash<uint, int>::const_iterator i=m_nameIndex.constFind(key);
+        i!=m_nameIndex.constEnd() && i.key()==key;
+        ++i)
+    {
+        int row=i.value();
+        if(row<from || (matchedRow!=-1 && row>matchedRow))
+        {
+            continue;
+        }
+        QStringRef currentFamily=familyRef(row);
+        //Check the whole family name, or the family name before the foundry,
+        //e.g. "Family [Foundry]".
+        if(currentFamily.compare(family, Qt::CaseInsensitive)==0 ||
+                (currentFamily.size()>family.size()+1 &&
+                 currentFamily.at(family.size())==QLatin1Char(' ') &&
+                 currentFamily.at(family.size()+1)==QLatin1Char('[') &&
+                 currentFamily.startsWith(family, Qt::CaseInsensitive)))
+        {
+            matchedRow=row;
+        }
+    }
+    return matchedRow;
+}
+
+bool KNFontFamilyModel::isSortingEnabled() const
+{
+    return m_sortingEnabled;
+}
+
+void KNFontFamilyModel::enableSorting()
+{
+    if(m_sortingEnabled)
+    {
+        return;
+    }
+    QWriteLocker nameLocker(&m_nameLock);
+    m_sortingEnabled=true;
+    updateSortKeys();
+}
+
+int KNFontFamilyModel::sortRank(int row) const
+{
+    return m_sortRanks.at(row);
+}
+
+QLocale KNFontFamilyModel::collationLocale() const
+{
+    return m_collator.locale();
+}
+
+void KNFontFamilyModel::setCollationLocale(const QLocale &locale)
+{
+    if(m_collator.locale()==locale)
+    {
+        return;
+    }
+    {
+        QWriteLocker nameLocker(&m_nameLock);
+        m_collator.setLocale(locale);
+        //The keys are computed when the sorting is enabled.
+        if(!m_sortingEnabled)
+        {
+            return;
+        }
+        updateSortKeys();
+    }
+    emit sortOrderChanged();
+}
+
+void KNFontFamilyModel::setFamilies(const QStringList &families)
+{
+    //Reset the whole model.
+    beginResetModel();
+    {
+        QWriteLocker nameLocker(&m_nameLock);
+        m_names.clear();
+        m_nameOffsets=QVector<int>(1, 0);
+        m_nameIndex.clear();
+        m_sortKeys.clear();
+        m_sortOrder.clear();
+        appendNames(families);
+    }
+    endResetModel();
+}
+
+void KNFontFamilyModel::appendFamilies(const QStringList &families)
+{
+    //Ignore the empty batch.
+    if(families.isEmpty())
+    {
+        return;
+    }
+    //Insert the whole batch at once.
+    int rows=rowCount();
+    beginInsertRows(QModelIndex(), rows, rows+families.size()-1);
+    {
+        QWriteLocker nameLocker(&m_nameLock);
+        appendNames(families);
+    }
+    endInsertRows();
+}
+
+inline QStringRef KNFontFamilyModel::familyRef(int row) const
+{
+    return QStringRef(&m_names,
+                      m_nameOffsets.at(row),
+                      m_nameOffsets.at(row+1)-m_nameOffsets.at(row));
+}
+
+inline void KNFontFamilyModel::appendNames(const QStringList &families)
+{
+    //Reserve the buffers for the whole batch.
+    int nameLength=0;
+    for(const QString &family:families)
+    {
+        nameLength+=family.size();
+    }
+    m_names.reserve(m_names.size()+nameLength);
+    m_nameOffsets.reserve(m_nameOffsets.size()+families.size());
+    m_nameIndex.reserve(m_nameIndex.size()+families.size());
+    int firstRow=m_nameOffsets.size()-1;
+    for(const QString &family:families)
+    {
+        //Index the row before the name is appended.
+        m_nameIndex.insert(nameKey(family), m_nameOffsets.size()-1);
+        m_names.append(family);
+        m_nameOffsets.append(m_names.size());
+    }
+    //The keys are computed when the sorting is enabled.
+    if(!m_sortingEnabled)
+    {
+        return;
+    }
+    //The key is only computed once, the ranks compare the keys.
+    m_sortKeys.reserve(m_sortKeys.size()+families.size());
+    for(const QString &family:families)
+    {
+        m_sortKeys.append(m_collator.sortKey(family));
+    }
+    updateSortRanks(firstRow);
+}
+
+inline void KNFontFamilyModel::updateSortKeys()
+{
+    //Compute the keys of all the families, and rank them again.
+    m_sortKeys.clear();
+    m_sortKeys.reserve(m_nameOffsets.size()-1);
+    for(int i=0, rows=m_nameOffsets.size()-1; i<rows; ++i)
+    {
+        m_sortKeys.append(m_collator.sortKey(familyRef(i).toString()));
+    }
+    m_sortOrder.clear();
+    updateSortRanks(0);
+}
+
+inline void KNFontFamilyModel::updateSortRanks(int firstRow)
+{
+    KN_TRACE_SCOPE("KNFontFamilyModel::updateSortRanks");
+    auto keyLess=[this](int left, int right)
+    {
+        return m_sortKeys.at(left).compare(m_sortKeys.at(right))<0;
+    };
+    //The rows before the first row are already sorted. Only sort the new
+    //rows, then merge them after the equal existing rows, so the ties keep
+    //the row order.
+    m_sortOrder.resize(m_sortKeys.size());
+    std::iota(m_sortOrder.begin()+firstRow, m_sortOrder.end(), firstRow);
+    std::stable_sort(m_sortOrder.begin()+firstRow, m_sortOrder.end(), keyLess);
+    std::inplace_merge(m_sortOrder.begin(),
+                       m_sortOrder.begin()+firstRow,
+                       m_sortOrder.end(),
+                       keyLess);
+    m_sortRanks.resize(m_sortOrder.size());
+    for(int i=0; i<m_sortOrder.size(); ++i)
+    {
+        m_sortRanks[m_sortOrder.at(i)]=i;
+    }
+}
+
+inline uint KNFontFamilyModel::nameKey(const QString &family)
+{
+    //The foundry is not a part of the key, so the family name only could
+    //find the family with a foundry.
+    int foundryIndex=family.indexOf(QLatin1String(" ["));
+    return qHash(foundryIndex==-1?
+                     family.toCaseFolded():
+                     family.left(foundryIndex).toCaseFolded());
+}
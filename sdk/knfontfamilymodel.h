@@ -0,0 +1,160 @@
+/*
+ * Copyright (C) Kreogist Dev Team
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#ifndef KNFONTFAMILYMODEL_H
+#define KNFONTFAMILYMODEL_H
+
+#include <QAbstractListModel>
+#include <QCollator>
+#include <QMultiHash>
+#include <QReadWriteLock>
+#include <QStringList>
+#include <QVector>
+
+/*!
+ * \brief The KNFontFamilyModel is a read-only list model of font family names.
+ * The families could be appended in batches, each batch only inserts rows
+ * once.\n
+ * All the names are stored in one UTF-16 buffer, and a hash index maps the
+ * case-folded names to rows, so finding a family doesn't depend on the number
+ * of the families.\n
+ * When the sorting is enabled, a collation key is computed once for every
+ * family, the families are ranked by the keys of the collation locale, so a
+ * proxy could sort the rows by comparing the integer ranks. A new batch is
+ * sorted and merged into the existing order. The keys are not computed until
+ * the sorting is enabled.\n
+ * family(), families() and indexOf() could be called from any thread, the
+ * families are only changed on the thread of the model.
+ */
+class KNFontFamilyModel : public QAbstractListModel
+{
+    Q_OBJECT
+public:
+    /*!
+     * \brief Construct a KNFontFamilyModel.
+     * \param parent The parent object.
+     */
+    explicit KNFontFamilyModel(QObject *parent = 0);
+
+    /*!
+     * \brief Reimplemented from QAbstractListModel::rowCount().
+     */
+    int rowCount(const QModelIndex &parent=QModelIndex()) const Q_DECL_OVERRIDE;
+
+    /*!
+     * \brief Reimplemented from QAbstractListModel::data().
+     */
+    QVariant data(const QModelIndex &index,
+                  int role=Qt::DisplayRole) const Q_DECL_OVERRIDE;
+
+    /*!
+     * \brief Get the family name of a row.
+     * \param row The row of the family.
+     * \return The family name.
+     */
+    QString family(int row) const;
+
+    /*!
+     * \brief Get all the families in the model.
+     * \return The family list.
+     */
+    QStringList families() const;
+
+    /*!
+     * \brief Find a family case-insensitively. A family with a foundry, e.g.
+     * "Family [Foundry]", is also matched by the family name only.
+     * \param family The family name.
+     * \param from The first row to check.
+     * \return The first matched row from the given row. If the family cannot
+     * be found, return -1.
+     */
+    int indexOf(const QString &family, int from=0) const;
+
+    /*!
+     * \brief Get whether the families are ranked by the collation locale.
+     * \return If the sorting is enabled, return true.
+     */
+    bool isSortingEnabled() const;
+
+    /*!
+     * \brief Enable ranking the families by the collation locale. The
+     * collation keys of all the families are computed at the first call, the
+     * families appended later are ranked when they are added. It is disabled
+     * by default.
+     */
+    void enableSorting();
+
+    /*!
+     * \brief Get the position of a row when all the families are sorted by
+     * the collation locale. It is only valid when the sorting is enabled.
+     * \param row The row of the family.
+     * \return The sort rank of the row.
+     */
+    int sortRank(int row) const;
+
+    /*!
+     * \brief Get the locale used to sort the families.
+     * \return The collation locale.
+     */
+    QLocale collationLocale() const;
+
+    /*!
+     * \brief Set the locale used to sort the families, the collation keys of
+     * all the families are computed again when the sorting is enabled. By
+     * default it is the default locale.
+     * \param locale The collation locale.
+     */
+    void setCollationLocale(const QLocale &locale);
+
+signals:
+    /*!
+     * \brief When the sort ranks of the existing rows are changed by the
+     * collation locale, this signal will be emitted.
+     */
+    void sortOrderChanged();
+
+public slots:
+    /*!
+     * \brief Replace all the families in the model.
+     * \param families The family list.
+     */
+    void setFamilies(const QStringList &families);
+
+    /*!
+     * \brief Append a batch of families to the end of the model.
+     * \param families The family batch.
+     */
+    void appendFamilies(const QStringList &families);
+
+private:
+    inline QStringRef familyRef(int row) const;
+    inline void appendNames(const QStringList &families);
+    static inline uint nameKey(const QString &family);
+    inline void updateSortKeys();
+    inline void updateSortRanks(int firstRow);
+    QString m_names;
+    QVector<int> m_nameOffsets;
+    QMultiHash<uint, int> m_nameIndex;
+    QCollator m_collator;
+    QVector<QCollatorSortKey> m_sortKeys;
+    QVector<int> m_sortOrder, m_sortRanks;
+    mutable QReadWriteLock m_nameLock;
+    bool m_sortingEnabled;
+};
+
+#endif // KNFONTFAMILYMODEL_H
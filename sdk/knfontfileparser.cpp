@@ -0,0 +1,533 @@
+/*
+ * Copyright (C) Kreogist Dev Team
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+#include <QDir>
+#include <QDirIterator>
+#include <QFile>
+#include <QFontDatabase>
+#include <QHash>
+#include <QStandardPaths>
+#include <QtConcurrent/QtConcurrent>
+#include <QtEndian>
+
+#include <algorithm>
+#include <cstring>
+
+#include "kntrace.h"
+
+#include "knfontfileparser.h"
+
+#define TagTtcf 0x74746366
+#define TagName 0x6E616D65
+#define TagOs2 0x4F532F32
+#define TagCmap 0x636D6170
+#define TagFvar 0x66766172
+//The name ids.
+#define NameFamily 1
+#define NameSubfamily 2
+#define NameTypographicFamily 16
+#define NameTypographicSubfamily 17
+//The code page bits of OS/2 ulCodePageRange1.
+#define CodePageJapanese 17
+#define CodePageSimplifiedChinese 18
+#define CodePageKorean 19
+#define CodePageTraditionalChinese 20
+#define CodePageKoreanJohab 21
+#define CodePageSymbol 31
+
+namespace
+{
+inline quint16 readUInt16(const uchar *data)
+{
+    return qFromBigEndian<quint16>(data);
+}
+
+inline quint32 readUInt32(const uchar *data)
+{
+    return qFromBigEndian<quint32>(data);
+}
+
+//A table in the mapped file.
+struct FontTable
+{
+    const uchar *data;
+    quint32 size;
+    FontTable() :
+        data(nullptr),
+        size(0)
+    {
+    }
+};
+
+//The Unicode range bit of a writing system, the same bits as Qt uses for the
+//TrueType fonts.
+struct WritingSystemBit
+{
+    QFontDatabase::WritingSystem writingSystem;
+    int bit;
+};
+
+const WritingSystemBit WritingSystemBits[]=
+{
+    {QFontDatabase::Latin, 0},
+    {QFontDatabase::Greek, 7},
+    {QFontDatabase::Cyrillic, 9},
+    {QFontDatabase::Armenian, 10},
+    {QFontDatabase::Hebrew, 11},
+    {QFontDatabase::Arabic, 13},
+    {QFontDatabase::Syriac, 71},
+    {QFontDatabase::Thaana, 72},
+    {QFontDatabase::Devanagari, 15},
+    {QFontDatabase::Bengali, 16},
+    {QFontDatabase::Gurmukhi, 17},
+    {QFontDatabase::Gujarati, 18},
+    {QFontDatabase::Oriya, 19},
+    {QFontDatabase::Tamil, 20},
+    {QFontDatabase::Telugu, 21},
+    {QFontDatabase::Kannada, 22},
+    {QFontDatabase::Malayalam, 23},
+    {QFontDatabase::Sinhala, 73},
+    {QFontDatabase::Thai, 24},
+    {QFontDatabase::Lao, 25},
+    {QFontDatabase::Tibetan, 70},
+    {QFontDatabase::Myanmar, 74},
+    {QFontDatabase::Georgian, 26},
+    {QFontDatabase::Khmer, 80},
+    {QFontDatabase::Korean, 56},
+    {QFontDatabase::Vietnamese, 0},
+    {QFontDatabase::Ogham, 78},
+    {QFontDatabase::Runic, 79},
+    {QFontDatabase::Nko, 14}
+};
+
+inline FontTable findTable(const uchar *data, qint64 size,
+                           quint32 faceOffset, quint32 tag)
+{
+    FontTable table;
+    if((qint64)faceOffset+12>size)
+    {
+        return table;
+    }
+    quint32 tableCount=readUInt16(data+faceOffset+4);
+    if((qint64)faceOffset+12+(qint64)tableCount*16>size)
+    {
+        return table;
+    }
+    //Some fonts don't sort the table records, check all of them.
+    const uchar *records=data+faceOffset+12;
+    for(quint32 i=0; i<tableCount; ++i)
+    {
+        const uchar *record=records+i*16;
+        if(readUInt32(record)==tag)
+        {
+            quint32 offset=readUInt32(record+8),
+                    length=readUInt32(record+12);
+            if((qint64)offset+length<=size)
+            {
+                table.data=data+offset;
+                table.size=length;
+            }
+            break;
+        }
+    }
+    return table;
+}
+
+//Decode a name string in place, it is the only copy of the name.
+inline QString decodeName(const uchar *string, quint32 length,
+                          bool utf16)
+{
+    if(!utf16)
+    {
+        return QString::fromLatin1(reinterpret_cast<const char *>(string),
+                                   length);
+    }
+    QString name(length>>1, Qt::Uninitialized);
+    QChar *nameData=name.data();
+    for(quint32 i=0; i<(length>>1); ++i)
+    {
+        nameData[i]=QChar(readUInt16(string+i*2));
+    }
+    return name;
+}
+
+//Find a name, the English Windows name is preferred, then any Windows name,
+//the Unicode name and the Macintosh Roman name.
+QString findName(const FontTable &nameTable, quint16 nameId)
+{
+    if(nameTable.size<6)
+    {
+        return QString();
+    }
+    quint32 recordCount=readUInt16(nameTable.data+2),
+            stringOffset=readUInt16(nameTable.data+4);
+    if(6+recordCount*12>nameTable.size)
+    {
+        return QString();
+    }
+    int bestScore=0;
+    const uchar *bestRecord=nullptr;
+    for(quint32 i=0; i<recordCount; ++i)
+    {
+        const uchar *record=nameTable.data+6+i*12;
+        if(readUInt16(record+6)!=nameId)
+        {
+            continue;
+        }
+        quint16 platformId=readUInt16(record),
+                encodingId=readUInt16(record+2),
+                languageId=readUInt16(record+4);
+        int score=0;
+        if(platformId==3 && (encodingId==0 || encodingId==1 ||
+                             encodingId==10))
+        {
+            score=(languageId==0x0409)?4:3;
+        }
+        else if(platformId==0)
+        {
+            score=2;
+        }
+        else if(platformId==1 && encodingId==0 && languageId==0)
+        {
+            score=1;
+        }
+        if(score>bestScore)
+        {
+            bestScore=score;
+            bestRecord=record;
+        }
+    }
+    if(bestRecord==nullptr)
+    {
+        return QString();
+    }
+    quint32 length=readUInt16(bestRecord+8),
+            offset=stringOffset+readUInt16(bestRecord+10);
+    if(offset+length>nameTable.size)
+    {
+        return QString();
+    }
+    return decodeName(nameTable.data+offset, length, bestScore>1);
+}
+
+inline void readOs2(const FontTable &os2Table, KNFontFaceInfo &faceInfo)
+{
+    //The version 0 table is 78 bytes, the code pages need version 1.
+    if(os2Table.size<78)
+    {
+        return;
+    }
+    const uchar *os2=os2Table.data;
+    faceInfo.weight=readUInt16(os2+4);
+    faceInfo.width=readUInt16(os2+6);
+    memcpy(faceInfo.panose, os2+32, sizeof(faceInfo.panose));
+    for(int i=0; i<4; ++i)
+    {
+        faceInfo.unicodeRanges[i]=readUInt32(os2+42+i*4);
+    }
+    //fsSelection bit 0 is italic, bit 9 is oblique.
+    quint16 selection=readUInt16(os2+62);
+    faceInfo.italic=(selection & 0x0201);
+    if(readUInt16(os2)>=1 && os2Table.size>=86)
+    {
+        faceInfo.codePageRanges[0]=readUInt32(os2+78);
+        faceInfo.codePageRanges[1]=readUInt32(os2+82);
+    }
+}
+
+inline bool hasSymbolCmap(const FontTable &cmapTable)
+{
+    if(cmapTable.size<4)
+    {
+        return false;
+    }
+    quint32 encodingCount=readUInt16(cmapTable.data+2);
+    if(4+encodingCount*8>cmapTable.size)
+    {
+        return false;
+    }
+    for(quint32 i=0; i<encodingCount; ++i)
+    {
+        const uchar *record=cmapTable.data+4+i*8;
+        //Windows symbol encoding.
+        if(readUInt16(record)==3 && readUInt16(record+2)==0)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+inline void readFvar(const FontTable &fvarTable,
+                     const FontTable &nameTable,
+                     KNFontFaceInfo &faceInfo)
+{
+    if(fvarTable.size<16)
+    {
+        return;
+    }
+    const uchar *fvar=fvarTable.data;
+    //The sizes are computed in 64 bits, the products of the 16-bit fields
+    //could overflow 32 bits.
+    qint64 axesOffset=readUInt16(fvar+4),
+           axisCount=readUInt16(fvar+8),
+           axisSize=readUInt16(fvar+10),
+           instanceCount=readUInt16(fvar+12),
+           instanceSize=readUInt16(fvar+14),
+           instancesOffset=axesOffset+axisCount*axisSize;
+    if(instanceSize<4 ||
+            instancesOffset+instanceCount*instanceSize>fvarTable.size)
+    {
+        return;
+    }
+    for(qint64 i=0; i<instanceCount; ++i)
+    {
+        QString instanceStyle=findName(nameTable, readUInt16(
+                                           fvar+instancesOffset+
+                                           i*instanceSize));
+        if(!instanceStyle.isEmpty() &&
+                !faceInfo.instanceStyles.contains(instanceStyle))
+        {
+            faceInfo.instanceStyles.append(instanceStyle);
+        }
+    }
+}
+
+inline quint64 writingSystems(const KNFontFaceInfo &faceInfo,
+                              bool symbolCmap)
+{
+    quint64 supported=0;
+    for(const WritingSystemBit &writingSystemBit : WritingSystemBits)
+    {
+        if(faceInfo.unicodeRanges[writingSystemBit.bit>>5] &
+                (1u << (writingSystemBit.bit & 31)))
+        {
+            supported|=(Q_UINT64_C(1) << writingSystemBit.writingSystem);
+        }
+    }
+    //The CJK writing systems are told by the code pages.
+    quint32 codePages=faceInfo.codePageRanges[0];
+    if(codePages & (1u << CodePageSimplifiedChinese))
+    {
+        supported|=(Q_UINT64_C(1) << QFontDatabase::SimplifiedChinese);
+    }
+    if(codePages & (1u << CodePageTraditionalChinese))
+    {
+        supported|=(Q_UINT64_C(1) << QFontDatabase::TraditionalChinese);
+    }
+    if(codePages & (1u << CodePageJapanese))
+    {
+        supported|=(Q_UINT64_C(1) << QFontDatabase::Japanese);
+    }
+    if(codePages & ((1u << CodePageKorean) | (1u << CodePageKoreanJohab)))
+    {
+        supported|=(Q_UINT64_C(1) << QFontDatabase::Korean);
+    }
+    //A font without any script is a symbol font.
+    if(supported==0 || symbolCmap || (codePages & (1u << CodePageSymbol)))
+    {
+        supported|=(Q_UINT64_C(1) << QFontDatabase::Symbol);
+    }
+    return supported;
+}
+
+bool parseFace(const uchar *data, qint64 size, quint32 faceOffset,
+               KNFontFaceInfo &faceInfo)
+{
+    FontTable nameTable=findTable(data, size, faceOffset, TagName);
+    //The typographic names group the faces of the large families.
+    faceInfo.family=findName(nameTable, NameTypographicFamily);
+    faceInfo.style=findName(nameTable, NameTypographicSubfamily);
+    if(faceInfo.family.isEmpty())
+    {
+        faceInfo.family=findName(nameTable, NameFamily);
+    }
+    if(faceInfo.style.isEmpty())
+    {
+        faceInfo.style=findName(nameTable, NameSubfamily);
+    }
+    if(faceInfo.family.isEmpty())
+    {
+        return false;
+    }
+    readOs2(findTable(data, size, faceOffset, TagOs2), faceInfo);
+    readFvar(findTable(data, size, faceOffset, TagFvar), nameTable,
+             faceInfo);
+    faceInfo.writingSystems=writingSystems(
+                faceInfo,
+                hasSymbolCmap(findTable(data, size, faceOffset, TagCmap)));
+    return true;
+}
+
+inline bool faceLessThan(const KNFontFaceInfo &left,
+                         const KNFontFaceInfo &right)
+{
+    if(left.width!=right.width)
+    {
+        return left.width<right.width;
+    }
+    if(left.italic!=right.italic)
+    {
+        return right.italic;
+    }
+    return left.weight<right.weight;
+}
+}
+
+KNFontFaceInfoList KNFontFileParser::parseFile(const QString &filePath)
+{
+    QFile fontFile(filePath);
+    if(!fontFile.open(QIODevice::ReadOnly))
+    {
+        return KNFontFaceInfoList();
+    }
+    //Only the pages of the tables are read.
+    qint64 fileSize=fontFile.size();
+    const uchar *fontData=fontFile.map(0, fileSize);
+    if(fontData==nullptr)
+    {
+        return KNFontFaceInfoList();
+    }
+    return parseData(fontData, fileSize);
+}
+
+KNFontFaceInfoList KNFontFileParser::parseData(const uchar *data,
+                                               qint64 size)
+{
+    KNFontFaceInfoList faces;
+    if(size<12)
+    {
+        return faces;
+    }
+    //A collection contains the offsets of its faces.
+    QVector<quint32> faceOffsets;
+    if(readUInt32(data)==TagTtcf)
+    {
+        quint32 faceCount=readUInt32(data+8);
+        if(12+(qint64)faceCount*4>size)
+        {
+            return faces;
+        }
+        faceOffsets.reserve(faceCount);
+        for(quint32 i=0; i<faceCount; ++i)
+        {
+            faceOffsets.append(readUInt32(data+12+i*4));
+        }
+    }
+    else
+    {
+        faceOffsets.append(0);
+    }
+    for(quint32 faceOffset : faceOffsets)
+    {
+        KNFontFaceInfo faceInfo;
+        if(parseFace(data, size, faceOffset, faceInfo))
+        {
+            faces.append(faceInfo);
+        }
+    }
+    return faces;
+}
+
+QStringList KNFontFileParser::fontDirectories()
+{
+    QString dataHome=QString::fromLocal8Bit(qgetenv("XDG_DATA_HOME"));
+    if(dataHome.isEmpty())
+    {
+        dataHome=QDir::homePath()+"/.local/share";
+    }
+    QStringList fontDirs=
+            QStandardPaths::standardLocations(QStandardPaths::FontsLocation);
+    fontDirs << "/usr/share/fonts"
+             << "/usr/local/share/fonts"
+             << QDir::homePath()+"/.fonts"
+             << dataHome+"/fonts";
+    fontDirs.removeDuplicates();
+    return fontDirs;
+}
+
+QStringList KNFontFileParser::fontFiles(const QStringList &directories)
+{
+    QStringList filePaths;
+    for(const QString &directory : directories)
+    {
+        QDirIterator fileIterator(directory,
+                                  QStringList() << "*.ttf" << "*.otf"
+                                                << "*.ttc" << "*.otc"
+                                                << "*.TTF" << "*.OTF"
+                                                << "*.TTC" << "*.OTC",
+                                  QDir::Files,
+                                  QDirIterator::Subdirectories |
+                                  QDirIterator::FollowSymlinks);
+        while(fileIterator.hasNext())
+        {
+            filePaths.append(fileIterator.next());
+        }
+    }
+    //The same file could be linked into several directories.
+    filePaths.removeDuplicates();
+    return filePaths;
+}
+
+KNFontFamilyInfoList KNFontFileParser::parseFamilies(
+        const QStringList &filePaths)
+{
+    KN_TRACE_SCOPE("KNFontFileParser::parseFamilies");
+    //Parse the files in parallel.
+    QList<KNFontFaceInfoList> fileFaces=
+            QtConcurrent::blockingMapped(filePaths,
+                                         &KNFontFileParser::parseFile);
+    //Group the faces by the family.
+    QHash<QString, KNFontFaceInfoList> familyFaces;
+    for(const KNFontFaceInfoList &faces : fileFaces)
+    {
+        for(const KNFontFaceInfo &faceInfo : faces)
+        {
+            familyFaces[faceInfo.family].append(faceInfo);
+        }
+    }
+    KNFontFamilyInfoList familyInfos;
+    familyInfos.reserve(familyFaces.size());
+    for(auto i=familyFaces.begin(); i!=familyFaces.end(); ++i)
+    {
+        KNFontFaceInfoList &faces=i.value();
+        std::sort(faces.begin(), faces.end(), faceLessThan);
+        KNFontFamilyInfo familyInfo;
+        familyInfo.family=i.key();
+        for(const KNFontFaceInfo &faceInfo : faces)
+        {
+            //The named instances are the styles of a variable font.
+            QStringList styles=faceInfo.instanceStyles.isEmpty()?
+                        QStringList(faceInfo.style):faceInfo.instanceStyles;
+            for(const QString &style : styles)
+            {
+                if(!style.isEmpty() && !familyInfo.styles.contains(style))
+                {
+                    familyInfo.styles.append(style);
+                }
+            }
+            familyInfo.writingSystems|=faceInfo.writingSystems;
+        }
+        familyInfos.append(familyInfo);
+    }
+    std::sort(familyInfos.begin(), familyInfos.end(),
+              [](const KNFontFamilyInfo &left, const KNFontFamilyInfo &right)
+    {
+        return QString::localeAwareCompare(left.family, right.family)<0;
+    });
+    return familyInfos;
+}
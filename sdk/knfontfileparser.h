@@ -0,0 +1,139 @@
+/*
+ * Copyright (C) Kreogist Dev Team
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+#ifndef KNFONTFILEPARSER_H
+#define KNFONTFILEPARSER_H
+
+#include <QStringList>
+#include <QVector>
+
+#include "knfontfamilyinfo.h"
+
+/*!
+ * \brief The KNFontFaceInfo describes one face read from a font file.
+ */
+struct KNFontFaceInfo
+{
+    /*!
+     * \brief The typographic family name, or the family name when the font
+     * doesn't provide the typographic name.
+     */
+    QString family;
+    /*!
+     * \brief The typographic style name, or the subfamily name.
+     */
+    QString style;
+    /*!
+     * \brief The style names of the named instances of a variable font.
+     */
+    QStringList instanceStyles;
+    /*!
+     * \brief The OS/2 usWeightClass of the face, 100 to 900.
+     */
+    quint16 weight;
+    /*!
+     * \brief The OS/2 usWidthClass of the face, 1 to 9.
+     */
+    quint16 width;
+    /*!
+     * \brief Whether the face is italic or oblique.
+     */
+    bool italic;
+    /*!
+     * \brief The PANOSE classification of the face.
+     */
+    quint8 panose[10];
+    /*!
+     * \brief The OS/2 Unicode range bits.
+     */
+    quint32 unicodeRanges[4];
+    /*!
+     * \brief The OS/2 code page range bits.
+     */
+    quint32 codePageRanges[2];
+    /*!
+     * \brief The supported writing systems, bit n is set when the face
+     * supports the QFontDatabase::WritingSystem n.
+     */
+    quint64 writingSystems;
+    KNFontFaceInfo() :
+        weight(400),
+        width(5),
+        italic(false),
+        panose(),
+        unicodeRanges(),
+        codePageRanges(),
+        writingSystems(0)
+    {
+    }
+};
+
+typedef QVector<KNFontFaceInfo> KNFontFaceInfoList;
+
+/*!
+ * \brief The KNFontFileParser reads the font metadata from the TrueType and
+ * OpenType files without the font engines. A font file is memory mapped, the
+ * name, OS/2, cmap and fvar tables are read in place, only the result strings
+ * are allocated.\n
+ * All the functions are thread-safe.
+ */
+class KNFontFileParser
+{
+public:
+    /*!
+     * \brief Parse all the faces in a font file or a font collection.
+     * \param filePath The font file path.
+     * \return The faces in the file. If the file is not a valid font, return
+     * an empty list.
+     */
+    static KNFontFaceInfoList parseFile(const QString &filePath);
+
+    /*!
+     * \brief Parse all the faces in the font data.
+     * \param data The font file data.
+     * \param size The size of the data.
+     * \return The faces in the data.
+     */
+    static KNFontFaceInfoList parseData(const uchar *data, qint64 size);
+
+    /*!
+     * \brief Get the directories which contains the system and the user
+     * fonts.
+     * \return The font directory paths.
+     */
+    static QStringList fontDirectories();
+
+    /*!
+     * \brief Find all the TrueType and OpenType files under the directories.
+     * \param directories The directory paths.
+     * \return The font file paths.
+     */
+    static QStringList fontFiles(const QStringList &directories);
+
+    /*!
+     * \brief Parse the font files in parallel, and merge the faces of the
+     * same family.
+     * \param filePaths The font file paths.
+     * \return The family list, sorted by the family name.
+     */
+    static KNFontFamilyInfoList parseFamilies(const QStringList &filePaths);
+
+private:
+    KNFontFileParser();
+};
+
+#endif // KNFONTFILEPARSER_H
@@ -0,0 +1,279 @@
+/*
+ * Copyright (C) Kreogist Dev Team
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+#include <QApplication>
+#include <QFontDatabase>
+#include <QFontMetrics>
+#include <QMutex>
+#include <QPainter>
+#include <QRunnable>
+#include <QThread>
+#include <QThreadPool>
+
+#include "kntrace.h"
+#include "knfontpreviewdelegate.h"
+
+//The height of a family row in pixels.
+#define ThumbnailHeight 28
+//The maximum width of a thumbnail in pixels.
+#define ThumbnailMaximumWidth 400
+//The default cache size in kilobytes.
+#define ThumbnailCacheLimit 8192
+
+namespace
+{
+inline int thumbnailCost(const QImage &image)
+{
+    //The cost of a thumbnail is its size in kilobytes.
+    return qMax(1, (int)(((qint64)image.bytesPerLine()*image.height())>>10));
+}
+}
+
+class KNFontThumbnailTask : public QRunnable
+{
+public:
+    KNFontThumbnailTask(KNFontPreviewDelegate *delegate,
+                        const QString &key,
+                        const QString &family,
+                        const QString &text,
+                        qreal devicePixelRatio,
+                        QRgb color) :
+        m_delegate(delegate),
+        m_key(key),
+        m_family(family),
+        m_text(text),
+        m_devicePixelRatio(devicePixelRatio),
+        m_color(color)
+    {
+    }
+
+    void run() Q_DECL_OVERRIDE
+    {
+        {
+            //The request is canceled after the task is taken from the queue,
+            //or it is rendered by another task.
+            QMutexLocker queueLocker(&m_delegate->m_queueLock);
+            if(!m_delegate->m_queuedRequests.remove(m_key))
+            {
+                return;
+            }
+        }
+        //Render the thumbnail and send it back to the delegate. The delegate
+        //waits for all the tasks before it is deleted.
+        QMetaObject::invokeMethod(m_delegate,
+                                  "onActionThumbnailRendered",
+                                  Qt::QueuedConnection,
+                                  Q_ARG(QString, m_key),
+                                  Q_ARG(QImage,
+                                        KNFontPreviewDelegate::renderThumbnail(
+                                            m_family,
+                                            m_text,
+                                            ThumbnailHeight,
+                                            m_devicePixelRatio,
+                                            m_color)));
+    }
+
+private:
+    KNFontPreviewDelegate *m_delegate;
+    QString m_key, m_family, m_text;
+    qreal m_devicePixelRatio;
+    QRgb m_color;
+};
+
+KNFontPreviewDelegate::KNFontPreviewDelegate(QObject *parent) :
+    QStyledItemDelegate(parent),
+    m_thumbnails(ThumbnailCacheLimit),
+    m_renderPool(new QThreadPool(this)),
+    m_threadedRendering(QFontDatabase::supportsThreadedFontRendering())
+{
+    //Leave one core for the GUI thread.
+    m_renderPool->setMaxThreadCount(qMax(1, QThread::idealThreadCount()-1));
+}
+
+KNFontPreviewDelegate::~KNFontPreviewDelegate()
+{
+    //Remove the queued tasks and wait for the running ones.
+    m_renderPool->clear();
+    m_renderPool->waitForDone();
+}
+
+void KNFontPreviewDelegate::paint(QPainter *painter,
+                                  const QStyleOptionViewItem &option,
+                                  const QModelIndex &index) const
+{
+    KN_TRACE_SCOPE("KNFontPreviewDelegate::paint");
+    QStyleOptionViewItem itemOption=option;
+    initStyleOption(&itemOption, index);
+    QString family=itemOption.text;
+    //Draw the background and the selection without the text.
+    const QWidget *widget=itemOption.widget;
+    QStyle *style=widget==nullptr?QApplication::style():widget->style();
+    itemOption.text.clear();
+    style->drawControl(QStyle::CE_ItemViewItem, &itemOption, painter, widget);
+    QRect textRect=style->subElementRect(QStyle::SE_ItemViewItemText,
+                                         &itemOption,
+                                         widget);
+    //Find the thumbnail.
+    QColor textColor=itemOption.palette.color(
+                (itemOption.state & QStyle::State_Selected)?
+                    QPalette::HighlightedText:
+                    QPalette::Text);
+    qreal devicePixelRatio=painter->device()->devicePixelRatioF();
+    QString sampleText=m_sampleText.isEmpty()?family:m_sampleText,
+            key=family+QChar('\n')+sampleText+QChar('\n')+
+                QString::number(devicePixelRatio)+QChar('\n')+
+                QString::number(textColor.rgba(), 16);
+    QImage *thumbnail=m_thumbnails.object(key);
+    if(thumbnail==nullptr && !m_threadedRendering)
+    {
+        //Render the thumbnail directly when the fonts cannot be used in
+        //threads.
+        thumbnail=new QImage(renderThumbnail(family,
+                                             sampleText,
+                                             ThumbnailHeight,
+                                             devicePixelRatio,
+                                             textColor.rgba()));
+        if(!m_thumbnails.insert(key, thumbnail, thumbnailCost(*thumbnail)))
+        {
+            //The thumbnail is larger than the cache, don't render it again.
+            thumbnail=nullptr;
+            m_rejectedKeys.insert(key);
+        }
+    }
+    if(thumbnail!=nullptr)
+    {
+        //Paint the thumbnail at the center of the text rect.
+        painter->save();
+        painter->setClipRect(textRect);
+        painter->drawImage(
+                    QPoint(textRect.left(),
+                           textRect.top()+
+                           (textRect.height()-
+                            (int)(thumbnail->height()/
+                                  thumbnail->devicePixelRatio()))/2),
+                    *thumbnail);
+        painter->restore();
+        return;
+    }
+    //Paint the family name as the placeholder.
+    painter->save();
+    painter->setPen(textColor);
+    painter->drawText(textRect,
+                      Qt::AlignLeft | Qt::AlignVCenter,
+                      itemOption.fontMetrics.elidedText(family,
+                                                        Qt::ElideRight,
+                                                        textRect.width()));
+    painter->restore();
+    //Request the thumbnail, unless it cannot be cached.
+    if(!m_pendingRequests.contains(key) && !m_rejectedKeys.contains(key))
+    {
+        m_pendingRequests.insert(key);
+        QMutexLocker queueLocker(&m_queueLock);
+        m_queuedRequests.insert(key);
+        m_renderPool->start(
+                    new KNFontThumbnailTask(
+                        const_cast<KNFontPreviewDelegate *>(this),
+                        key,
+                        family,
+                        sampleText,
+                        devicePixelRatio,
+                        textColor.rgba()));
+    }
+}
+
+QSize KNFontPreviewDelegate::sizeHint(const QStyleOptionViewItem &option,
+                                      const QModelIndex &index) const
+{
+    //All the rows have the same height.
+    QSize itemSize=QStyledItemDelegate::sizeHint(option, index);
+    itemSize.setHeight(qMax(itemSize.height(), ThumbnailHeight));
+    return itemSize;
+}
+
+void KNFontPreviewDelegate::setSampleText(const QString &sampleText)
+{
+    m_sampleText=sampleText;
+    //All the pending thumbnails are useless.
+    cancelPendingRequests();
+}
+
+void KNFontPreviewDelegate::setCacheLimit(int kilobytes)
+{
+    m_thumbnails.setMaxCost(kilobytes);
+    //The rejected thumbnails might fit in the new cache.
+    m_rejectedKeys.clear();
+}
+
+void KNFontPreviewDelegate::cancelPendingRequests()
+{
+    //Remove the tasks which haven't been started, only forget their keys. The
+    //running tasks will still be cached, so their keys are kept pending.
+    QMutexLocker queueLocker(&m_queueLock);
+    m_renderPool->clear();
+    for(const QString &key:m_queuedRequests)
+    {
+        m_pendingRequests.remove(key);
+    }
+    m_queuedRequests.clear();
+}
+
+void KNFontPreviewDelegate::onActionThumbnailRendered(const QString &key,
+                                                      const QImage &image)
+{
+    m_pendingRequests.remove(key);
+    //Save the thumbnail to cache. If the thumbnail is larger than the cache,
+    //the cache deletes it, keep the placeholder and never request it again.
+    if(!m_thumbnails.insert(key, new QImage(image), thumbnailCost(image)))
+    {
+        m_rejectedKeys.insert(key);
+        return;
+    }
+    emit thumbnailReady();
+}
+
+QImage KNFontPreviewDelegate::renderThumbnail(const QString &family,
+                                              const QString &text,
+                                              int height,
+                                              qreal devicePixelRatio,
+                                              QRgb color)
+{
+    KN_TRACE_SCOPE("KNFontPreviewDelegate::renderThumbnail");
+    //Prepare the font.
+    QFont thumbnailFont(family);
+    thumbnailFont.setPixelSize(qMax(1, height*6/10));
+    QFontMetrics thumbnailMetrics(thumbnailFont);
+#if QT_VERSION >= QT_VERSION_CHECK(5, 11, 0)
+    int width=qMin(thumbnailMetrics.horizontalAdvance(text)+2,
+                   ThumbnailMaximumWidth);
+#else
+    int width=qMin(thumbnailMetrics.width(text)+2, ThumbnailMaximumWidth);
+#endif
+    //Generate the image.
+    QImage thumbnail(QSize(width, height)*devicePixelRatio,
+                     QImage::Format_ARGB32_Premultiplied);
+    thumbnail.setDevicePixelRatio(devicePixelRatio);
+    thumbnail.fill(Qt::transparent);
+    //Draw the text.
+    QPainter painter(&thumbnail);
+    painter.setRenderHint(QPainter::TextAntialiasing);
+    painter.setFont(thumbnailFont);
+    painter.setPen(QColor::fromRgba(color));
+    painter.drawText(QRect(0, 0, width, height),
+                     Qt::AlignLeft | Qt::AlignVCenter,
+                     text);
+    return thumbnail;
+}
@@ -0,0 +1,107 @@
+/*
+ * Copyright (C) Kreogist Dev Team
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#ifndef KNFONTPREVIEWDELEGATE_H
+#define KNFONTPREVIEWDELEGATE_H
+
+#include <QCache>
+#include <QImage>
+#include <QMutex>
+#include <QSet>
+
+#include <QStyledItemDelegate>
+
+class QThreadPool;
+/*!
+ * \brief The KNFontPreviewDelegate paints every font family in its own face.
+ * The thumbnails are rendered to QImage in a thread pool, the family name is
+ * painted as a placeholder until the thumbnail arrives.\n
+ * The rendered thumbnails are kept in a size bounded LRU cache, keyed by the
+ * family, the sample text, the text color and the device pixel ratio.
+ */
+class KNFontPreviewDelegate : public QStyledItemDelegate
+{
+    Q_OBJECT
+public:
+    /*!
+     * \brief Construct a KNFontPreviewDelegate.
+     * \param parent The parent object.
+     */
+    explicit KNFontPreviewDelegate(QObject *parent = 0);
+    ~KNFontPreviewDelegate();
+
+    /*!
+     * \brief Reimplemented from QStyledItemDelegate::paint().
+     */
+    void paint(QPainter *painter,
+               const QStyleOptionViewItem &option,
+               const QModelIndex &index) const Q_DECL_OVERRIDE;
+
+    /*!
+     * \brief Reimplemented from QStyledItemDelegate::sizeHint().
+     */
+    QSize sizeHint(const QStyleOptionViewItem &option,
+                   const QModelIndex &index) const Q_DECL_OVERRIDE;
+
+    /*!
+     * \brief Set the text painted in the family face. If the text is empty,
+     * the family name will be painted.
+     * \param sampleText The sample text.
+     */
+    void setSampleText(const QString &sampleText);
+
+    /*!
+     * \brief Set the maximum size of the thumbnail cache.
+     * \param kilobytes The cache size in kilobytes.
+     */
+    void setCacheLimit(int kilobytes);
+
+signals:
+    /*!
+     * \brief When a requested thumbnail is rendered, this signal will be
+     * emitted. The view should be updated.
+     */
+    void thumbnailReady();
+
+public slots:
+    /*!
+     * \brief Cancel all the thumbnail requests which haven't been started.
+     * It should be called when the view is scrolled, the visible rows will be
+     * requested again when they are painted.
+     */
+    void cancelPendingRequests();
+
+private slots:
+    void onActionThumbnailRendered(const QString &key, const QImage &image);
+
+private:
+    friend class KNFontThumbnailTask;
+    static QImage renderThumbnail(const QString &family,
+                                  const QString &text,
+                                  int height,
+                                  qreal devicePixelRatio,
+                                  QRgb color);
+    mutable QCache<QString, QImage> m_thumbnails;
+    mutable QSet<QString> m_pendingRequests, m_rejectedKeys, m_queuedRequests;
+    mutable QMutex m_queueLock;
+    QString m_sampleText;
+    QThreadPool *m_renderPool;
+    bool m_threadedRendering;
+};
+
+#endif // KNFONTPREVIEWDELEGATE_H
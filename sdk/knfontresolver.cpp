@@ -0,0 +1,172 @@
+/*
+ * Copyright (C) Kreogist Dev Team
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+#include <QFontDatabase>
+#include <QFontInfo>
+#include <QFontMetricsF>
+#include <QFutureInterface>
+#include <QHash>
+#include <QReadWriteLock>
+#include <QtConcurrent/QtConcurrent>
+
+#include "knfontcatalog.h"
+
+#include "knfontresolver.h"
+
+namespace
+{
+QHash<QString, KNResolvedFont> resolvedFonts;
+QReadWriteLock resolvedFontsLock;
+
+inline QString specKey(const KNFontSpec &spec)
+{
+    return spec.family+QLatin1Char('\n')+spec.style+QLatin1Char('\n')+
+            QString::number(spec.pointSize);
+}
+
+inline bool isSameFamily(const QString &resolved, const QString &requested)
+{
+    //The resolved family may have a foundry, e.g. "Family [Foundry]".
+    return resolved.compare(requested, Qt::CaseInsensitive)==0 ||
+            (resolved.midRef(requested.size(), 2)==QLatin1String(" [") &&
+             resolved.startsWith(requested, Qt::CaseInsensitive));
+}
+}
+
+KNResolvedFont KNFontResolver::resolve(const KNFontSpec &spec)
+{
+    prepareCatalog();
+    return resolveMemoized(spec);
+}
+
+QVector<KNResolvedFont> KNFontResolver::resolveBatch(
+        const QVector<KNFontSpec> &specs)
+{
+    prepareCatalog();
+    //The fonts could only be resolved on the main thread when threaded font
+    //rendering is not supported.
+    if(!QFontDatabase::supportsThreadedFontRendering())
+    {
+        QVector<KNResolvedFont> results;
+        results.reserve(specs.size());
+        for(const KNFontSpec &spec:specs)
+        {
+            results.append(resolveMemoized(spec));
+        }
+        return results;
+    }
+    return QtConcurrent::blockingMapped<QVector<KNResolvedFont>>(
+                specs, &KNFontResolver::resolveMemoized);
+}
+
+QFuture<KNResolvedFont> KNFontResolver::resolveAsync(
+        const QVector<KNFontSpec> &specs)
+{
+    prepareCatalog();
+    if(!QFontDatabase::supportsThreadedFontRendering())
+    {
+        //Resolve the fonts directly, and return a finished future.
+        QFutureInterface<KNResolvedFont> resultInterface(
+                    QFutureInterfaceBase::Started);
+        QVector<KNResolvedFont> results=resolveBatch(specs);
+        resultInterface.reportResults(results);
+        resultInterface.reportFinished();
+        return resultInterface.future();
+    }
+    return QtConcurrent::mapped(specs, &KNFontResolver::resolveMemoized);
+}
+
+void KNFontResolver::clearCache()
+{
+    QWriteLocker cacheLocker(&resolvedFontsLock);
+    resolvedFonts.clear();
+}
+
+void KNFontResolver::prepareCatalog()
+{
+    //Generate the catalog once, KNFontCatalog::instance() always generates it
+    //on the main thread. Clear the memoized results when the families are
+    //changed. The initialization of the static value is thread-safe.
+    static bool catalogConnected=[]()
+    {
+        QObject::connect(KNFontCatalog::instance(),
+                         &KNFontCatalog::catalogChanged,
+                         &KNFontResolver::clearCache);
+        return true;
+    }();
+    Q_UNUSED(catalogConnected);
+}
+
+KNResolvedFont KNFontResolver::resolveMemoized(const KNFontSpec &spec)
+{
+    QString key=specKey(spec);
+    {
+        //Check the memoized result first.
+        QReadLocker cacheLocker(&resolvedFontsLock);
+        QHash<QString, KNResolvedFont>::const_iterator cachedFont=
+                resolvedFonts.constFind(key);
+        if(cachedFont!=resolvedFonts.constEnd())
+        {
+            return cachedFont.value();
+        }
+    }
+    KNResolvedFont resolvedFont=resolveFont(spec);
+    QWriteLocker cacheLocker(&resolvedFontsLock);
+    resolvedFonts.insert(key, resolvedFont);
+    return resolvedFont;
+}
+
+KNResolvedFont KNFontResolver::resolveFont(const KNFontSpec &spec)
+{
+    KNResolvedFont resolvedFont;
+    //Build the font from the spec.
+    QFont font;
+    font.setFamily(spec.family);
+    if(spec.pointSize>0.0)
+    {
+        font.setPointSizeF(spec.pointSize);
+    }
+    if(!spec.style.isEmpty())
+    {
+        font.setStyleName(spec.style);
+    }
+    resolvedFont.font=font;
+    //Find the family which the font is actually resolved to, this is the same
+    //rule of the font dialog.
+    QFontInfo fontInfo(font);
+    resolvedFont.resolvedFamily=fontInfo.family();
+    resolvedFont.resolvedStyle=fontInfo.styleName();
+    KNFontCatalog *fontCatalog=KNFontCatalog::instance();
+    resolvedFont.catalogRow=fontCatalog->indexOf(fontInfo.family());
+    if(resolvedFont.catalogRow==-1)
+    {
+        resolvedFont.catalogRow=fontCatalog->indexOf(spec.family);
+    }
+    //Check whether the font database replaced the requested family or style.
+    resolvedFont.familyFallback=!spec.family.isEmpty() &&
+            !isSameFamily(fontInfo.family(), spec.family);
+    resolvedFont.styleFallback=!spec.style.isEmpty() &&
+            fontInfo.styleName().compare(spec.style, Qt::CaseInsensitive)!=0;
+    //Measure the font.
+    QFontMetricsF fontMetrics(font);
+    resolvedFont.ascent=fontMetrics.ascent();
+    resolvedFont.descent=fontMetrics.descent();
+    resolvedFont.lineSpacing=fontMetrics.lineSpacing();
+    resolvedFont.xHeight=fontMetrics.xHeight();
+    resolvedFont.averageCharWidth=fontMetrics.averageCharWidth();
+    return resolvedFont;
+}
@@ -0,0 +1,162 @@
+/*
+ * Copyright (C) Kreogist Dev Team
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#ifndef KNFONTRESOLVER_H
+#define KNFONTRESOLVER_H
+
+#include <QFont>
+#include <QFuture>
+#include <QVector>
+
+/*!
+ * \brief The KNFontSpec describes a font stored in a document.
+ */
+struct KNFontSpec
+{
+    /*!
+     * \brief The requested family name.
+     */
+    QString family;
+    /*!
+     * \brief The requested style name, e.g. "Bold Italic". It could be empty.
+     */
+    QString style;
+    /*!
+     * \brief The requested point size. When it is not positive, the size of
+     * the default font is used.
+     */
+    qreal pointSize;
+    KNFontSpec() :
+        pointSize(-1.0)
+    {
+    }
+};
+
+/*!
+ * \brief The KNResolvedFont is the font which a KNFontSpec is resolved to.
+ */
+struct KNResolvedFont
+{
+    /*!
+     * \brief The font built from the spec.
+     */
+    QFont font;
+    /*!
+     * \brief The family which the font is actually rendered with.
+     */
+    QString resolvedFamily;
+    /*!
+     * \brief The style which the font is actually rendered with.
+     */
+    QString resolvedStyle;
+    /*!
+     * \brief The row of the resolved family in the font catalog, it is -1
+     * when the family is not in the catalog.
+     */
+    int catalogRow;
+    /*!
+     * \brief Whether the requested family is replaced by another family.
+     */
+    bool familyFallback;
+    /*!
+     * \brief Whether the requested style is replaced by another style.
+     */
+    bool styleFallback;
+    /*!
+     * \brief The ascent of the font in pixels.
+     */
+    qreal ascent;
+    /*!
+     * \brief The descent of the font in pixels.
+     */
+    qreal descent;
+    /*!
+     * \brief The line spacing of the font in pixels.
+     */
+    qreal lineSpacing;
+    /*!
+     * \brief The x-height of the font in pixels.
+     */
+    qreal xHeight;
+    /*!
+     * \brief The average character width of the font in pixels.
+     */
+    qreal averageCharWidth;
+    KNResolvedFont() :
+        catalogRow(-1),
+        familyFallback(false),
+        styleFallback(false),
+        ascent(0.0),
+        descent(0.0),
+        lineSpacing(0.0),
+        xHeight(0.0),
+        averageCharWidth(0.0)
+    {
+    }
+};
+
+/*!
+ * \brief The KNFontResolver resolves the font specs to fonts without any
+ * widget, it uses the same rules as KNFontDialog::setInitialFont() and the
+ * shared KNFontCatalog.\n
+ * All the functions are thread-safe. The results are memoized until the
+ * catalog is changed. The catalog is generated on the main thread at the first
+ * call, so the main thread must be running its event loop when the first call
+ * comes from a worker thread.
+ */
+class KNFontResolver
+{
+public:
+    /*!
+     * \brief Resolve a font spec.
+     * \param spec The font spec.
+     * \return The resolved font.
+     */
+    static KNResolvedFont resolve(const KNFontSpec &spec);
+
+    /*!
+     * \brief Resolve a batch of font specs in parallel. It blocks until all
+     * the specs are resolved.
+     * \param specs The font specs.
+     * \return The resolved fonts, in the same order of the specs.
+     */
+    static QVector<KNResolvedFont> resolveBatch(const QVector<KNFontSpec> &specs);
+
+    /*!
+     * \brief Resolve a batch of font specs on the worker threads without
+     * blocking the caller.
+     * \param specs The font specs.
+     * \return The future of the resolved fonts, in the same order of the
+     * specs.
+     */
+    static QFuture<KNResolvedFont> resolveAsync(const QVector<KNFontSpec> &specs);
+
+    /*!
+     * \brief Remove all the memoized results. It is called automatically when
+     * the font catalog is changed.
+     */
+    static void clearCache();
+
+private:
+    KNFontResolver();
+    static void prepareCatalog();
+    static KNResolvedFont resolveMemoized(const KNFontSpec &spec);
+    static KNResolvedFont resolveFont(const KNFontSpec &spec);
+};
+
+#endif // KNFONTRESOLVER_H
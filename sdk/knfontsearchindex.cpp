@@ -0,0 +1,296 @@
+/*
+ * Copyright (C) Kreogist Dev Team
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+#include <algorithm>
+#include <iterator>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+#include "knfontsearchindex.h"
+
+//The minimum ratio of the query bigrams a fuzzy match must contain.
+#define FuzzyCoverageThreshold 0.5
+
+namespace
+{
+struct FuzzyMatch
+{
+    qreal score;
+    int row;
+};
+
+inline bool containsBigram(const char *name, int length, char first,
+                           char second)
+{
+    //Check all the bigram positions, 16 positions at a time.
+    int positions=length-1, i=0;
+#if defined(__SSE2__)
+    const __m128i firstBytes=_mm_set1_epi8(first),
+                  secondBytes=_mm_set1_epi8(second);
+    for(; i+16<=positions; i+=16)
+    {
+        __m128i current=_mm_loadu_si128(
+                    reinterpret_cast<const __m128i *>(name+i)),
+                next=_mm_loadu_si128(
+                    reinterpret_cast<const __m128i *>(name+i+1));
+        if(_mm_movemask_epi8(
+                    _mm_and_si128(_mm_cmpeq_epi8(current, firstBytes),
+                                  _mm_cmpeq_epi8(next, secondBytes))))
+        {
+            return true;
+        }
+    }
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+    const uint8x16_t firstBytes=vdupq_n_u8((uint8_t)first),
+                     secondBytes=vdupq_n_u8((uint8_t)second);
+    for(; i+16<=positions; i+=16)
+    {
+        uint8x16_t current=vld1q_u8(
+                    reinterpret_cast<const uint8_t *>(name+i)),
+                   next=vld1q_u8(
+                    reinterpret_cast<const uint8_t *>(name+i+1));
+        if(vmaxvq_u8(vandq_u8(vceqq_u8(current, firstBytes),
+                              vceqq_u8(next, secondBytes))))
+        {
+            return true;
+        }
+    }
+#endif
+    //Check the rest positions.
+    for(; i<positions; ++i)
+    {
+        if(name[i]==first && name[i+1]==second)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+}
+
+KNFontSearchIndex::KNFontSearchIndex()
+{
+}
+
+QString KNFontSearchIndex::foldCase(const QString &text)
+{
+    return text.toCaseFolded();
+}
+
+void KNFontSearchIndex::clear()
+{
+    m_trigrams.clear();
+    m_foldedNames.clear();
+    m_nameBuffer.clear();
+    m_nameOffsets.clear();
+}
+
+void KNFontSearchIndex::append(const QStringList &families)
+{
+    m_foldedNames.reserve(m_foldedNames.size()+families.size());
+    for(const QString &family:families)
+    {
+        int row=m_foldedNames.size();
+        QString foldedName=foldCase(family);
+        //Add the row to the posting list of every trigram, the rows are
+        //always appended in ascending order.
+        const QChar *nameData=foldedName.constData();
+        for(int i=0, trigrams=foldedName.size()-2; i<trigrams; ++i)
+        {
+            QVector<int> &postings=m_trigrams[trigram(nameData+i)];
+            if(postings.isEmpty() || postings.last()!=row)
+            {
+                postings.append(row);
+            }
+        }
+        m_foldedNames.append(foldedName);
+        //Append the name to the byte buffer.
+        m_nameOffsets.append(m_nameBuffer.size());
+        m_nameBuffer.append(toBytes(foldedName));
+    }
+}
+
+int KNFontSearchIndex::size() const
+{
+    return m_foldedNames.size();
+}
+
+QVector<int> KNFontSearchIndex::search(const QString &query) const
+{
+    //Short query cannot use the trigram, check all the names.
+    if(query.size()<3)
+    {
+        QVector<int> rows;
+        rows.reserve(m_foldedNames.size());
+        for(int i=0; i<m_foldedNames.size(); ++i)
+        {
+            rows.append(i);
+        }
+        return narrow(query, rows);
+    }
+    //Find the posting lists of all the trigrams in the query.
+    QVector<const QVector<int> *> postingLists;
+    const QChar *queryData=query.constData();
+    for(int i=0, trigrams=query.size()-2; i<trigrams; ++i)
+    {
+        auto postingIterator=m_trigrams.constFind(trigram(queryData+i));
+        //If any trigram is missing, nothing could be matched.
+        if(postingIterator==m_trigrams.constEnd())
+        {
+            return QVector<int>();
+        }
+        postingLists.append(&postingIterator.value());
+    }
+    //Intersect from the shortest posting list.
+    std::sort(postingLists.begin(), postingLists.end(),
+              [](const QVector<int> *left, const QVector<int> *right)
+              {
+                  return left->size()<right->size();
+              });
+    QVector<int> candidates=*postingLists.first(), intersection;
+    for(int i=1; i<postingLists.size() && !candidates.isEmpty(); ++i)
+    {
+        const QVector<int> &postings=*postingLists.at(i);
+        intersection.clear();
+        std::set_intersection(candidates.constBegin(), candidates.constEnd(),
+                              postings.constBegin(), postings.constEnd(),
+                              std::back_inserter(intersection));
+        candidates.swap(intersection);
+    }
+    //The trigrams may not be continuous, check the candidates.
+    return narrow(query, candidates);
+}
+
+QVector<int> KNFontSearchIndex::narrow(const QString &query,
+                                       const QVector<int> &rows) const
+{
+    QVector<int> matchedRows;
+    for(int row:rows)
+    {
+        if(m_foldedNames.at(row).contains(query))
+        {
+            matchedRows.append(row);
+        }
+    }
+    return matchedRows;
+}
+
+QVector<int> KNFontSearchIndex::fuzzySearch(const QString &query) const
+{
+    QVector<int> rows;
+    rows.reserve(m_foldedNames.size());
+    for(int i=0; i<m_foldedNames.size(); ++i)
+    {
+        rows.append(i);
+    }
+    return fuzzyNarrow(query, rows);
+}
+
+QVector<int> KNFontSearchIndex::fuzzyNarrow(const QString &query,
+                                            const QVector<int> &rows) const
+{
+    //Get the bigrams of the query, the bigrams across words are ignored so the
+    //order of the words doesn't matter.
+    QByteArray queryBytes=toBytes(query), queryBigrams;
+    for(int i=0; i<queryBytes.size()-1; ++i)
+    {
+        if(queryBytes.at(i)!=' ' && queryBytes.at(i+1)!=' ')
+        {
+            queryBigrams.append(queryBytes.at(i));
+            queryBigrams.append(queryBytes.at(i+1));
+        }
+    }
+    int bigramCount=queryBigrams.size()>>1;
+    //A single character cannot be scored, use the substring matching.
+    if(bigramCount==0)
+    {
+        return narrow(query, rows);
+    }
+    //Score all the families.
+    QVector<FuzzyMatch> matches;
+    const char *nameBuffer=m_nameBuffer.constData(),
+               *bigrams=queryBigrams.constData();
+    for(int row:rows)
+    {
+        int nameOffset=m_nameOffsets.at(row),
+            nameLength=(row+1<m_nameOffsets.size()?
+                            m_nameOffsets.at(row+1):
+                            m_nameBuffer.size())-nameOffset,
+            matchedCount=0;
+        const char *name=nameBuffer+nameOffset;
+        for(int i=0; i<bigramCount; ++i)
+        {
+            if(containsBigram(name, nameLength, bigrams[i<<1],
+                              bigrams[(i<<1)+1]))
+            {
+                ++matchedCount;
+            }
+        }
+        //Ignore the family which contains too few bigrams.
+        qreal coverage=(qreal)matchedCount/bigramCount;
+        if(coverage<FuzzyCoverageThreshold)
+        {
+            continue;
+        }
+        //The coverage decides the rank, the shorter name is better when the
+        //coverage is the same.
+        FuzzyMatch match;
+        match.score=coverage*0.8+
+                0.2*(2.0*matchedCount)/(bigramCount+qMax(nameLength-1, 1));
+        match.row=row;
+        matches.append(match);
+    }
+    //Rank the matches.
+    std::stable_sort(matches.begin(), matches.end(),
+                     [](const FuzzyMatch &left, const FuzzyMatch &right)
+                     {
+                         return left.score>right.score;
+                     });
+    QVector<int> matchedRows;
+    matchedRows.reserve(matches.size());
+    for(const FuzzyMatch &match:matches)
+    {
+        matchedRows.append(match.row);
+    }
+    return matchedRows;
+}
+
+quint64 KNFontSearchIndex::trigram(const QChar *text)
+{
+    //Pack three UTF-16 code units into one key.
+    return ((quint64)text[0].unicode() << 32) |
+            ((quint64)text[1].unicode() << 16) |
+            (quint64)text[2].unicode();
+}
+
+QByteArray KNFontSearchIndex::toBytes(const QString &foldedText)
+{
+    //Keep the Latin-1 characters, other characters are hashed to the high
+    //half of a byte. The fuzzy search only needs a stable mapping.
+    QByteArray bytes;
+    bytes.resize(foldedText.size());
+    for(int i=0; i<foldedText.size(); ++i)
+    {
+        ushort code=foldedText.at(i).unicode();
+        bytes[i]=(char)(code<0x100?code:(((code>>8)^code)|0x80));
+    }
+    return bytes;
+}
@@ -0,0 +1,113 @@
+/*
+ * Copyright (C) Kreogist Dev Team
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#ifndef KNFONTSEARCHINDEX_H
+#define KNFONTSEARCHINDEX_H
+
+#include <QHash>
+#include <QStringList>
+#include <QVector>
+
+/*!
+ * \brief The KNFontSearchIndex is a trigram index of the font family names.
+ * It is built alongside the font catalog, the rows in the results are the rows
+ * of the catalog family model.\n
+ * The index is read only after it is built, a query could narrow down the
+ * result of a previous query instead of searching from the start.\n
+ * The index also keeps all the names in one contiguous byte buffer for the
+ * fuzzy search, which scores every family with SIMD byte matching.
+ */
+class KNFontSearchIndex
+{
+public:
+    /*!
+     * \brief Construct an empty KNFontSearchIndex.
+     */
+    KNFontSearchIndex();
+
+    /*!
+     * \brief Fold the case of a text, the index stores and searches the case
+     * folded names.
+     * \param text The original text.
+     * \return The case folded text.
+     */
+    static QString foldCase(const QString &text);
+
+    /*!
+     * \brief Remove all the families in the index.
+     */
+    void clear();
+
+    /*!
+     * \brief Append families to the index, the rows of the families start from
+     * the current size of the index.
+     * \param families The family names.
+     */
+    void append(const QStringList &families);
+
+    /*!
+     * \brief Get the number of families in the index.
+     * \return The family count.
+     */
+    int size() const;
+
+    /*!
+     * \brief Search all the families which contains the query.
+     * \param query The case folded query text.
+     * \return The rows of the matched families in ascending order.
+     */
+    QVector<int> search(const QString &query) const;
+
+    /*!
+     * \brief Narrow down the rows to the families which contains the query.
+     * When the query contains the previous query, the new result is always a
+     * subset of the previous one.
+     * \param query The case folded query text.
+     * \param rows The rows to be checked.
+     * \return The rows of the matched families, the order is kept.
+     */
+    QVector<int> narrow(const QString &query, const QVector<int> &rows) const;
+
+    /*!
+     * \brief Score all the families against the query by the character
+     * bigrams they share, so typos and word order changes could still be
+     * matched.
+     * \param query The case folded query text.
+     * \return The rows of the matched families, the best match is the first.
+     */
+    QVector<int> fuzzySearch(const QString &query) const;
+
+    /*!
+     * \brief Score the given families against the query.
+     * \param query The case folded query text.
+     * \param rows The rows to be scored.
+     * \return The rows of the matched families, the best match is the first.
+     */
+    QVector<int> fuzzyNarrow(const QString &query,
+                             const QVector<int> &rows) const;
+
+private:
+    static inline quint64 trigram(const QChar *text);
+    static inline QByteArray toBytes(const QString &foldedText);
+    QHash<quint64, QVector<int>> m_trigrams;
+    QVector<QString> m_foldedNames;
+    QByteArray m_nameBuffer;
+    QVector<int> m_nameOffsets;
+};
+
+#endif // KNFONTSEARCHINDEX_H
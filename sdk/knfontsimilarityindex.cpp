@@ -0,0 +1,253 @@
+/*
+ * Copyright (C) Kreogist Dev Team
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+#include <QDataStream>
+#include <QFont>
+#include <QPainterPath>
+#include <QRawFont>
+
+#include <algorithm>
+
+#include "knfontsimilarityindex.h"
+
+//The pixel size used to measure the fonts.
+#define MeasurePixelSize 100.0
+
+namespace
+{
+//The scales of the features, which decide how much a feature affects the
+//distance.
+const float FeatureScales[KNFontFeatures::FeaturesCount]=
+{
+    10.0f,  //XHeight
+    10.0f,  //CapHeight
+    5.0f,   //AverageAdvance
+    2.0f,   //Weight
+    1.5f,   //Monospace
+    1.5f    //Serif
+};
+
+struct Neighbour
+{
+    float distance;
+    int row;
+};
+
+inline quint32 glyphIndex(const QRawFont &rawFont, QChar character)
+{
+    quint32 index=0;
+    int glyphCount=1;
+    rawFont.glyphIndexesForChars(&character, 1, &index, &glyphCount);
+    return index;
+}
+
+inline qreal glyphAdvance(const QRawFont &rawFont, quint32 glyph)
+{
+    QPointF advance;
+    rawFont.advancesForGlyphIndexes(&glyph, &advance, 1);
+    return advance.x();
+}
+}
+
+KNFontSimilarityIndex::KNFontSimilarityIndex()
+{
+}
+
+KNFontFeatures KNFontSimilarityIndex::fontFeatures(const QFont &font)
+{
+    KNFontFeatures fontFeatures;
+    //Load the font file which the font is resolved to.
+    QRawFont rawFont=QRawFont::fromFont(font);
+    if(!rawFont.isValid())
+    {
+        return fontFeatures;
+    }
+    rawFont.setPixelSize(MeasurePixelSize);
+    quint32 glyphX=glyphIndex(rawFont, QChar('x')),
+            glyphH=glyphIndex(rawFont, QChar('H')),
+            glyphI=glyphIndex(rawFont, QChar('I')),
+            glyphSmallI=glyphIndex(rawFont, QChar('i')),
+            glyphM=glyphIndex(rawFont, QChar('M'));
+    float *values=fontFeatures.values;
+    values[KNFontFeatures::XHeight]=
+            rawFont.pathForGlyph(glyphX).boundingRect().height()/
+            MeasurePixelSize;
+    values[KNFontFeatures::CapHeight]=
+            rawFont.pathForGlyph(glyphH).boundingRect().height()/
+            MeasurePixelSize;
+    values[KNFontFeatures::AverageAdvance]=
+            rawFont.averageCharWidth()/MeasurePixelSize;
+    values[KNFontFeatures::Weight]=rawFont.weight()/100.0;
+    //A monospace font has the same advance for 'i' and 'M'.
+    qreal advanceI=glyphAdvance(rawFont, glyphSmallI),
+          advanceM=glyphAdvance(rawFont, glyphM);
+    values[KNFontFeatures::Monospace]=
+            (advanceM>0 && qAbs(advanceM-advanceI)<advanceM*0.01)?1.0f:0.0f;
+    //The serifs make the capital 'I' much wider than its stem.
+    values[KNFontFeatures::Serif]=
+            qBound(0.0,
+                   (rawFont.pathForGlyph(glyphI).boundingRect().width()/
+                    MeasurePixelSize-0.12)/0.15,
+                   1.0);
+    //Scale the features.
+    for(int i=0; i<KNFontFeatures::FeaturesCount; ++i)
+    {
+        values[i]*=FeatureScales[i];
+    }
+    return fontFeatures;
+}
+
+KNFontFeatures KNFontSimilarityIndex::requestedFeatures(const QFont &font)
+{
+    //The families in the index are measured in their regular upright faces,
+    //measure the upright regular face of the fallback font as well.
+    QFont measureFont=font;
+    measureFont.setWeight(QFont::Normal);
+    measureFont.setItalic(false);
+    KNFontFeatures features=fontFeatures(measureFont);
+    //Use the weight and the hints of the request instead of the fallback
+    //font.
+    float *values=features.values;
+    values[KNFontFeatures::Weight]=
+            font.weight()/100.0f*FeatureScales[KNFontFeatures::Weight];
+    QFont::StyleHint styleHint=font.styleHint();
+    if(font.fixedPitch() || styleHint==QFont::Monospace ||
+            styleHint==QFont::TypeWriter)
+    {
+        values[KNFontFeatures::Monospace]=
+                FeatureScales[KNFontFeatures::Monospace];
+    }
+    if(styleHint==QFont::Serif)
+    {
+        values[KNFontFeatures::Serif]=FeatureScales[KNFontFeatures::Serif];
+    }
+    else if(styleHint==QFont::SansSerif)
+    {
+        values[KNFontFeatures::Serif]=0.0f;
+    }
+    return features;
+}
+
+KNFontFeatures KNFontSimilarityIndex::familyFeatures(const QString &family)
+{
+    return fontFeatures(QFont(family));
+}
+
+void KNFontSimilarityIndex::setFeatures(const QVector<KNFontFeatures> &features)
+{
+    m_features=features;
+}
+
+void KNFontSimilarityIndex::clear()
+{
+    m_features.clear();
+}
+
+int KNFontSimilarityIndex::size() const
+{
+    return m_features.size();
+}
+
+KNFontFeatures KNFontSimilarityIndex::features(int row) const
+{
+    return m_features.at(row);
+}
+
+QVector<int> KNFontSimilarityIndex::nearest(const KNFontFeatures &features,
+                                            int count,
+                                            int excludeRow) const
+{
+    //Calculate the distances of all the families.
+    QVector<Neighbour> neighbours;
+    neighbours.reserve(m_features.size());
+    for(int row=0; row<m_features.size(); ++row)
+    {
+        if(row==excludeRow)
+        {
+            continue;
+        }
+        const float *values=m_features.at(row).values;
+        Neighbour neighbour;
+        neighbour.distance=0.0f;
+        for(int i=0; i<KNFontFeatures::FeaturesCount; ++i)
+        {
+            float difference=values[i]-features.values[i];
+            neighbour.distance+=difference*difference;
+        }
+        neighbour.row=row;
+        neighbours.append(neighbour);
+    }
+    //Only sort the nearest families.
+    count=qMin(count, neighbours.size());
+    std::partial_sort(neighbours.begin(),
+                      neighbours.begin()+count,
+                      neighbours.end(),
+                      [](const Neighbour &left, const Neighbour &right)
+                      {
+                          return left.distance<right.distance;
+                      });
+    QVector<int> rows;
+    rows.reserve(count);
+    for(int i=0; i<count; ++i)
+    {
+        rows.append(neighbours.at(i).row);
+    }
+    return rows;
+}
+
+QByteArray KNFontSimilarityIndex::save(const QStringList &families) const
+{
+    QByteArray data;
+    QDataStream dataStream(&data, QIODevice::WriteOnly);
+    dataStream << families;
+    for(const KNFontFeatures &features:m_features)
+    {
+        for(int i=0; i<KNFontFeatures::FeaturesCount; ++i)
+        {
+            dataStream << features.values[i];
+        }
+    }
+    return data;
+}
+
+bool KNFontSimilarityIndex::load(const QByteArray &data,
+                                 const QStringList &families)
+{
+    QDataStream dataStream(data);
+    //The cached features must be computed for the same families.
+    QStringList cachedFamilies;
+    dataStream >> cachedFamilies;
+    if(cachedFamilies!=families)
+    {
+        return false;
+    }
+    QVector<KNFontFeatures> familyFeatures;
+    familyFeatures.resize(families.size());
+    for(KNFontFeatures &features:familyFeatures)
+    {
+        for(int i=0; i<KNFontFeatures::FeaturesCount; ++i)
+        {
+            dataStream >> features.values[i];
+        }
+    }
+    if(dataStream.status()!=QDataStream::Ok)
+    {
+        return false;
+    }
+    m_features=familyFeatures;
+    return true;
+}
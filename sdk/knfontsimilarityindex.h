@@ -0,0 +1,155 @@
+/*
+ * Copyright (C) Kreogist Dev Team
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#ifndef KNFONTSIMILARITYINDEX_H
+#define KNFONTSIMILARITYINDEX_H
+
+#include <QByteArray>
+#include <QMetaType>
+#include <QStringList>
+#include <QVector>
+
+class QFont;
+/*!
+ * \brief The KNFontFeatures is the metric feature vector of a family. All the
+ * features are scaled, so the euclidean distance between two vectors shows how
+ * different the families look.
+ */
+struct KNFontFeatures
+{
+    enum Features
+    {
+        XHeight,
+        CapHeight,
+        AverageAdvance,
+        Weight,
+        Monospace,
+        Serif,
+        FeaturesCount
+    };
+    float values[FeaturesCount];
+    KNFontFeatures()
+    {
+        for(int i=0; i<FeaturesCount; ++i)
+        {
+            values[i]=0.0f;
+        }
+    }
+};
+
+Q_DECLARE_METATYPE(KNFontFeatures)
+
+/*!
+ * \brief The KNFontSimilarityIndex keeps the feature vectors of all the
+ * families in the font catalog, and finds the nearest families of a feature
+ * vector.
+ */
+class KNFontSimilarityIndex
+{
+public:
+    /*!
+     * \brief Construct an empty KNFontSimilarityIndex.
+     */
+    KNFontSimilarityIndex();
+
+    /*!
+     * \brief Compute the feature vector of a font, the x-height, cap height,
+     * average advance, weight, and whether the font is monospace or serif. It
+     * could be called in threads when the platform supports threaded font
+     * rendering.
+     * \param font The font.
+     * \return The feature vector.
+     */
+    static KNFontFeatures fontFeatures(const QFont &font);
+
+    /*!
+     * \brief Compute the feature vector of a requested font, whose family may
+     * not be installed. The metrics are measured from the upright regular
+     * face which the request is resolved to, the weight follows the requested
+     * weight, the monospace and serif features follow the fixed pitch flag
+     * and the style hint of the request.
+     * \param font The requested font.
+     * \return The feature vector.
+     */
+    static KNFontFeatures requestedFeatures(const QFont &font);
+
+    /*!
+     * \brief Compute the feature vector of a family.
+     * \param family The family name.
+     * \return The feature vector.
+     */
+    static KNFontFeatures familyFeatures(const QString &family);
+
+    /*!
+     * \brief Set the feature vectors of the families, the index of the vector
+     * is the row of the family in the catalog.
+     * \param features The feature vectors.
+     */
+    void setFeatures(const QVector<KNFontFeatures> &features);
+
+    /*!
+     * \brief Remove all the feature vectors.
+     */
+    void clear();
+
+    /*!
+     * \brief Get the number of families in the index.
+     * \return The family count.
+     */
+    int size() const;
+
+    /*!
+     * \brief Get the feature vector of a family.
+     * \param row The row of the family.
+     * \return The feature vector.
+     */
+    KNFontFeatures features(int row) const;
+
+    /*!
+     * \brief Find the families which are the nearest to the feature vector.
+     * \param features The feature vector.
+     * \param count The maximum number of the families.
+     * \param excludeRow The row which shouldn't be in the result, usually the
+     * row of the feature vector itself.
+     * \return The rows of the nearest families, the nearest is the first.
+     */
+    QVector<int> nearest(const KNFontFeatures &features,
+                         int count,
+                         int excludeRow=-1) const;
+
+    /*!
+     * \brief Serialize the index for the catalog cache.
+     * \param families The family names of the rows.
+     * \return The serialized index.
+     */
+    QByteArray save(const QStringList &families) const;
+
+    /*!
+     * \brief Load the index from the serialized data.
+     * \param data The serialized index.
+     * \param families The family names of the current rows, the data must be
+     * saved with the same families.
+     * \return If the index is loaded, return true.
+     */
+    bool load(const QByteArray &data, const QStringList &families);
+
+private:
+    QVector<KNFontFeatures> m_features;
+};
+
+#endif // KNFONTSIMILARITYINDEX_H
@@ -0,0 +1,203 @@
+/*
+ * Copyright (C) Kreogist Dev Team
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+#include <QFontDatabase>
+
+#include <algorithm>
+#include <cmath>
+
+#include "knfontsizemodel.h"
+
+//The sizes closer than this are treated as the same size.
+#define SizeEpsilon 0.001
+//The smallest size accepted by a scalable family.
+#define MinimumPointSize 1.0
+
+namespace
+{
+inline QList<int> scalableSizes()
+{
+    //The standard sizes end at 72, keep the large sizes of the previous size
+    //list, so the list and the slider could reach 288.
+    return QFontDatabase::standardSizes() << 96 << 144 << 288;
+}
+}
+
+QHash<QString, KNFontSizeModel::FamilySizes> KNFontSizeModel::m_sizeCache;
+
+KNFontSizeModel::KNFontSizeModel(QObject *parent) :
+    QAbstractListModel(parent)
+{
+    //Use the standard sizes before any family is set.
+    m_sizes=fetchSizes(QString());
+}
+
+int KNFontSizeModel::rowCount(const QModelIndex &parent) const
+{
+    //List model doesn't have any child.
+    return parent.isValid()?0:m_sizes.sizes.size();
+}
+
+QVariant KNFontSizeModel::data(const QModelIndex &index, int role) const
+{
+    if(!index.isValid())
+    {
+        return QVariant();
+    }
+    switch(role)
+    {
+    case Qt::DisplayRole:
+        //Only format the size when the row is painted.
+        return QString::number(m_sizes.sizes.at(index.row()));
+    case Qt::UserRole:
+        return m_sizes.sizes.at(index.row());
+    default:
+        return QVariant();
+    }
+}
+
+QString KNFontSizeModel::family() const
+{
+    return m_family;
+}
+
+bool KNFontSizeModel::isScalable() const
+{
+    return m_sizes.scalable;
+}
+
+qreal KNFontSizeModel::pointSize(int row) const
+{
+    return m_sizes.sizes.at(row);
+}
+
+QVector<qreal> KNFontSizeModel::pointSizes() const
+{
+    return m_sizes.sizes;
+}
+
+int KNFontSizeModel::indexOf(qreal pointSize) const
+{
+    //Find the size in the sorted list.
+    int row=nearestRow(pointSize);
+    return (row!=-1 &&
+            std::abs(m_sizes.sizes.at(row)-pointSize)<SizeEpsilon)?row:-1;
+}
+
+int KNFontSizeModel::nearestRow(qreal pointSize) const
+{
+    const QVector<qreal> &sizes=m_sizes.sizes;
+    if(sizes.isEmpty())
+    {
+        return -1;
+    }
+    //Find the first size which is not less than the point size, the closest
+    //size is either it or the one before it.
+    int row=std::lower_bound(sizes.constBegin(),
+                             sizes.constEnd(),
+                             pointSize)-sizes.constBegin();
+    if(row==sizes.size())
+    {
+        return row-1;
+    }
+    if(row>0 && pointSize-sizes.at(row-1)<sizes.at(row)-pointSize)
+    {
+        return row-1;
+    }
+    return row;
+}
+
+qreal KNFontSizeModel::validSize(qreal pointSize) const
+{
+    //A scalable family could use any size.
+    if(m_sizes.scalable)
+    {
+        return qMax(pointSize, MinimumPointSize);
+    }
+    //A bitmap family could only use its real sizes.
+    int row=nearestRow(pointSize);
+    return row==-1?pointSize:m_sizes.sizes.at(row);
+}
+
+void KNFontSizeModel::setFamily(const QString &family)
+{
+    //Ignore the same family.
+    if(family==m_family)
+    {
+        return;
+    }
+    //Fetch the sizes of the family for the first time.
+    QHash<QString, FamilySizes>::const_iterator cachedSizes=
+            m_sizeCache.constFind(family);
+    if(cachedSizes==m_sizeCache.constEnd())
+    {
+        cachedSizes=m_sizeCache.insert(family, fetchSizes(family));
+    }
+    //Only reset the model when the sizes are changed.
+    m_family=family;
+    if(cachedSizes->scalable==m_sizes.scalable &&
+            cachedSizes->sizes==m_sizes.sizes)
+    {
+        return;
+    }
+    beginResetModel();
+    m_sizes=*cachedSizes;
+    endResetModel();
+}
+
+KNFontSizeModel::FamilySizes KNFontSizeModel::fetchSizes(const QString &family)
+{
+    FamilySizes familySizes;
+    QFontDatabase fontDatabase;
+    QList<int> sizes;
+    //Only a bitmap family has a limited size list.
+    if(family.isEmpty() || fontDatabase.isScalable(family))
+    {
+        sizes=scalableSizes();
+    }
+    else
+    {
+        familySizes.scalable=false;
+        sizes=fontDatabase.pointSizes(family);
+    }
+    //The smooth sizes are the sizes which look best for the family.
+    if(!family.isEmpty())
+    {
+        sizes.append(fontDatabase.smoothSizes(family, QString()));
+    }
+    familySizes.sizes.reserve(sizes.size());
+    for(int size:sizes)
+    {
+        familySizes.sizes.append(size);
+    }
+    //Sort the sizes for the binary search.
+    std::sort(familySizes.sizes.begin(), familySizes.sizes.end());
+    familySizes.sizes.erase(std::unique(familySizes.sizes.begin(),
+                                        familySizes.sizes.end()),
+                            familySizes.sizes.end());
+    //A family without any size still could be used by its nearest standard
+    //size.
+    if(familySizes.sizes.isEmpty())
+    {
+        familySizes.scalable=true;
+        for(int size:scalableSizes())
+        {
+            familySizes.sizes.append(size);
+        }
+    }
+    return familySizes;
+}
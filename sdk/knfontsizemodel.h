@@ -0,0 +1,129 @@
+/*
+ * Copyright (C) Kreogist Dev Team
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#ifndef KNFONTSIZEMODEL_H
+#define KNFONTSIZEMODEL_H
+
+#include <QAbstractListModel>
+#include <QHash>
+#include <QVector>
+
+/*!
+ * \brief The KNFontSizeModel is a list model of the point sizes of a font
+ * family. The sizes of a family are fetched from the font database the first
+ * time the family is set, and cached for all the models.\n
+ * A scalable family provides the standard sizes up to 288 points and its
+ * smooth sizes, and accepts any size. A bitmap family only provides and
+ * accepts its real and smooth sizes.
+ */
+class KNFontSizeModel : public QAbstractListModel
+{
+    Q_OBJECT
+public:
+    /*!
+     * \brief Construct a KNFontSizeModel.
+     * \param parent The parent object.
+     */
+    explicit KNFontSizeModel(QObject *parent = 0);
+
+    /*!
+     * \brief Reimplemented from QAbstractListModel::rowCount().
+     */
+    int rowCount(const QModelIndex &parent=QModelIndex()) const Q_DECL_OVERRIDE;
+
+    /*!
+     * \brief Reimplemented from QAbstractListModel::data().
+     */
+    QVariant data(const QModelIndex &index,
+                  int role=Qt::DisplayRole) const Q_DECL_OVERRIDE;
+
+    /*!
+     * \brief Get the current family of the model.
+     * \return The family name.
+     */
+    QString family() const;
+
+    /*!
+     * \brief Get whether the current family could be scaled to any size.
+     * \return If the family is not a bitmap font, return true.
+     */
+    bool isScalable() const;
+
+    /*!
+     * \brief Get the point size of a row.
+     * \param row The row of the size.
+     * \return The point size.
+     */
+    qreal pointSize(int row) const;
+
+    /*!
+     * \brief Get the sorted point sizes of the current family.
+     * \return The size list.
+     */
+    QVector<qreal> pointSizes() const;
+
+    /*!
+     * \brief Find the row of a point size.
+     * \param pointSize The point size.
+     * \return The row of the size. If the size is not in the list, return -1.
+     */
+    int indexOf(qreal pointSize) const;
+
+    /*!
+     * \brief Find the row of the size which is closest to a point size.
+     * \param pointSize The point size.
+     * \return The closest row. If the list is empty, return -1.
+     */
+    int nearestRow(qreal pointSize) const;
+
+    /*!
+     * \brief Get a point size which could be used by the current family. A
+     * bitmap family uses its closest size, a scalable family uses any
+     * positive size.
+     * \param pointSize The requested point size.
+     * \return The valid point size.
+     */
+    qreal validSize(qreal pointSize) const;
+
+signals:
+
+public slots:
+    /*!
+     * \brief Change the family of the model, the sizes will be fetched when
+     * they are not cached.
+     * \param family The family name.
+     */
+    void setFamily(const QString &family);
+
+private:
+    struct FamilySizes
+    {
+        QVector<qreal> sizes;
+        bool scalable;
+        FamilySizes() :
+            scalable(true)
+        {
+        }
+    };
+    static FamilySizes fetchSizes(const QString &family);
+    static QHash<QString, FamilySizes> m_sizeCache;
+    QString m_family;
+    FamilySizes m_sizes;
+};
+
+#endif // KNFONTSIZEMODEL_H
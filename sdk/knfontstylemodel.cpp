@@ -0,0 +1,294 @@
+/*
+ * Copyright (C) Kreogist Dev Team
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+#include <QCoreApplication>
+#include <QFont>
+#include <QFontDatabase>
+#include <QThreadPool>
+#include <QtConcurrent/QtConcurrent>
+
+#include <algorithm>
+
+#include "knfontstylemodel.h"
+
+QHash<QString, QVector<KNFontFace>> KNFontStyleModel::m_faceCache;
+QSet<QString> KNFontStyleModel::m_prefetchingFamilies;
+QSet<QString> KNFontStyleModel::m_fetchingFamilies;
+QReadWriteLock KNFontStyleModel::m_cacheLock;
+QWaitCondition KNFontStyleModel::m_fetchedCondition;
+QPointer<QThreadPool> KNFontStyleModel::m_prefetchPool;
+
+KNFontStyleModel::KNFontStyleModel(QObject *parent) :
+    QAbstractListModel(parent),
+    m_faceWatcher(new QFutureWatcher<QVector<KNFontFace>>(this))
+{
+    connect(m_faceWatcher, &QFutureWatcher<QVector<KNFontFace>>::finished,
+            this, &KNFontStyleModel::onActionFacesFetched);
+}
+
+int KNFontStyleModel::rowCount(const QModelIndex &parent) const
+{
+    //List model doesn't have any child.
+    return parent.isValid()?0:m_faces.size();
+}
+
+QVariant KNFontStyleModel::data(const QModelIndex &index, int role) const
+{
+    if(!index.isValid())
+    {
+        return QVariant();
+    }
+    const KNFontFace &fontFace=m_faces.at(index.row());
+    switch(role)
+    {
+    case Qt::DisplayRole:
+        return fontFace.styleName;
+    case Qt::FontRole:
+    {
+        //Show each face in itself.
+        QFont faceFont(m_family);
+        faceFont.setStyleName(fontFace.styleName);
+        return faceFont;
+    }
+    default:
+        return QVariant();
+    }
+}
+
+QString KNFontStyleModel::family() const
+{
+    return m_family;
+}
+
+KNFontFace KNFontStyleModel::face(int row) const
+{
+    return m_faces.at(row);
+}
+
+bool KNFontStyleModel::isLoading() const
+{
+    return !m_loadingFamily.isEmpty();
+}
+
+int KNFontStyleModel::matchRow(const QFont &font) const
+{
+    //Check the style name first.
+    if(!font.styleName().isEmpty())
+    {
+        for(int i=0; i<m_faces.size(); ++i)
+        {
+            if(m_faces.at(i).styleName==font.styleName())
+            {
+                return i;
+            }
+        }
+    }
+    //Find the closest weight, a face with a different italic state is
+    //treated as far away.
+    int matchedRow=-1, matchedDistance=0;
+    for(int i=0; i<m_faces.size(); ++i)
+    {
+        const KNFontFace &fontFace=m_faces.at(i);
+        int distance=qAbs(fontFace.weight-font.weight())+
+                (fontFace.italic==font.italic()?0:1000);
+        if(matchedRow==-1 || distance<matchedDistance)
+        {
+            matchedRow=i;
+            matchedDistance=distance;
+        }
+    }
+    return matchedRow;
+}
+
+void KNFontStyleModel::prefetch(const QStringList &families)
+{
+    //The font database could only be used on the main thread when threaded
+    //font rendering is not supported, fetching the families there blocks the
+    //dialog, the faces are loaded when the family is selected instead.
+    if(!QFontDatabase::supportsThreadedFontRendering())
+    {
+        return;
+    }
+    QStringList fetchFamilies;
+    {
+        //Mark the families which are neither cached nor being fetched.
+        QWriteLocker cacheLocker(&m_cacheLock);
+        for(const QString &family:families)
+        {
+            if(!m_faceCache.contains(family) &&
+                    !m_prefetchingFamilies.contains(family) &&
+                    !m_fetchingFamilies.contains(family))
+            {
+                m_prefetchingFamilies.insert(family);
+                fetchFamilies.append(family);
+            }
+        }
+    }
+    if(fetchFamilies.isEmpty())
+    {
+        return;
+    }
+    QtConcurrent::run(prefetchPool(),
+                      &KNFontStyleModel::prefetchFaces,
+                      fetchFamilies);
+}
+
+void KNFontStyleModel::setFamily(const QString &family)
+{
+    //Ignore the same family.
+    if(family==m_family)
+    {
+        return;
+    }
+    QVector<KNFontFace> faces;
+    bool cached;
+    {
+        QReadLocker cacheLocker(&m_cacheLock);
+        QHash<QString, QVector<KNFontFace>>::const_iterator cachedFaces=
+                m_faceCache.constFind(family);
+        cached=(cachedFaces!=m_faceCache.constEnd());
+        if(cached)
+        {
+            faces=cachedFaces.value();
+        }
+    }
+    //The font database could only be used on the main thread when threaded
+    //font rendering is not supported.
+    if(!cached && !QFontDatabase::supportsThreadedFontRendering())
+    {
+        faces=loadFaces(family);
+        cached=true;
+    }
+    //Show the faces of the family at once when they are cached, or leave the
+    //list empty until they are fetched on the worker thread.
+    beginResetModel();
+    m_family=family;
+    m_faces=faces;
+    endResetModel();
+    if(cached)
+    {
+        //Ignore the faces of the previous family which is still loading.
+        m_loadingFamily.clear();
+        return;
+    }
+    m_loadingFamily=family;
+    m_faceWatcher->setFuture(QtConcurrent::run(prefetchPool(),
+                                               &KNFontStyleModel::loadFaces,
+                                               family));
+}
+
+void KNFontStyleModel::onActionFacesFetched()
+{
+    //Ignore the faces of the family which is not current any more.
+    if(m_loadingFamily.isEmpty() || m_loadingFamily!=m_family)
+    {
+        return;
+    }
+    m_loadingFamily.clear();
+    beginResetModel();
+    m_faces=m_faceWatcher->result();
+    endResetModel();
+    emit facesLoaded();
+}
+
+QVector<KNFontFace> KNFontStyleModel::loadFaces(const QString &family)
+{
+    {
+        QWriteLocker cacheLocker(&m_cacheLock);
+        //Wait for the family being prefetched instead of fetching it again.
+        while(m_fetchingFamilies.contains(family))
+        {
+            m_fetchedCondition.wait(&m_cacheLock);
+        }
+        QHash<QString, QVector<KNFontFace>>::const_iterator cachedFaces=
+                m_faceCache.constFind(family);
+        if(cachedFaces!=m_faceCache.constEnd())
+        {
+            return cachedFaces.value();
+        }
+        //The queued prefetching of the family is skipped, and the other
+        //models wait for this fetch.
+        m_prefetchingFamilies.remove(family);
+        m_fetchingFamilies.insert(family);
+    }
+    QVector<KNFontFace> faces=fetchFaces(family);
+    QWriteLocker cacheLocker(&m_cacheLock);
+    m_faceCache.insert(family, faces);
+    m_fetchingFamilies.remove(family);
+    m_fetchedCondition.wakeAll();
+    return faces;
+}
+
+QVector<KNFontFace> KNFontStyleModel::fetchFaces(const QString &family)
+{
+    QFontDatabase fontDatabase;
+    QStringList styles=fontDatabase.styles(family);
+    QVector<KNFontFace> faces;
+    faces.reserve(styles.size());
+    for(const QString &style:styles)
+    {
+        KNFontFace fontFace;
+        fontFace.styleName=style;
+        fontFace.weight=fontDatabase.weight(family, style);
+        fontFace.italic=fontDatabase.italic(family, style);
+        faces.append(fontFace);
+    }
+    //Sort the faces from light to heavy, the italic face follows its upright
+    //face.
+    std::stable_sort(faces.begin(), faces.end(),
+                     [](const KNFontFace &left, const KNFontFace &right)
+                     {
+                         return left.weight==right.weight?
+                                     (!left.italic && right.italic):
+                                     left.weight<right.weight;
+                     });
+    return faces;
+}
+
+QThreadPool *KNFontStyleModel::prefetchPool()
+{
+    //The pool is deleted with the application, it waits for the running
+    //fetches before the face cache is destroyed.
+    if(m_prefetchPool.isNull())
+    {
+        m_prefetchPool=new QThreadPool(qApp);
+    }
+    return m_prefetchPool.data();
+}
+
+void KNFontStyleModel::prefetchFaces(const QStringList &families)
+{
+    for(const QString &family:families)
+    {
+        {
+            //Skip the family which is fetched by a model when it was
+            //selected.
+            QWriteLocker cacheLocker(&m_cacheLock);
+            if(!m_prefetchingFamilies.remove(family))
+            {
+                continue;
+            }
+            m_fetchingFamilies.insert(family);
+        }
+        QVector<KNFontFace> faces=fetchFaces(family);
+        //Save the faces, and wake up the models waiting for them.
+        QWriteLocker cacheLocker(&m_cacheLock);
+        m_faceCache.insert(family, faces);
+        m_fetchingFamilies.remove(family);
+        m_fetchedCondition.wakeAll();
+    }
+}
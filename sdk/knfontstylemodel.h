@@ -0,0 +1,158 @@
+/*
+ * Copyright (C) Kreogist Dev Team
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#ifndef KNFONTSTYLEMODEL_H
+#define KNFONTSTYLEMODEL_H
+
+#include <QAbstractListModel>
+#include <QFutureWatcher>
+#include <QHash>
+#include <QPointer>
+#include <QReadWriteLock>
+#include <QSet>
+#include <QStringList>
+#include <QVector>
+#include <QWaitCondition>
+
+class QThreadPool;
+
+/*!
+ * \brief The KNFontFace describes one real face of a font family.
+ */
+struct KNFontFace
+{
+    /*!
+     * \brief The style name of the face, e.g. "Light" or "Bold Condensed".
+     */
+    QString styleName;
+    /*!
+     * \brief The QFont::Weight of the face.
+     */
+    int weight;
+    /*!
+     * \brief Whether the face is italic or oblique.
+     */
+    bool italic;
+    KNFontFace() :
+        weight(50),
+        italic(false)
+    {
+    }
+};
+
+/*!
+ * \brief The KNFontStyleModel is a list model of the real faces of a font
+ * family. The faces of a family are fetched on a worker thread the first time
+ * the family is set, the faces of the families around it could be prefetched.
+ * The fetched faces are cached for all the models.
+ */
+class KNFontStyleModel : public QAbstractListModel
+{
+    Q_OBJECT
+public:
+    /*!
+     * \brief Construct a KNFontStyleModel.
+     * \param parent The parent object.
+     */
+    explicit KNFontStyleModel(QObject *parent = 0);
+
+    /*!
+     * \brief Reimplemented from QAbstractListModel::rowCount().
+     */
+    int rowCount(const QModelIndex &parent=QModelIndex()) const Q_DECL_OVERRIDE;
+
+    /*!
+     * \brief Reimplemented from QAbstractListModel::data().
+     */
+    QVariant data(const QModelIndex &index,
+                  int role=Qt::DisplayRole) const Q_DECL_OVERRIDE;
+
+    /*!
+     * \brief Get the current family of the model.
+     * \return The family name.
+     */
+    QString family() const;
+
+    /*!
+     * \brief Get the face of a row.
+     * \param row The row of the face.
+     * \return The face information.
+     */
+    KNFontFace face(int row) const;
+
+    /*!
+     * \brief Find the face which matches a font best. The style name is
+     * checked first, then the closest weight with the same italic state.
+     * \param font The font to match.
+     * \return The row of the face. If the family has no face, return -1.
+     */
+    int matchRow(const QFont &font) const;
+
+    /*!
+     * \brief Get whether the faces of the current family are being fetched.
+     * \return If the faces are not loaded yet, return true.
+     */
+    bool isLoading() const;
+
+    /*!
+     * \brief Fetch the faces of the families which are not cached on a worker
+     * thread. It could be called at any time, the families being fetched are
+     * skipped. Nothing is fetched when threaded font rendering is not
+     * supported.
+     * \param families The family list.
+     */
+    static void prefetch(const QStringList &families);
+
+signals:
+    /*!
+     * \brief When the faces of the current family are fetched on the worker
+     * thread and loaded to the model, this signal will be emitted.
+     */
+    void facesLoaded();
+
+public slots:
+    /*!
+     * \brief Change the family of the model, it never blocks. When the faces
+     * of the family are cached, they are loaded at once. Otherwise the model
+     * is empty until the faces are fetched on a worker thread, or the
+     * prefetching of the family is done, then facesLoaded() is emitted.\n
+     * If the platform doesn't support font access in threads, the faces are
+     * fetched directly.
+     * \param family The family name.
+     */
+    void setFamily(const QString &family);
+
+private slots:
+    void onActionFacesFetched();
+
+private:
+    static QVector<KNFontFace> loadFaces(const QString &family);
+    static QVector<KNFontFace> fetchFaces(const QString &family);
+    static QThreadPool *prefetchPool();
+    static void prefetchFaces(const QStringList &families);
+    static QHash<QString, QVector<KNFontFace>> m_faceCache;
+    static QSet<QString> m_prefetchingFamilies, m_fetchingFamilies;
+    static QReadWriteLock m_cacheLock;
+    static QWaitCondition m_fetchedCondition;
+    static QPointer<QThreadPool> m_prefetchPool;
+    QFutureWatcher<QVector<KNFontFace>> *m_faceWatcher;
+    QString m_family, m_loadingFamily;
+    QVector<KNFontFace> m_faces;
+};
+
+#endif // KNFONTSTYLEMODEL_H
@@ -0,0 +1,503 @@
+/*
+ * Copyright (C) Kreogist Dev Team
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+#include <QMouseEvent>
+#include <QPainter>
+#include <QtMath>
+
+#include <cmath>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include "kntrace.h"
+
+#include "knhsvpicker.h"
+
+//The width of the hue wheel, in the ratio of the outer radius.
+#define WheelWidthRatio 0.16
+//The space between the hue wheel and the square.
+#define SquareGap 4.0
+//The radius of the markers.
+#define MarkerRadius 5.0
+//The default size of the square tile cache in kilobytes.
+#define DefaultCacheLimit 16384
+
+namespace
+{
+const float Pi=3.14159265358979f;
+
+inline void hueToRgb(float hue, float &red, float &green, float &blue)
+{
+    //The channels of a hue are piecewise linear, hue is in [0, 1).
+    float hue6=hue*6.0f;
+    red=qBound(0.0f, std::abs(hue6-3.0f)-1.0f, 1.0f);
+    green=qBound(0.0f, 2.0f-std::abs(hue6-2.0f), 1.0f);
+    blue=qBound(0.0f, 2.0f-std::abs(hue6-4.0f), 1.0f);
+}
+
+#if defined(__SSE2__)
+inline __m128 selectPs(__m128 mask, __m128 left, __m128 right)
+{
+    return _mm_or_ps(_mm_and_ps(mask, left), _mm_andnot_ps(mask, right));
+}
+
+inline __m128 clampPs(__m128 value)
+{
+    return _mm_min_ps(_mm_max_ps(value, _mm_setzero_ps()), _mm_set1_ps(1.0f));
+}
+
+inline __m128 atan2Ps(__m128 y, __m128 x)
+{
+    //Approximate the atan in the first octant, the error is about 1e-5 rad,
+    //then mirror it to the other octants.
+    const __m128 signMask=_mm_set1_ps(-0.0f);
+    __m128 absX=_mm_andnot_ps(signMask, x),
+           absY=_mm_andnot_ps(signMask, y),
+           ratio=_mm_div_ps(_mm_min_ps(absX, absY),
+                            _mm_max_ps(_mm_max_ps(absX, absY),
+                                       _mm_set1_ps(1e-20f))),
+           square=_mm_mul_ps(ratio, ratio),
+           angle=_mm_mul_ps(_mm_set1_ps(-0.0464964749f), square);
+    angle=_mm_mul_ps(_mm_add_ps(angle, _mm_set1_ps(0.15931422f)), square);
+    angle=_mm_mul_ps(_mm_sub_ps(angle, _mm_set1_ps(0.327622764f)), square);
+    angle=_mm_add_ps(_mm_mul_ps(angle, ratio), ratio);
+    angle=selectPs(_mm_cmpgt_ps(absY, absX),
+                   _mm_sub_ps(_mm_set1_ps(Pi/2.0f), angle),
+                   angle);
+    angle=selectPs(_mm_cmplt_ps(x, _mm_setzero_ps()),
+                   _mm_sub_ps(_mm_set1_ps(Pi), angle),
+                   angle);
+    //The angle is positive here, apply the sign of y.
+    return _mm_or_ps(angle, _mm_and_ps(y, signMask));
+}
+#endif
+
+inline void fillSquareLine(QRgb *line, int width, float value,
+                           float redSlope, float greenSlope, float blueSlope)
+{
+    //Every channel is value*(1-s*(1-c)), it is linear on a row.
+    int x=0;
+#if defined(__SSE2__)
+    const __m128 base=_mm_set1_ps(value),
+                 redSlopes=_mm_set1_ps(redSlope),
+                 greenSlopes=_mm_set1_ps(greenSlope),
+                 blueSlopes=_mm_set1_ps(blueSlope),
+                 four=_mm_set1_ps(4.0f);
+    const __m128i alpha=_mm_set1_epi32((int)0xff000000);
+    __m128 positions=_mm_set_ps(3.0f, 2.0f, 1.0f, 0.0f);
+    for(; x+4<=width; x+=4)
+    {
+        __m128i red=_mm_cvtps_epi32(
+                    _mm_sub_ps(base, _mm_mul_ps(redSlopes, positions))),
+                green=_mm_cvtps_epi32(
+                    _mm_sub_ps(base, _mm_mul_ps(greenSlopes, positions))),
+                blue=_mm_cvtps_epi32(
+                    _mm_sub_ps(base, _mm_mul_ps(blueSlopes, positions)));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(line+x),
+                         _mm_or_si128(
+                             _mm_or_si128(alpha, _mm_slli_epi32(red, 16)),
+                             _mm_or_si128(_mm_slli_epi32(green, 8), blue)));
+        positions=_mm_add_ps(positions, four);
+    }
+#endif
+    //Fill the rest pixels.
+    for(; x<width; ++x)
+    {
+        line[x]=qRgb(qRound(value-redSlope*x),
+                     qRound(value-greenSlope*x),
+                     qRound(value-blueSlope*x));
+    }
+}
+
+inline void fillWheelLine(QRgb *line, int width, float center, float dy,
+                          float innerRadius, float outerRadius)
+{
+    int x=0;
+#if defined(__SSE2__)
+    const __m128 dys=_mm_set1_ps(dy),
+                 dySquare=_mm_mul_ps(dys, dys),
+                 inner=_mm_set1_ps(innerRadius-0.5f),
+                 outer=_mm_set1_ps(outerRadius+0.5f),
+                 one=_mm_set1_ps(1.0f),
+                 two=_mm_set1_ps(2.0f),
+                 three=_mm_set1_ps(3.0f),
+                 four=_mm_set1_ps(4.0f),
+                 six=_mm_set1_ps(6.0f),
+                 full=_mm_set1_ps(255.0f),
+                 turn=_mm_set1_ps(1.0f/(2.0f*Pi)),
+                 signMask=_mm_set1_ps(-0.0f);
+    __m128 dxs=_mm_sub_ps(_mm_set_ps(3.5f, 2.5f, 1.5f, 0.5f),
+                          _mm_set1_ps(center));
+    for(; x+4<=width; x+=4, dxs=_mm_add_ps(dxs, four))
+    {
+        //Anti-alias the edges with the pixel coverage.
+        __m128 radius=_mm_sqrt_ps(_mm_add_ps(_mm_mul_ps(dxs, dxs), dySquare)),
+               coverage=_mm_mul_ps(clampPs(_mm_sub_ps(radius, inner)),
+                                   clampPs(_mm_sub_ps(outer, radius)));
+        if(_mm_movemask_ps(_mm_cmpgt_ps(coverage, _mm_setzero_ps()))==0)
+        {
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(line+x),
+                             _mm_setzero_si128());
+            continue;
+        }
+        //Map the angle to the hue.
+        __m128 hue=_mm_mul_ps(atan2Ps(dys, dxs), turn);
+        hue=_mm_add_ps(hue, _mm_and_ps(_mm_cmplt_ps(hue, _mm_setzero_ps()),
+                                       one));
+        __m128 hue6=_mm_mul_ps(hue, six),
+               red=clampPs(_mm_sub_ps(
+                               _mm_andnot_ps(signMask,
+                                             _mm_sub_ps(hue6, three)),
+                               one)),
+               green=clampPs(_mm_sub_ps(
+                                 two,
+                                 _mm_andnot_ps(signMask,
+                                               _mm_sub_ps(hue6, two)))),
+               blue=clampPs(_mm_sub_ps(
+                                two,
+                                _mm_andnot_ps(signMask,
+                                              _mm_sub_ps(hue6, four)))),
+               scale=_mm_mul_ps(coverage, full);
+        //Premultiply the channels.
+        __m128i alpha=_mm_cvtps_epi32(scale),
+                redValue=_mm_cvtps_epi32(_mm_mul_ps(red, scale)),
+                greenValue=_mm_cvtps_epi32(_mm_mul_ps(green, scale)),
+                blueValue=_mm_cvtps_epi32(_mm_mul_ps(blue, scale));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(line+x),
+                         _mm_or_si128(
+                             _mm_or_si128(_mm_slli_epi32(alpha, 24),
+                                          _mm_slli_epi32(redValue, 16)),
+                             _mm_or_si128(_mm_slli_epi32(greenValue, 8),
+                                          blueValue)));
+    }
+#endif
+    //Fill the rest pixels.
+    for(; x<width; ++x)
+    {
+        float dx=x+0.5f-center,
+              radius=std::sqrt(dx*dx+dy*dy),
+              coverage=qBound(0.0f, radius-innerRadius+0.5f, 1.0f)*
+                       qBound(0.0f, outerRadius+0.5f-radius, 1.0f);
+        if(coverage<=0.0f)
+        {
+            line[x]=0;
+            continue;
+        }
+        float hue=std::atan2(dy, dx)/(2.0f*Pi), red, green, blue;
+        if(hue<0.0f)
+        {
+            hue+=1.0f;
+        }
+        hueToRgb(hue, red, green, blue);
+        float scale=coverage*255.0f;
+        line[x]=qRgba(qRound(red*scale), qRound(green*scale),
+                      qRound(blue*scale), qRound(scale));
+    }
+}
+}
+
+KNHsvPicker::KNHsvPicker(QWidget *parent) :
+    QWidget(parent),
+    m_squareTiles(DefaultCacheLimit),
+    m_squareTileKey(0),
+    m_outerRadius(0.0),
+    m_innerRadius(0.0),
+    m_hue(0),
+    m_saturation(0.0),
+    m_value(1.0),
+    m_dragTarget(DragNone)
+{
+    //Keep the picker square.
+    QSizePolicy pickerPolicy(QSizePolicy::Expanding, QSizePolicy::Expanding);
+    pickerPolicy.setHeightForWidth(true);
+    setSizePolicy(pickerPolicy);
+    setMinimumSize(120, 120);
+}
+
+QColor KNHsvPicker::color() const
+{
+    return QColor::fromHsvF(m_hue/360.0, m_saturation, m_value);
+}
+
+QSize KNHsvPicker::sizeHint() const
+{
+    return QSize(240, 240);
+}
+
+int KNHsvPicker::heightForWidth(int width) const
+{
+    return width;
+}
+
+void KNHsvPicker::setCacheLimit(int kilobytes)
+{
+    m_squareTiles.setMaxCost(kilobytes);
+}
+
+void KNHsvPicker::setColor(const QColor &color)
+{
+    QColor hsvColor=color.toHsv();
+    //The achromatic color doesn't have a hue, keep the current one.
+    if(hsvColor.hsvHue()!=-1)
+    {
+        m_hue=hsvColor.hsvHue();
+    }
+    m_saturation=hsvColor.hsvSaturationF();
+    m_value=hsvColor.valueF();
+    update();
+}
+
+void KNHsvPicker::paintEvent(QPaintEvent *event)
+{
+    KN_TRACE_SCOPE("KNHsvPicker::paintEvent");
+    QPainter painter(this);
+    //Render the wheel when the size or the device pixel ratio is changed.
+    qreal devicePixelRatio=devicePixelRatioF();
+    if(m_wheel.isNull() || m_wheel.devicePixelRatio()!=devicePixelRatio)
+    {
+        m_wheel=renderWheel(qRound(m_wheelRect.width()),
+                            m_outerRadius,
+                            m_innerRadius,
+                            devicePixelRatio);
+    }
+    //Only draw the images in the dirty region.
+    QRect dirtyRect=event->rect();
+    if(dirtyRect.intersects(m_wheelRect.toAlignedRect()))
+    {
+        painter.drawImage(m_wheelRect.topLeft(), m_wheel);
+    }
+    if(dirtyRect.intersects(m_squareRect.toAlignedRect()))
+    {
+        painter.drawImage(m_squareRect.topLeft(), squareTile());
+    }
+    //Draw the markers.
+    painter.setRenderHint(QPainter::Antialiasing);
+    painter.setBrush(Qt::NoBrush);
+    for(const QPointF &center:{wheelMarkerCenter(), squareMarkerCenter()})
+    {
+        painter.setPen(QPen(Qt::black, 3.0));
+        painter.drawEllipse(center, MarkerRadius, MarkerRadius);
+        painter.setPen(QPen(Qt::white, 1.5));
+        painter.drawEllipse(center, MarkerRadius, MarkerRadius);
+    }
+}
+
+void KNHsvPicker::resizeEvent(QResizeEvent *event)
+{
+    QWidget::resizeEvent(event);
+    updateGeometryCache();
+}
+
+void KNHsvPicker::mousePressEvent(QMouseEvent *event)
+{
+    //Check which part is pressed.
+    QPointF offset=QPointF(event->pos())-m_wheelRect.center();
+    qreal distance=std::sqrt(QPointF::dotProduct(offset, offset));
+    if(m_squareRect.contains(event->pos()))
+    {
+        m_dragTarget=DragSquare;
+    }
+    else if(distance>=m_innerRadius && distance<=m_outerRadius)
+    {
+        m_dragTarget=DragWheel;
+    }
+    else
+    {
+        QWidget::mousePressEvent(event);
+        return;
+    }
+    dragTo(event->pos());
+}
+
+void KNHsvPicker::mouseMoveEvent(QMouseEvent *event)
+{
+    if(m_dragTarget==DragNone)
+    {
+        QWidget::mouseMoveEvent(event);
+        return;
+    }
+    dragTo(event->pos());
+}
+
+void KNHsvPicker::mouseReleaseEvent(QMouseEvent *event)
+{
+    m_dragTarget=DragNone;
+    QWidget::mouseReleaseEvent(event);
+}
+
+inline void KNHsvPicker::updateGeometryCache()
+{
+    //Place the wheel in the center.
+    int side=qMin(width(), height());
+    m_wheelRect=QRectF((width()-side)/2, (height()-side)/2, side, side);
+    m_outerRadius=side/2.0-1.0;
+    m_innerRadius=m_outerRadius*(1.0-WheelWidthRatio);
+    //The square is inscribed in the wheel, align it to the pixels.
+    int squareSide=(int)((m_innerRadius-SquareGap)*std::sqrt(2.0));
+    QPointF center=m_wheelRect.center();
+    m_squareRect=QRectF(qRound(center.x()-squareSide/2.0),
+                        qRound(center.y()-squareSide/2.0),
+                        squareSide,
+                        squareSide);
+    //Render the wheel again at the next paint.
+    m_wheel=QImage();
+}
+
+inline void KNHsvPicker::dragTo(const QPoint &position)
+{
+    QPointF previousWheelMarker=wheelMarkerCenter(),
+            previousSquareMarker=squareMarkerCenter();
+    if(m_dragTarget==DragWheel)
+    {
+        //Map the angle to the hue, the hue goes counterclockwise.
+        QPointF offset=QPointF(position)-m_wheelRect.center();
+        int hue=qRound(std::atan2(-offset.y(), offset.x())*180.0/M_PI);
+        hue=(hue+360)%360;
+        if(hue==m_hue)
+        {
+            return;
+        }
+        m_hue=hue;
+        //The square shows the new hue, and the wheel marker is moved.
+        update(m_squareRect.toAlignedRect());
+        update(markerRect(previousWheelMarker) |
+               markerRect(wheelMarkerCenter()));
+    }
+    else
+    {
+        //Map the position to the saturation and the value.
+        qreal saturation=qBound(0.0,
+                                (position.x()-m_squareRect.left())/
+                                m_squareRect.width(),
+                                1.0),
+              value=qBound(0.0,
+                           1.0-(position.y()-m_squareRect.top())/
+                           m_squareRect.height(),
+                           1.0);
+        if(saturation==m_saturation && value==m_value)
+        {
+            return;
+        }
+        m_saturation=saturation;
+        m_value=value;
+        //Only the square marker is moved.
+        update(markerRect(previousSquareMarker) |
+               markerRect(squareMarkerCenter()));
+    }
+    emit colorChanged(color());
+}
+
+inline QPointF KNHsvPicker::wheelMarkerCenter() const
+{
+    qreal angle=m_hue*M_PI/180.0,
+          radius=(m_outerRadius+m_innerRadius)/2.0;
+    return m_wheelRect.center()+QPointF(radius*std::cos(angle),
+                                        -radius*std::sin(angle));
+}
+
+inline QPointF KNHsvPicker::squareMarkerCenter() const
+{
+    return QPointF(m_squareRect.left()+m_saturation*m_squareRect.width(),
+                   m_squareRect.top()+(1.0-m_value)*m_squareRect.height());
+}
+
+inline QRect KNHsvPicker::markerRect(const QPointF &center) const
+{
+    //Include the width of the marker pen.
+    qreal radius=MarkerRadius+3.0;
+    return QRectF(center.x()-radius, center.y()-radius,
+                  radius*2.0, radius*2.0).toAlignedRect();
+}
+
+const QImage &KNHsvPicker::squareTile() const
+{
+    //The tiles are keyed by the hue, the size and the device pixel ratio.
+    qreal devicePixelRatio=devicePixelRatioF();
+    int side=qRound(m_squareRect.width());
+    quint64 key=((quint64)m_hue<<48) | ((quint64)side<<16) |
+            (quint64)qRound(devicePixelRatio*100.0);
+    QImage *tile=m_squareTiles.object(key);
+    if(tile!=nullptr)
+    {
+        return *tile;
+    }
+    //Reuse the last tile which couldn't be cached.
+    if(key==m_squareTileKey && !m_squareTile.isNull())
+    {
+        return m_squareTile;
+    }
+    m_squareTile=renderSquare(side, m_hue, devicePixelRatio);
+    m_squareTileKey=key;
+    //The cache deletes the tile which is larger than the cache, then the
+    //rendered tile is kept only in the member.
+    tile=new QImage(m_squareTile);
+    int cost=qMax(1, (int)(((qint64)m_squareTile.bytesPerLine()*
+                            m_squareTile.height())>>10));
+    return m_squareTiles.insert(key, tile, cost)?*tile:m_squareTile;
+}
+
+QImage KNHsvPicker::renderWheel(int size,
+                                qreal outerRadius,
+                                qreal innerRadius,
+                                qreal devicePixelRatio)
+{
+    KN_TRACE_SCOPE("KNHsvPicker::renderWheel");
+    //Render the wheel in the device pixels.
+    int pixelSize=qMax(1, qRound(size*devicePixelRatio));
+    QImage wheel(pixelSize, pixelSize, QImage::Format_ARGB32_Premultiplied);
+    float center=pixelSize/2.0f,
+          innerPixels=innerRadius*devicePixelRatio,
+          outerPixels=outerRadius*devicePixelRatio;
+    for(int y=0; y<pixelSize; ++y)
+    {
+        //The hue goes counterclockwise, so dy points up.
+        fillWheelLine(reinterpret_cast<QRgb *>(wheel.scanLine(y)),
+                      pixelSize,
+                      center,
+                      center-(y+0.5f),
+                      innerPixels,
+                      outerPixels);
+    }
+    wheel.setDevicePixelRatio(devicePixelRatio);
+    return wheel;
+}
+
+QImage KNHsvPicker::renderSquare(int size, int hue, qreal devicePixelRatio)
+{
+    KN_TRACE_SCOPE("KNHsvPicker::renderSquare");
+    //Render the square in the device pixels.
+    int pixelSize=qMax(1, qRound(size*devicePixelRatio));
+    QImage square(pixelSize, pixelSize, QImage::Format_RGB32);
+    float red, green, blue,
+          step=pixelSize>1?1.0f/(pixelSize-1):0.0f;
+    hueToRgb(hue/360.0f, red, green, blue);
+    for(int y=0; y<pixelSize; ++y)
+    {
+        //The value goes down, the saturation goes right.
+        float value=(1.0f-y*step)*255.0f;
+        fillSquareLine(reinterpret_cast<QRgb *>(square.scanLine(y)),
+                       pixelSize,
+                       value,
+                       value*(1.0f-red)*step,
+                       value*(1.0f-green)*step,
+                       value*(1.0f-blue)*step);
+    }
+    square.setDevicePixelRatio(devicePixelRatio);
+    return square;
+}
@@ -0,0 +1,116 @@
+/*
+ * Copyright (C) Kreogist Dev Team
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#ifndef KNHSVPICKER_H
+#define KNHSVPICKER_H
+
+#include <QCache>
+#include <QImage>
+
+#include <QWidget>
+
+/*!
+ * \brief The KNHsvPicker is a hue wheel with a saturation/value square inside.
+ * The wheel and the square are rendered straight into QImage buffers with
+ * SIMD kernels.\n
+ * The rendered square tiles are cached per hue, size and device pixel ratio,
+ * the wheel is rendered once per size. While dragging, only the regions of the
+ * moved markers are repainted.
+ */
+class KNHsvPicker : public QWidget
+{
+    Q_OBJECT
+public:
+    /*!
+     * \brief Construct a KNHsvPicker.
+     * \param parent The parent widget.
+     */
+    explicit KNHsvPicker(QWidget *parent = 0);
+
+    /*!
+     * \brief Get the current color.
+     * \return The color in HSV.
+     */
+    QColor color() const;
+
+    /*!
+     * \brief Reimplemented from QWidget::sizeHint().
+     */
+    QSize sizeHint() const Q_DECL_OVERRIDE;
+
+    /*!
+     * \brief Reimplemented from QWidget::heightForWidth().
+     */
+    int heightForWidth(int width) const Q_DECL_OVERRIDE;
+
+    /*!
+     * \brief Set the maximum size of the square tile cache.
+     * \param kilobytes The cache size in kilobytes.
+     */
+    void setCacheLimit(int kilobytes);
+
+signals:
+    /*!
+     * \brief When the color is changed by the user, this signal will be
+     * emitted.
+     * \param color The new color.
+     */
+    void colorChanged(const QColor &color);
+
+public slots:
+    /*!
+     * \brief Set the current color, the colorChanged() signal won't be
+     * emitted.
+     * \param color The color.
+     */
+    void setColor(const QColor &color);
+
+protected:
+    void paintEvent(QPaintEvent *event) Q_DECL_OVERRIDE;
+    void resizeEvent(QResizeEvent *event) Q_DECL_OVERRIDE;
+    void mousePressEvent(QMouseEvent *event) Q_DECL_OVERRIDE;
+    void mouseMoveEvent(QMouseEvent *event) Q_DECL_OVERRIDE;
+    void mouseReleaseEvent(QMouseEvent *event) Q_DECL_OVERRIDE;
+
+private:
+    enum DragTarget
+    {
+        DragNone,
+        DragWheel,
+        DragSquare
+    };
+    inline void updateGeometryCache();
+    inline void dragTo(const QPoint &position);
+    inline QPointF wheelMarkerCenter() const;
+    inline QPointF squareMarkerCenter() const;
+    inline QRect markerRect(const QPointF &center) const;
+    const QImage &squareTile() const;
+    static QImage renderWheel(int size, qreal outerRadius, qreal innerRadius,
+                              qreal devicePixelRatio);
+    static QImage renderSquare(int size, int hue, qreal devicePixelRatio);
+    mutable QCache<quint64, QImage> m_squareTiles;
+    mutable QImage m_wheel, m_squareTile;
+    mutable quint64 m_squareTileKey;
+    QRectF m_wheelRect, m_squareRect;
+    qreal m_outerRadius, m_innerRadius;
+    int m_hue;
+    qreal m_saturation, m_value;
+    DragTarget m_dragTarget;
+};
+
+#endif // KNHSVPICKER_H
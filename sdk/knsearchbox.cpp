@@ -16,12 +16,62 @@
  * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
  */
 #include <QLabel>
+#include <QProgressBar>
+#include <QThreadPool>
+#include <QTimer>
+#include <QtConcurrent/QtConcurrent>
 
+#include "kntrace.h"
 #include "knsearchbox.h"
 
+//The default time waiting for the typing to stop.
+#define DefaultDebounceInterval 150
+//The size of the busy indicator.
+#define BusyIndicatorWidth 32
+#define BusyIndicatorHeight 4
+
+KNSearchReporter::KNSearchReporter(KNSearchBox *searchBox,
+                                   const QSharedPointer<QAtomicInt> &generation,
+                                   int searchGeneration,
+                                   const QString &query) :
+    m_searchBox(searchBox),
+    m_generation(generation),
+    m_searchGeneration(searchGeneration),
+    m_query(query)
+{
+}
+
+bool KNSearchReporter::isCanceled() const
+{
+    return m_generation->loadAcquire()!=m_searchGeneration;
+}
+
+void KNSearchReporter::reportResults(const QVector<int> &rows)
+{
+    //Drop the results of the stale search.
+    if(rows.isEmpty() || isCanceled())
+    {
+        return;
+    }
+    //The search box waits for the searches before it is deleted, it is still
+    //alive here.
+    QMetaObject::invokeMethod(m_searchBox,
+                              "onActionResultsReported",
+                              Qt::QueuedConnection,
+                              Q_ARG(int, m_searchGeneration),
+                              Q_ARG(QString, m_query),
+                              Q_ARG(QVector<int>, rows));
+}
+
 KNSearchBox::KNSearchBox(QWidget *parent) :
-    QLineEdit(parent)
+    QLineEdit(parent),
+    m_generation(new QAtomicInt(0)),
+    m_debounceTimer(new QTimer(this)),
+    m_searchPool(new QThreadPool(this)),
+    m_busyIndicator(new QProgressBar(this)),
+    m_searching(false)
 {
+    qRegisterMetaType<QVector<int>>();
     //Generate the search icon.
     QPixmap searchIcon(":/common-icon/res/SearchIcon.png");
     QLabel *searchIconWidget=new QLabel(this);
@@ -31,4 +81,158 @@ KNSearchBox::KNSearchBox(QWidget *parent) :
     QMargins editMargins=contentsMargins();
     editMargins.setLeft(editMargins.left()+searchIcon.width());
     setTextMargins(editMargins);
+
+    //Configure the busy indicator, it shows a running bar without progress.
+    m_busyIndicator->setRange(0, 0);
+    m_busyIndicator->setTextVisible(false);
+    m_busyIndicator->setFixedSize(BusyIndicatorWidth, BusyIndicatorHeight);
+    m_busyIndicator->hide();
+
+    //Configure the debounce timer.
+    m_debounceTimer->setSingleShot(true);
+    m_debounceTimer->setInterval(DefaultDebounceInterval);
+    connect(m_debounceTimer, &QTimer::timeout,
+            this, &KNSearchBox::onActionStartSearch);
+    //Only one search runs at a time, the stale search stops early.
+    m_searchPool->setMaxThreadCount(1);
+    connect(this, &KNSearchBox::textChanged,
+            this, &KNSearchBox::onActionTextChange);
+}
+
+KNSearchBox::~KNSearchBox()
+{
+    //Cancel the searches, and wait for the running one before the reporters
+    //lose the search box.
+    m_generation->fetchAndAddOrdered(1);
+    m_searchPool->clear();
+    m_searchPool->waitForDone();
+}
+
+void KNSearchBox::setSearchFunction(const SearchFunction &searchFunction)
+{
+    //Abandon the search of the previous function.
+    cancelSearch();
+    m_searchFunction=searchFunction;
+}
+
+int KNSearchBox::debounceInterval() const
+{
+    return m_debounceTimer->interval();
+}
+
+void KNSearchBox::setDebounceInterval(int msec)
+{
+    m_debounceTimer->setInterval(msec);
+}
+
+bool KNSearchBox::isSearching() const
+{
+    return m_searching;
+}
+
+void KNSearchBox::cancelSearch()
+{
+    m_debounceTimer->stop();
+    //Mark the running search as stale, and remove the queued ones.
+    m_generation->fetchAndAddOrdered(1);
+    m_searchPool->clear();
+    setBusy(false);
+}
+
+void KNSearchBox::search()
+{
+    //Only the asynchronous mode has a search to start.
+    if(m_searchFunction)
+    {
+        m_debounceTimer->stop();
+        onActionStartSearch();
+    }
+}
+
+void KNSearchBox::paintEvent(QPaintEvent *event)
+{
+    KN_TRACE_SCOPE("KNSearchBox::paintEvent");
+    QLineEdit::paintEvent(event);
+}
+
+void KNSearchBox::resizeEvent(QResizeEvent *event)
+{
+    QLineEdit::resizeEvent(event);
+    //Keep the busy indicator at the right bottom of the box.
+    m_busyIndicator->move(width()-BusyIndicatorWidth-BusyIndicatorHeight,
+                          height()-BusyIndicatorHeight*2);
+}
+
+void KNSearchBox::onActionTextChange(const QString &text)
+{
+    Q_UNUSED(text);
+    //Restart the debounce for the asynchronous mode.
+    if(m_searchFunction)
+    {
+        m_debounceTimer->start();
+    }
+}
+
+void KNSearchBox::onActionStartSearch()
+{
+    KN_TRACE_SCOPE("KNSearchBox::startSearch");
+    //Cancel the previous search.
+    int generation=m_generation->fetchAndAddOrdered(1)+1;
+    m_searchPool->clear();
+    QString query=text();
+    setBusy(true);
+    emit searchStarted(query);
+    //Run the search on the worker thread.
+    KNSearchBox *searchBox=this;
+    QSharedPointer<QAtomicInt> generationCounter=m_generation;
+    SearchFunction searchFunction=m_searchFunction;
+    QtConcurrent::run(m_searchPool,
+                      [=]()
+                      {
+                          KNSearchReporter reporter(searchBox,
+                                                    generationCounter,
+                                                    generation,
+                                                    query);
+                          //Skip the search which is already stale.
+                          if(reporter.isCanceled())
+                          {
+                              return;
+                          }
+                          searchFunction(query, reporter);
+                          if(!reporter.isCanceled())
+                          {
+                              QMetaObject::invokeMethod(
+                                          searchBox,
+                                          "onActionSearchDone",
+                                          Qt::QueuedConnection,
+                                          Q_ARG(int, generation),
+                                          Q_ARG(QString, query));
+                          }
+                      });
+}
+
+void KNSearchBox::onActionResultsReported(int generation,
+                                          const QString &query,
+                                          const QVector<int> &rows)
+{
+    //The search may be canceled after the results are sent.
+    if(generation==m_generation->loadAcquire())
+    {
+        emit searchResultsReady(query, rows);
+    }
+}
+
+void KNSearchBox::onActionSearchDone(int generation, const QString &query)
+{
+    if(generation==m_generation->loadAcquire())
+    {
+        setBusy(false);
+        emit searchFinished(query);
+    }
+}
+
+inline void KNSearchBox::setBusy(bool busy)
+{
+    m_searching=busy;
+    m_busyIndicator->setVisible(busy);
 }
@@ -20,18 +20,158 @@
 #define KNSEARCHBOX_H
 
 #include <QLineEdit>
+#include <QSharedPointer>
+#include <QVector>
 
+#include <functional>
+
+class QProgressBar;
+class QThreadPool;
+class QTimer;
+class KNSearchBox;
+
+/*!
+ * \brief The KNSearchReporter is given to the search function of a
+ * KNSearchBox. The search function runs on a worker thread, it reports the
+ * results in batches through the reporter, and should stop as soon as the
+ * search is canceled.
+ */
+class KNSearchReporter
+{
+public:
+    /*!
+     * \brief Get whether the search is out of date. A search is canceled when
+     * a newer query is started or the search box is deleted.
+     * \return If the search should stop, return true.
+     */
+    bool isCanceled() const;
+
+    /*!
+     * \brief Send a batch of result rows to the search box. The batch is
+     * dropped when the search is canceled.
+     * \param rows The result rows.
+     */
+    void reportResults(const QVector<int> &rows);
+
+private:
+    friend class KNSearchBox;
+    KNSearchReporter(KNSearchBox *searchBox,
+                     const QSharedPointer<QAtomicInt> &generation,
+                     int searchGeneration,
+                     const QString &query);
+    KNSearchBox *m_searchBox;
+    QSharedPointer<QAtomicInt> m_generation;
+    int m_searchGeneration;
+    QString m_query;
+};
+
+/*!
+ * \brief The KNSearchBox is a line edit with a search icon.\n
+ * When a search function is set, the search box works in the asynchronous
+ * mode: the query is debounced, the search function runs on a worker thread,
+ * the results are streamed back in batches, and a busy indicator is shown
+ * while searching. Starting a new query cancels the stale one.
+ */
 class KNSearchBox : public QLineEdit
 {
     Q_OBJECT
 public:
+    /*!
+     * \brief The search function runs on a worker thread with the query and
+     * a reporter of the results.
+     */
+    typedef std::function<void(const QString &, KNSearchReporter &)>
+    SearchFunction;
+
+    /*!
+     * \brief Construct a KNSearchBox.
+     * \param parent The parent widget.
+     */
     explicit KNSearchBox(QWidget *parent = 0);
+    ~KNSearchBox();
+
+    /*!
+     * \brief Set the search function, the search box uses the asynchronous
+     * mode when the function is set. Set an empty function to disable it.
+     * \param searchFunction The search function.
+     */
+    void setSearchFunction(const SearchFunction &searchFunction);
+
+    /*!
+     * \brief Get the time waiting for the typing to stop before a search is
+     * started.
+     * \return The debounce interval in milliseconds.
+     */
+    int debounceInterval() const;
+
+    /*!
+     * \brief Set the time waiting for the typing to stop before a search is
+     * started.
+     * \param msec The debounce interval in milliseconds.
+     */
+    void setDebounceInterval(int msec);
+
+    /*!
+     * \brief Get whether an asynchronous search is running.
+     * \return If the search hasn't finished, return true.
+     */
+    bool isSearching() const;
 
 signals:
+    /*!
+     * \brief When an asynchronous search is started, this signal will be
+     * emitted.
+     * \param query The query text.
+     */
+    void searchStarted(const QString &query);
+
+    /*!
+     * \brief When a batch of results is reported by the search function, this
+     * signal will be emitted.
+     * \param query The query text.
+     * \param rows The result rows of the batch.
+     */
+    void searchResultsReady(const QString &query, const QVector<int> &rows);
+
+    /*!
+     * \brief When an asynchronous search is finished, this signal will be
+     * emitted. It is not emitted for the canceled search.
+     * \param query The query text.
+     */
+    void searchFinished(const QString &query);
 
 public slots:
+    /*!
+     * \brief Search the current text at once without the debounce, it is used
+     * when the searched data is changed.
+     */
+    void search();
+
+    /*!
+     * \brief Cancel the running search and the pending debounce.
+     */
+    void cancelSearch();
+
+protected:
+    void paintEvent(QPaintEvent *event) Q_DECL_OVERRIDE;
+    void resizeEvent(QResizeEvent *event) Q_DECL_OVERRIDE;
+
+private slots:
+    void onActionTextChange(const QString &text);
+    void onActionStartSearch();
+    void onActionResultsReported(int generation,
+                                 const QString &query,
+                                 const QVector<int> &rows);
+    void onActionSearchDone(int generation, const QString &query);
 
 private:
+    inline void setBusy(bool busy);
+    SearchFunction m_searchFunction;
+    QSharedPointer<QAtomicInt> m_generation;
+    QTimer *m_debounceTimer;
+    QThreadPool *m_searchPool;
+    QProgressBar *m_busyIndicator;
+    bool m_searching;
 };
 
 #endif // KNSEARCHBOX_H
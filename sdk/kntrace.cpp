@@ -0,0 +1,160 @@
+/*
+ * Copyright (C) Kreogist Dev Team
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+#include <QAtomicInt>
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QThread>
+
+#include "kntrace.h"
+
+//The maximum number of the events in the trace buffer.
+#define TraceBufferSize 65536
+
+namespace
+{
+struct TraceEvent
+{
+    const char *name;
+    qint64 begin;
+    qint64 end;
+    quintptr threadId;
+    QAtomicInt ready;
+};
+
+struct TraceBuffer
+{
+    TraceEvent *events;
+    QAtomicInt eventCount;
+    QElapsedTimer timer;
+    QString filePath;
+    bool enabled;
+};
+
+void dumpTraceBuffer();
+
+TraceBuffer *traceBuffer()
+{
+    //Initialize the buffer at the first use, the initialization of the local
+    //static is thread-safe.
+    static TraceBuffer *buffer=[]()
+    {
+        TraceBuffer *initialBuffer=new TraceBuffer;
+        initialBuffer->filePath=
+                QString::fromLocal8Bit(qgetenv("KN_TRACE_FILE"));
+        initialBuffer->enabled=!initialBuffer->filePath.isEmpty();
+        initialBuffer->events=nullptr;
+        initialBuffer->timer.start();
+        if(initialBuffer->enabled)
+        {
+            //Only allocate the events when the tracing is enabled.
+            initialBuffer->events=new TraceEvent[TraceBufferSize];
+            //Dump the buffer when the application quits.
+            qAddPostRoutine(dumpTraceBuffer);
+        }
+        return initialBuffer;
+    }();
+    return buffer;
+}
+
+void dumpTraceBuffer()
+{
+    KNTrace::dump(traceBuffer()->filePath);
+}
+}
+
+bool KNTrace::isEnabled()
+{
+    return traceBuffer()->enabled;
+}
+
+qint64 KNTrace::now()
+{
+    return traceBuffer()->timer.nsecsElapsed();
+}
+
+void KNTrace::record(const char *name, qint64 begin, qint64 end)
+{
+    TraceBuffer *buffer=traceBuffer();
+    if(!buffer->enabled)
+    {
+        return;
+    }
+    //Take a slot of the buffer, drop the event when the buffer is full. The
+    //counter stops at the buffer size, so it could never wrap negative in a
+    //long running traced process, a negative slot would pass the size check.
+    int eventIndex=buffer->eventCount.loadAcquire();
+    do
+    {
+        if(eventIndex<0 || eventIndex>=TraceBufferSize)
+        {
+            return;
+        }
+    }
+    while(!buffer->eventCount.testAndSetRelaxed(eventIndex, eventIndex+1,
+                                                eventIndex));
+    TraceEvent &event=buffer->events[eventIndex];
+    event.name=name;
+    event.begin=begin;
+    event.end=end;
+    event.threadId=reinterpret_cast<quintptr>(QThread::currentThreadId());
+    //Publish the event.
+    event.ready.storeRelease(1);
+}
+
+bool KNTrace::dump(const QString &filePath)
+{
+    QFile traceFile(filePath);
+    if(!traceFile.open(QIODevice::WriteOnly))
+    {
+        return false;
+    }
+    TraceBuffer *buffer=traceBuffer();
+    int eventCount=buffer->enabled?
+                qMin(buffer->eventCount.loadAcquire(), TraceBufferSize):0;
+    QByteArray processId=QByteArray::number(QCoreApplication::applicationPid());
+    //Write the events in the Chrome trace format, the time unit is
+    //microsecond.
+    traceFile.write("{\"traceEvents\":[");
+    bool firstEvent=true;
+    for(int i=0; i<eventCount; ++i)
+    {
+        const TraceEvent &event=buffer->events[i];
+        //Skip the event which is still being written.
+        if(!event.ready.loadAcquire())
+        {
+            continue;
+        }
+        QByteArray eventName(event.name);
+        eventName.replace('\\', "\\\\").replace('"', "\\\"");
+        traceFile.write(firstEvent?"\n":",\n");
+        traceFile.write("{\"name\":\""+eventName+
+                        "\",\"cat\":\"kreogist\",\"ph\":\"X\",\"ts\":"+
+                        QByteArray::number(event.begin/1000.0, 'f', 3)+
+                        ",\"dur\":"+
+                        QByteArray::number((event.end-event.begin)/1000.0,
+                                           'f', 3)+
+                        ",\"pid\":"+processId+
+                        ",\"tid\":"+QByteArray::number(
+                            (qulonglong)event.threadId)+
+                        "}");
+        firstEvent=false;
+    }
+    traceFile.write("\n],\"displayTimeUnit\":\"ms\"}\n");
+    return true;
+}
@@ -0,0 +1,106 @@
+/*
+ * Copyright (C) Kreogist Dev Team
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#ifndef KNTRACE_H
+#define KNTRACE_H
+
+#include <QString>
+
+/*!
+ * \brief The KNTrace records the scoped timings of the hot paths of the
+ * dialogs. The events are saved in a fixed lock-free buffer, the overhead is
+ * a single check when the tracing is disabled.\n
+ * The tracing is enabled by setting the environment variable KN_TRACE_FILE to
+ * a file path, the buffer will be dumped to the file as Chrome trace JSON when
+ * the application quits. The file could be loaded in chrome://tracing.
+ */
+class KNTrace
+{
+public:
+    /*!
+     * \brief Get whether the tracing is enabled.
+     * \return If KN_TRACE_FILE is set, return true.
+     */
+    static bool isEnabled();
+
+    /*!
+     * \brief Get the current trace time.
+     * \return The nanoseconds since the tracing started.
+     */
+    static qint64 now();
+
+    /*!
+     * \brief Record a complete event. It could be called from any thread. When
+     * the buffer is full, the event will be dropped.
+     * \param name The event name, it must be a string literal.
+     * \param begin The begin trace time.
+     * \param end The end trace time.
+     */
+    static void record(const char *name, qint64 begin, qint64 end);
+
+    /*!
+     * \brief Write all the recorded events as Chrome trace JSON.
+     * \param filePath The JSON file path.
+     * \return If the file is written, return true.
+     */
+    static bool dump(const QString &filePath);
+
+private:
+    KNTrace();
+};
+
+/*!
+ * \brief The KNTraceScope records the time from its construction to its
+ * destruction as a trace event.
+ */
+class KNTraceScope
+{
+public:
+    /*!
+     * \brief Start a trace scope.
+     * \param name The event name, it must be a string literal.
+     */
+    explicit KNTraceScope(const char *name) :
+        m_name(name),
+        m_begin(KNTrace::isEnabled()?KNTrace::now():-1)
+    {
+    }
+
+    ~KNTraceScope()
+    {
+        if(m_begin!=-1)
+        {
+            KNTrace::record(m_name, m_begin, KNTrace::now());
+        }
+    }
+
+private:
+    Q_DISABLE_COPY(KNTraceScope)
+    const char *m_name;
+    qint64 m_begin;
+};
+
+#define KN_TRACE_CONCAT_IMPL(left, right) left##right
+#define KN_TRACE_CONCAT(left, right) KN_TRACE_CONCAT_IMPL(left, right)
+/*!
+ * \brief Trace the current scope with the given event name.
+ */
+#define KN_TRACE_SCOPE(name) \
+    KNTraceScope KN_TRACE_CONCAT(knTraceScope, __LINE__)(name)
+
+#endif // KNTRACE_H
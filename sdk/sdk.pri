@@ -0,0 +1,70 @@
+# Copyright (C) Kreogist Dev Team
+#
+# This program is free software; you can redistribute it and/or
+# modify it under the terms of the GNU General Public License
+# as published by the Free Software Foundation; either version 2
+# of the License, or (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program; if not, write to the Free Software
+# Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+
+QT += core gui widgets concurrent
+
+INCLUDEPATH += $$PWD
+
+SOURCES += \
+    $$PWD/kncolordialog.cpp \
+    $$PWD/kndirectoryreader.cpp \
+    $$PWD/knfiledialog.cpp \
+    $$PWD/knfileindex.cpp \
+    $$PWD/knfilesystemmodel.cpp \
+    $$PWD/knfontcatalog.cpp \
+    $$PWD/knfontcatalogcache.cpp \
+    $$PWD/knfontcoverageindex.cpp \
+    $$PWD/knfontdialog.cpp \
+    $$PWD/knfontfamilyfiltermodel.cpp \
+    $$PWD/knfontfamilymodel.cpp \
+    $$PWD/knfontfileparser.cpp \
+    $$PWD/knfontpreviewdelegate.cpp \
+    $$PWD/knfontresolver.cpp \
+    $$PWD/knfontsearchindex.cpp \
+    $$PWD/knfontsimilarityindex.cpp \
+    $$PWD/knfontsizemodel.cpp \
+    $$PWD/knfontstylemodel.cpp \
+    $$PWD/knhsvpicker.cpp \
+    $$PWD/knsearchbox.cpp \
+    $$PWD/kntrace.cpp
+
+HEADERS += \
+    $$PWD/kncolordialog.h \
+    $$PWD/kndirectoryreader.h \
+    $$PWD/knfiledialog.h \
+    $$PWD/knfileentry.h \
+    $$PWD/knfileindex.h \
+    $$PWD/knfilesystemmodel.h \
+    $$PWD/knfontcatalog.h \
+    $$PWD/knfontcatalogcache.h \
+    $$PWD/knfontcoverageindex.h \
+    $$PWD/knfontdialog.h \
+    $$PWD/knfontfamilyfiltermodel.h \
+    $$PWD/knfontfamilyinfo.h \
+    $$PWD/knfontfamilymodel.h \
+    $$PWD/knfontfileparser.h \
+    $$PWD/knfontpreviewdelegate.h \
+    $$PWD/knfontresolver.h \
+    $$PWD/knfontsearchindex.h \
+    $$PWD/knfontsimilarityindex.h \
+    $$PWD/knfontsizemodel.h \
+    $$PWD/knfontstylemodel.h \
+    $$PWD/knhsvpicker.h \
+    $$PWD/knsearchbox.h \
+    $$PWD/kntrace.h
+
+RESOURCES += \
+    $$PWD/CommonDialog.qrc
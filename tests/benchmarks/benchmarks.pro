@@ -0,0 +1,32 @@
+# Copyright (C) Kreogist Dev Team
+#
+# This program is free software; you can redistribute it and/or
+# modify it under the terms of the GNU General Public License
+# as published by the Free Software Foundation; either version 2
+# of the License, or (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program; if not, write to the Free Software
+# Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+
+# The font dialog benchmarks run on the offscreen platform. Save the results
+# in a machine-readable format to compare the runs, e.g.
+#   ./tst_fontdialogbenchmark -o result.xml,xml
+#   ./tst_fontdialogbenchmark -o result.csv,csv
+
+QT += core gui widgets concurrent testlib
+
+CONFIG += c++11 console testcase
+CONFIG -= app_bundle
+
+TARGET = tst_fontdialogbenchmark
+
+include(../../sdk/sdk.pri)
+
+SOURCES += \
+    tst_fontdialogbenchmark.cpp
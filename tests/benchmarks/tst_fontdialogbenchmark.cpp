@@ -0,0 +1,202 @@
+/*
+ * Copyright (C) Kreogist Dev Team
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+#include <QApplication>
+#include <QFontDatabase>
+#include <QLineEdit>
+#include <QtTest>
+
+#include "knfontcatalog.h"
+#include "knsearchbox.h"
+#include "knfontdialog.h"
+
+namespace
+{
+//The words used to generate the synthetic family names.
+const char *const FamilyWords[]=
+{
+    "Noto", "Source", "Liberation", "DejaVu", "Ubuntu", "Roboto", "Fira",
+    "Droid", "Open", "Cantarell", "Inter", "Lato", "Merriweather", "Oswald"
+};
+const char *const ClassWords[]=
+{
+    "Sans", "Serif", "Mono", "Display", "Text", "Condensed", "Rounded"
+};
+const char *const StyleNames[]=
+{
+    "Regular", "Italic", "Bold", "Bold Italic"
+};
+
+KNFontFamilyInfoList syntheticFamilies(int count)
+{
+    KNFontFamilyInfoList families;
+    families.reserve(count);
+    const int wordCount=sizeof(FamilyWords)/sizeof(FamilyWords[0]),
+              classCount=sizeof(ClassWords)/sizeof(ClassWords[0]);
+    for(int i=0; i<count; ++i)
+    {
+        KNFontFamilyInfo familyInfo;
+        familyInfo.family=QString("%1 %2 %3")
+                .arg(FamilyWords[i%wordCount])
+                .arg(ClassWords[(i/wordCount)%classCount])
+                .arg(i);
+        for(const char *styleName:StyleNames)
+        {
+            familyInfo.styles.append(styleName);
+        }
+        familyInfo.writingSystems=1ULL<<QFontDatabase::Latin;
+        families.append(familyInfo);
+    }
+    return families;
+}
+}
+
+/*!
+ * \brief The KNFontDialogBenchmark measures the font dialog with the synthetic
+ * catalogs of 1k, 10k and 50k families.
+ */
+class KNFontDialogBenchmark : public QObject
+{
+    Q_OBJECT
+public:
+    KNFontDialogBenchmark() :
+        m_loadedCount(0)
+    {
+    }
+
+private slots:
+    void initTestCase()
+    {
+        //Never touch the catalog cache of the user.
+        KNFontCatalog::setCacheEnabled(false);
+    }
+
+    void construct_data()
+    {
+        addCatalogSizes();
+    }
+
+    void construct()
+    {
+        loadCatalog();
+        QBENCHMARK
+        {
+            KNFontDialog fontDialog;
+        }
+    }
+
+    void setInitialFont_data()
+    {
+        addCatalogSizes();
+    }
+
+    void setInitialFont()
+    {
+        loadCatalog();
+        KNFontDialog fontDialog;
+        //Select the families at the both ends of the list.
+        QStringList families=KNFontCatalog::instance()->families();
+        QFont firstFont(families.first()), lastFont(families.last());
+        QBENCHMARK
+        {
+            fontDialog.setInitialFont(firstFont);
+            fontDialog.setInitialFont(lastFont);
+        }
+    }
+
+    void searchKeystrokes_data()
+    {
+        addCatalogSizes();
+    }
+
+    void searchKeystrokes()
+    {
+        loadCatalog();
+        KNFontDialog fontDialog;
+        KNSearchBox *fontSearcher=
+                fontDialog.findChild<KNSearchBox *>("fontSearcher");
+        QVERIFY(fontSearcher!=nullptr);
+        //Type the query one character at a time, then clear it.
+        const QString query("source serif 12");
+        QBENCHMARK
+        {
+            for(int i=1; i<=query.size(); ++i)
+            {
+                fontSearcher->setText(query.left(i));
+            }
+            fontSearcher->clear();
+        }
+    }
+
+    void syncFontSize()
+    {
+        //The size sweep doesn't depend on the size of the catalog.
+        KNFontDialog fontDialog;
+        QLineEdit *sizeEditor=fontDialog.findChild<QLineEdit *>("sizeEditor");
+        QTimer *previewTimer=fontDialog.findChild<QTimer *>("previewTimer");
+        QVERIFY(sizeEditor!=nullptr);
+        QVERIFY(previewTimer!=nullptr);
+        //Sweep the sizes from 1 to 288 points. The preview font is applied
+        //after a frame, apply it for every size like the timer does.
+        QBENCHMARK
+        {
+            for(int pointSize=1; pointSize<=288; ++pointSize)
+            {
+                sizeEditor->setText(QString::number(pointSize));
+                QVERIFY(previewTimer->isActive());
+                QMetaObject::invokeMethod(previewTimer, "timeout");
+            }
+        }
+    }
+
+private:
+    void addCatalogSizes()
+    {
+        QTest::addColumn<int>("familyCount");
+        QTest::newRow("1k") << 1000;
+        QTest::newRow("10k") << 10000;
+        QTest::newRow("50k") << 50000;
+    }
+
+    void loadCatalog()
+    {
+        QFETCH(int, familyCount);
+        //Only replace the catalog when the size changes.
+        if(m_loadedCount!=familyCount)
+        {
+            KNFontCatalog::instance()->loadCustomFamilies(
+                        syntheticFamilies(familyCount));
+            m_loadedCount=familyCount;
+        }
+    }
+
+    int m_loadedCount;
+};
+
+int main(int argc, char *argv[])
+{
+    //Run under the offscreen platform unless another one is asked.
+    if(qEnvironmentVariableIsEmpty("QT_QPA_PLATFORM"))
+    {
+        qputenv("QT_QPA_PLATFORM", "offscreen");
+    }
+    QApplication app(argc, argv);
+    KNFontDialogBenchmark benchmark;
+    return QTest::qExec(&benchmark, argc, argv);
+}
+
+#include "tst_fontdialogbenchmark.moc"
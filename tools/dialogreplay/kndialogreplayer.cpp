@@ -0,0 +1,595 @@
+/*
+ * Copyright (C) Kreogist Dev Team
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+#include <QApplication>
+#include <QCheckBox>
+#include <QEventLoop>
+#include <QFile>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QKeyEvent>
+#include <QListView>
+#include <QMouseEvent>
+#include <QPushButton>
+#include <QSlider>
+#include <QStyle>
+#include <QStyleOptionSlider>
+#include <QTextStream>
+#include <QTimer>
+
+#include "knfontdialog.h"
+#include "knfontstylemodel.h"
+#include "knsearchbox.h"
+
+#include "kndialogreplayer.h"
+
+//The default time to wait for the frame of an event.
+#define DefaultFrameTimeout 1000
+//The default number of the mouse moves of a drag.
+#define DefaultDragSteps 20
+//The interval of checking whether the dialog is settled after a frame.
+#define SettleCheckInterval 4
+
+namespace
+{
+const char *const ScriptCommands[]=
+{
+    "open", "type", "backspace", "drag", "style", "toggle", "wait",
+    "accept", "cancel"
+};
+}
+
+KNDialogReplayer::KNDialogReplayer(QObject *parent) :
+    QObject(parent),
+    m_frameLoop(nullptr),
+    m_settleTimer(new QTimer(this)),
+    m_frameEnd(-1),
+    m_frameTimeout(DefaultFrameTimeout),
+    m_dialogFinished(false)
+{
+    //The frame ends when no more update is pending after a flushed frame.
+    m_settleTimer->setSingleShot(true);
+    connect(m_settleTimer, &QTimer::timeout,
+            this, &KNDialogReplayer::onActionCheckSettled);
+}
+
+KNDialogReplayer::~KNDialogReplayer()
+{
+    closeDialog();
+}
+
+bool KNDialogReplayer::load(const QString &filePath)
+{
+    QFile scriptFile(filePath);
+    if(!scriptFile.open(QIODevice::ReadOnly | QIODevice::Text))
+    {
+        m_errorString=tr("Cannot open %1: %2").arg(filePath,
+                                                  scriptFile.errorString());
+        return false;
+    }
+    QTextStream scriptStream(&scriptFile);
+    QVector<ScriptCommand> commands;
+    int line=0;
+    while(!scriptStream.atEnd())
+    {
+        ++line;
+        QString commandLine=scriptStream.readLine().trimmed();
+        if(commandLine.isEmpty() || commandLine.startsWith('#'))
+        {
+            continue;
+        }
+        ScriptCommand command;
+        command.line=line;
+        int nameEnd=commandLine.indexOf(' ');
+        command.name=commandLine.left(nameEnd);
+        QString argumentText=(nameEnd==-1)?
+                    QString():commandLine.mid(nameEnd+1).trimmed();
+        //The typed text keeps its spaces.
+        if(command.name=="type")
+        {
+            command.arguments.append(argumentText);
+        }
+        else
+        {
+            command.arguments=argumentText.split(' ',
+                                                 QString::SkipEmptyParts);
+        }
+        bool known=false;
+        for(const char *scriptCommand : ScriptCommands)
+        {
+            known=known || (command.name==scriptCommand);
+        }
+        if(!known)
+        {
+            m_errorString=tr("Line %1: unknown command %2").arg(
+                        QString::number(line), command.name);
+            return false;
+        }
+        commands.append(command);
+    }
+    m_commands=commands;
+    return true;
+}
+
+QString KNDialogReplayer::errorString() const
+{
+    return m_errorString;
+}
+
+void KNDialogReplayer::setFrameTimeout(int msecs)
+{
+    m_frameTimeout=msecs;
+}
+
+bool KNDialogReplayer::run()
+{
+    //Watch the frames of all the windows.
+    m_timer.start();
+    qApp->installEventFilter(this);
+    bool result=true;
+    for(const ScriptCommand &command : m_commands)
+    {
+        if(!runCommand(command))
+        {
+            m_errorString=tr("Line %1: %2").arg(QString::number(command.line),
+                                                m_errorString);
+            result=false;
+            break;
+        }
+    }
+    qApp->removeEventFilter(this);
+    closeDialog();
+    return result;
+}
+
+QString KNDialogReplayer::report() const
+{
+    QStringList reports;
+    QStringList kinds=m_histograms.keys()+m_droppedEvents.keys();
+    kinds.removeDuplicates();
+    for(const QString &kind : kinds)
+    {
+        QString kindReport=m_histograms.value(kind).report(kind);
+        //The events without any frame are not in the histogram.
+        if(m_droppedEvents.value(kind)>0)
+        {
+            kindReport.append(tr("\n  %1 events without a frame").arg(
+                                  m_droppedEvents.value(kind)));
+        }
+        reports.append(kindReport);
+    }
+    return reports.join("\n\n");
+}
+
+bool KNDialogReplayer::saveJson(const QString &filePath) const
+{
+    QJsonObject reportObject;
+    QStringList kinds=m_histograms.keys()+m_droppedEvents.keys();
+    kinds.removeDuplicates();
+    for(const QString &kind : kinds)
+    {
+        QJsonObject kindObject=m_histograms.value(kind).toJson();
+        kindObject.insert("dropped", m_droppedEvents.value(kind));
+        reportObject.insert(kind, kindObject);
+    }
+    QFile jsonFile(filePath);
+    if(!jsonFile.open(QIODevice::WriteOnly))
+    {
+        return false;
+    }
+    return jsonFile.write(QJsonDocument(reportObject).toJson())!=-1;
+}
+
+bool KNDialogReplayer::eventFilter(QObject *watched, QEvent *event)
+{
+    //Paint and flush the frame of the dialog, the frame ends after the
+    //backing store is flushed. The deferred updates, e.g. the preview font,
+    //paint more frames, so wait until the dialog is settled.
+    if(m_frameLoop!=nullptr && event->type()==QEvent::UpdateRequest &&
+            watched==m_dialog.data())
+    {
+        watched->event(event);
+        m_frameEnd=m_timer.nsecsElapsed();
+        m_settleTimer->start(0);
+        return true;
+    }
+    return QObject::eventFilter(watched, event);
+}
+
+void KNDialogReplayer::onActionCheckSettled()
+{
+    if(m_frameLoop==nullptr)
+    {
+        return;
+    }
+    //Check again later when a timer or a search is still pending.
+    if(!isDialogIdle())
+    {
+        m_settleTimer->start(SettleCheckInterval);
+        return;
+    }
+    m_frameLoop->quit();
+}
+
+inline bool KNDialogReplayer::runCommand(const ScriptCommand &command)
+{
+    const QStringList &arguments=command.arguments;
+    if(command.name=="open")
+    {
+        openDialog(arguments);
+        return true;
+    }
+    if(command.name=="wait")
+    {
+        runEventLoop(arguments.value(0).toInt());
+        return true;
+    }
+    //The other commands need the dialog.
+    if(m_dialog.isNull() || m_dialogFinished)
+    {
+        m_errorString=tr("the dialog is not open");
+        return false;
+    }
+    if(command.name=="type")
+    {
+        return typeText(arguments.value(0));
+    }
+    if(command.name=="backspace")
+    {
+        return typeBackspace(arguments.isEmpty()?1:arguments.first().toInt());
+    }
+    if(command.name=="drag")
+    {
+        bool isNumber=false;
+        int value=arguments.value(0).toInt(&isNumber);
+        if(!isNumber)
+        {
+            m_errorString=tr("drag needs the slider value");
+            return false;
+        }
+        return dragSlider(value, arguments.size()>1?
+                              qMax(1, arguments.at(1).toInt()):
+                              DefaultDragSteps);
+    }
+    if(command.name=="style")
+    {
+        return clickStyle(arguments.value(0).toInt());
+    }
+    if(command.name=="toggle")
+    {
+        return clickCheckBox(arguments.value(0));
+    }
+    return clickButton(command.name=="accept"?"ok":"cancel");
+}
+
+inline void KNDialogReplayer::openDialog(const QStringList &arguments)
+{
+    closeDialog();
+    qint64 begin=m_timer.nsecsElapsed();
+    //The last argument is the size when it is a number.
+    QStringList familyParts=arguments;
+    bool isNumber=false;
+    qreal pointSize=familyParts.isEmpty()?
+                0:familyParts.last().toDouble(&isNumber);
+    if(isNumber)
+    {
+        familyParts.removeLast();
+    }
+    m_dialog=new KNFontDialog();
+    m_dialogFinished=false;
+    connect(m_dialog.data(), &KNFontDialog::finished,
+            this,
+            [=]()
+            {
+                //Closing the dialog is the end of its last event.
+                m_dialogFinished=true;
+                if(m_frameLoop!=nullptr)
+                {
+                    m_frameEnd=m_timer.nsecsElapsed();
+                    m_frameLoop->quit();
+                }
+            });
+    QFont initialFont=m_dialog->font();
+    if(!familyParts.isEmpty())
+    {
+        initialFont.setFamily(familyParts.join(' '));
+    }
+    if(isNumber && pointSize>0)
+    {
+        initialFont.setPointSizeF(pointSize);
+    }
+    m_dialog->setInitialFont(initialFont);
+    m_dialog->show();
+    m_dialog->activateWindow();
+    waitFrame("open", begin);
+    //The typed text goes to the search box.
+    QWidget *searcher=findControl("fontSearcher");
+    if(searcher!=nullptr)
+    {
+        searcher->setFocus();
+    }
+}
+
+inline void KNDialogReplayer::closeDialog()
+{
+    if(!m_dialog.isNull())
+    {
+        delete m_dialog.data();
+    }
+}
+
+inline bool KNDialogReplayer::typeText(const QString &text)
+{
+    QWidget *searcher=findControl("fontSearcher");
+    if(searcher==nullptr)
+    {
+        return false;
+    }
+    for(const QChar &character : text)
+    {
+        //The Latin-1 key codes are the upper case characters.
+        if(!sendKey("type", searcher, character.toUpper().unicode(),
+                    QString(character)))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+inline bool KNDialogReplayer::typeBackspace(int count)
+{
+    QWidget *searcher=findControl("fontSearcher");
+    if(searcher==nullptr)
+    {
+        return false;
+    }
+    for(int i=0; i<count; ++i)
+    {
+        if(!sendKey("backspace", searcher, Qt::Key_Backspace, QString()))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+inline bool KNDialogReplayer::dragSlider(int value, int steps)
+{
+    QSlider *slider=qobject_cast<QSlider *>(findControl("sizeSlider"));
+    if(slider==nullptr)
+    {
+        return false;
+    }
+    //Get the center of the handle at a slider position.
+    auto handleCenter=[slider](int position)
+    {
+        QStyleOptionSlider option;
+        option.initFrom(slider);
+        option.subControls=QStyle::SC_None;
+        option.orientation=slider->orientation();
+        option.minimum=slider->minimum();
+        option.maximum=slider->maximum();
+        option.sliderPosition=position;
+        option.sliderValue=position;
+        option.singleStep=slider->singleStep();
+        option.pageStep=slider->pageStep();
+        option.tickPosition=slider->tickPosition();
+        option.tickInterval=slider->tickInterval();
+        //The vertical slider has the minimum at the bottom.
+        option.upsideDown=(slider->orientation()==Qt::Horizontal)?
+                    (slider->invertedAppearance()!=
+                     (slider->layoutDirection()==Qt::RightToLeft)):
+                    !slider->invertedAppearance();
+        return slider->style()->subControlRect(QStyle::CC_Slider,
+                                               &option,
+                                               QStyle::SC_SliderHandle,
+                                               slider).center();
+    };
+    int start=slider->value();
+    value=qBound(slider->minimum(), value, slider->maximum());
+    //Press the handle, move it in steps and release it.
+    if(!sendMouse("drag", slider, QEvent::MouseButtonPress,
+                  handleCenter(start)))
+    {
+        return false;
+    }
+    for(int i=1; i<=steps; ++i)
+    {
+        if(!sendMouse("drag", slider, QEvent::MouseMove,
+                      handleCenter(start+(value-start)*i/steps)))
+        {
+            return false;
+        }
+    }
+    return sendMouse("drag", slider, QEvent::MouseButtonRelease,
+                     handleCenter(value));
+}
+
+inline bool KNDialogReplayer::clickStyle(int row)
+{
+    QListView *styleList=qobject_cast<QListView *>(findControl("styleList"));
+    if(styleList==nullptr)
+    {
+        return false;
+    }
+    QRect rowRect=styleList->visualRect(styleList->model()->index(row, 0));
+    if(!rowRect.isValid())
+    {
+        m_errorString=tr("style row %1 doesn't exist").arg(row);
+        return false;
+    }
+    return sendMouse("style", styleList->viewport(),
+                     QEvent::MouseButtonPress, rowRect.center()) &&
+            sendMouse("style", styleList->viewport(),
+                      QEvent::MouseButtonRelease, rowRect.center());
+}
+
+inline bool KNDialogReplayer::clickCheckBox(const QString &name)
+{
+    QCheckBox *checkBox=qobject_cast<QCheckBox *>(findControl(name));
+    if(checkBox==nullptr)
+    {
+        return false;
+    }
+    return sendMouse("toggle", checkBox, QEvent::MouseButtonPress,
+                     checkBox->rect().center()) &&
+            sendMouse("toggle", checkBox, QEvent::MouseButtonRelease,
+                      checkBox->rect().center());
+}
+
+inline bool KNDialogReplayer::clickButton(const QString &name)
+{
+    QPushButton *button=qobject_cast<QPushButton *>(findControl(name));
+    if(button==nullptr)
+    {
+        return false;
+    }
+    //The dialog is closed at the release.
+    QString kind=(name=="ok")?"accept":"cancel";
+    return sendMouse(kind, button, QEvent::MouseButtonPress,
+                     button->rect().center()) &&
+            sendMouse(kind, button, QEvent::MouseButtonRelease,
+                      button->rect().center());
+}
+
+inline QWidget *KNDialogReplayer::findControl(const QString &name) const
+{
+    QWidget *control=m_dialog->findChild<QWidget *>(name);
+    if(control==nullptr)
+    {
+        const_cast<KNDialogReplayer *>(this)->m_errorString=
+                tr("control %1 doesn't exist").arg(name);
+    }
+    return control;
+}
+
+inline bool KNDialogReplayer::sendMouse(const QString &kind,
+                                        QWidget *widget,
+                                        int type,
+                                        const QPoint &position)
+{
+    //The button is still held while moving.
+    Qt::MouseButtons buttons=(type==QEvent::MouseButtonRelease)?
+                Qt::NoButton:Qt::LeftButton;
+    return measure(kind, widget,
+                   new QMouseEvent((QEvent::Type)type,
+                                   position,
+                                   widget->mapTo(widget->window(), position),
+                                   widget->mapToGlobal(position),
+                                   (type==QEvent::MouseMove)?
+                                       Qt::NoButton:Qt::LeftButton,
+                                   buttons,
+                                   Qt::NoModifier));
+}
+
+inline bool KNDialogReplayer::sendKey(const QString &kind,
+                                      QWidget *widget,
+                                      int key,
+                                      const QString &text)
+{
+    if(!measure(kind, widget,
+                new QKeyEvent(QEvent::KeyPress, key, Qt::NoModifier, text)))
+    {
+        return false;
+    }
+    //The release doesn't change anything, it is not measured.
+    QCoreApplication::postEvent(widget,
+                                new QKeyEvent(QEvent::KeyRelease,
+                                              key,
+                                              Qt::NoModifier,
+                                              text));
+    QCoreApplication::processEvents();
+    return true;
+}
+
+inline bool KNDialogReplayer::measure(const QString &kind,
+                                      QWidget *widget,
+                                      QEvent *event)
+{
+    if(m_dialog.isNull() || m_dialogFinished)
+    {
+        delete event;
+        m_errorString=tr("the dialog is closed");
+        return false;
+    }
+    //The event goes through the event loop like a real input.
+    qint64 begin=m_timer.nsecsElapsed();
+    QCoreApplication::postEvent(widget, event);
+    waitFrame(kind, begin);
+    return true;
+}
+
+inline void KNDialogReplayer::waitFrame(const QString &kind, qint64 begin)
+{
+    QEventLoop frameLoop;
+    m_frameLoop=&frameLoop;
+    m_frameEnd=-1;
+    QTimer::singleShot(m_frameTimeout, &frameLoop, SLOT(quit()));
+    frameLoop.exec();
+    m_frameLoop=nullptr;
+    m_settleTimer->stop();
+    //When the dialog never settles, the last frame before the timeout is
+    //used.
+    if(m_frameEnd==-1)
+    {
+        ++m_droppedEvents[kind];
+        return;
+    }
+    m_histograms[kind].add(m_frameEnd-begin);
+}
+
+inline void KNDialogReplayer::runEventLoop(int msecs)
+{
+    QEventLoop waitLoop;
+    QTimer::singleShot(qMax(0, msecs), &waitLoop, SLOT(quit()));
+    waitLoop.exec();
+}
+
+inline bool KNDialogReplayer::isDialogIdle() const
+{
+    if(m_dialog.isNull() || m_dialogFinished)
+    {
+        return true;
+    }
+    //The coalescing timers of the dialog are the single shot ones.
+    for(QTimer *timer : m_dialog->findChildren<QTimer *>())
+    {
+        if(timer->isActive() && timer->isSingleShot())
+        {
+            return false;
+        }
+    }
+    //The faces of a family are loaded after they are fetched.
+    for(KNFontStyleModel *styleModel :
+        m_dialog->findChildren<KNFontStyleModel *>())
+    {
+        if(styleModel->isLoading())
+        {
+            return false;
+        }
+    }
+    //The results of a search are painted after the search finished.
+    for(KNSearchBox *searchBox : m_dialog->findChildren<KNSearchBox *>())
+    {
+        if(searchBox->isSearching())
+        {
+            return false;
+        }
+    }
+    return true;
+}
@@ -0,0 +1,149 @@
+/*
+ * Copyright (C) Kreogist Dev Team
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+#ifndef KNDIALOGREPLAYER_H
+#define KNDIALOGREPLAYER_H
+
+#include <QElapsedTimer>
+#include <QMap>
+#include <QObject>
+#include <QPointer>
+#include <QStringList>
+#include <QVector>
+
+#include "knlatencyhistogram.h"
+
+class QEvent;
+class QEventLoop;
+class QTimer;
+class QWidget;
+class KNFontDialog;
+/*!
+ * \brief The KNDialogReplayer drives a KNFontDialog from a script and
+ * measures the time from every input event to the end of the last frame of
+ * the dialog before it settles, so the cost of the event loop, the layout and
+ * the painting is included. The dialog is settled when its coalescing timers
+ * have fired and its searches have finished, so the deferred preview updates
+ * are measured as well.\n
+ * A script contains one command on each line, "#" starts a comment:
+ *   open [family] [size]  Open the dialog with the initial font.
+ *   type <text>           Type the text into the search box.
+ *   backspace [count]     Remove the characters from the search box.
+ *   drag <value> [steps]  Drag the size slider to the value.
+ *   style <row>           Click a row of the style list.
+ *   toggle <name>         Click a check box: underline, strikeOut, kerning.
+ *   wait <msecs>          Run the event loop.
+ *   accept                Click Ok.
+ *   cancel                Click Cancel.
+ * The latencies are collected by the command.
+ */
+class KNDialogReplayer : public QObject
+{
+    Q_OBJECT
+public:
+    /*!
+     * \brief Construct a KNDialogReplayer.
+     * \param parent The parent object.
+     */
+    explicit KNDialogReplayer(QObject *parent = 0);
+    ~KNDialogReplayer();
+
+    /*!
+     * \brief Load a script file.
+     * \param filePath The script file path.
+     * \return If the script is loaded, return true. The error is saved in
+     * errorString().
+     */
+    bool load(const QString &filePath);
+
+    /*!
+     * \brief Get the last error.
+     * \return The error description.
+     */
+    QString errorString() const;
+
+    /*!
+     * \brief Set the longest time to wait for the frame of an event, the event
+     * is counted as dropped after the time. It is 1000ms by default.
+     * \param msecs The timeout in milliseconds.
+     */
+    void setFrameTimeout(int msecs);
+
+    /*!
+     * \brief Run the loaded script.
+     * \return If all the commands are run, return true.
+     */
+    bool run();
+
+    /*!
+     * \brief Get the text report of all the commands.
+     * \return The report text.
+     */
+    QString report() const;
+
+    /*!
+     * \brief Save the report as a JSON file.
+     * \param filePath The JSON file path.
+     * \return If the file is saved, return true.
+     */
+    bool saveJson(const QString &filePath) const;
+
+protected:
+    bool eventFilter(QObject *watched, QEvent *event) Q_DECL_OVERRIDE;
+
+private slots:
+    void onActionCheckSettled();
+
+private:
+    struct ScriptCommand
+    {
+        QString name;
+        QStringList arguments;
+        int line;
+    };
+    inline bool runCommand(const ScriptCommand &command);
+    inline void openDialog(const QStringList &arguments);
+    inline void closeDialog();
+    inline bool typeText(const QString &text);
+    inline bool typeBackspace(int count);
+    inline bool dragSlider(int value, int steps);
+    inline bool clickStyle(int row);
+    inline bool clickCheckBox(const QString &name);
+    inline bool clickButton(const QString &name);
+    inline QWidget *findControl(const QString &name) const;
+    inline bool sendMouse(const QString &kind, QWidget *widget,
+                          int type, const QPoint &position);
+    inline bool sendKey(const QString &kind, QWidget *widget, int key,
+                        const QString &text);
+    inline bool measure(const QString &kind, QWidget *widget, QEvent *event);
+    inline void waitFrame(const QString &kind, qint64 begin);
+    inline void runEventLoop(int msecs);
+    inline bool isDialogIdle() const;
+    QVector<ScriptCommand> m_commands;
+    QMap<QString, KNLatencyHistogram> m_histograms;
+    QMap<QString, int> m_droppedEvents;
+    QString m_errorString;
+    QElapsedTimer m_timer;
+    QPointer<KNFontDialog> m_dialog;
+    QEventLoop *m_frameLoop;
+    QTimer *m_settleTimer;
+    qint64 m_frameEnd;
+    int m_frameTimeout;
+    bool m_dialogFinished;
+};
+
+#endif // KNDIALOGREPLAYER_H
@@ -0,0 +1,134 @@
+/*
+ * Copyright (C) Kreogist Dev Team
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+#include <QJsonArray>
+#include <QStringList>
+
+#include <algorithm>
+#include <cmath>
+
+#include "knlatencyhistogram.h"
+
+//The first bucket contains the samples under 64 microseconds, every bucket
+//after it is twice as wide.
+#define FirstBucketMicroseconds 64
+#define BucketCount 16
+//The width of the longest bar in the text report.
+#define BarWidth 40
+
+KNLatencyHistogram::KNLatencyHistogram()
+{
+}
+
+void KNLatencyHistogram::add(qint64 nsecs)
+{
+    m_samples.append(nsecs);
+}
+
+int KNLatencyHistogram::count() const
+{
+    return m_samples.size();
+}
+
+qint64 KNLatencyHistogram::percentile(qreal percent) const
+{
+    if(m_samples.isEmpty())
+    {
+        return 0;
+    }
+    //Use the nearest rank.
+    QVector<qint64> samples=m_samples;
+    int rank=qBound(0,
+                    (int)std::ceil(percent/100.0*samples.size())-1,
+                    samples.size()-1);
+    std::nth_element(samples.begin(), samples.begin()+rank, samples.end());
+    return samples.at(rank);
+}
+
+qint64 KNLatencyHistogram::maximum() const
+{
+    return m_samples.isEmpty()?
+                0:*std::max_element(m_samples.constBegin(),
+                                    m_samples.constEnd());
+}
+
+QString KNLatencyHistogram::report(const QString &name) const
+{
+    QStringList lines;
+    lines.append(QString("%1: %2 events, p50 %3 ms, p95 %4 ms, p99 %5 ms, "
+                         "max %6 ms").arg(
+                     name,
+                     QString::number(count()),
+                     QString::number(percentile(50)/1e6, 'f', 2),
+                     QString::number(percentile(95)/1e6, 'f', 2),
+                     QString::number(percentile(99)/1e6, 'f', 2),
+                     QString::number(maximum()/1e6, 'f', 2)));
+    QVector<int> bucketCounts=buckets();
+    int largestBucket=*std::max_element(bucketCounts.constBegin(),
+                                        bucketCounts.constEnd());
+    for(int i=0; i<BucketCount; ++i)
+    {
+        if(bucketCounts.at(i)==0)
+        {
+            continue;
+        }
+        //Show the upper bound of the bucket.
+        QString bound=(i==BucketCount-1)?
+                    QString("inf"):
+                    QString::number((FirstBucketMicroseconds << i)/1000.0,
+                                    'f', 3);
+        lines.append(QString("  < %1 ms %2 %3").arg(
+                         bound, 10).arg(
+                         QString(bucketCounts.at(i)*BarWidth/largestBucket,
+                                 '#'), -BarWidth).arg(bucketCounts.at(i)));
+    }
+    return lines.join('\n');
+}
+
+QJsonObject KNLatencyHistogram::toJson() const
+{
+    QJsonObject histogram;
+    histogram.insert("count", count());
+    histogram.insert("p50", percentile(50)/1e6);
+    histogram.insert("p95", percentile(95)/1e6);
+    histogram.insert("p99", percentile(99)/1e6);
+    histogram.insert("max", maximum()/1e6);
+    //The bucket i counts the samples under (64 << i) microseconds.
+    QJsonArray bucketArray;
+    for(int bucketCount : buckets())
+    {
+        bucketArray.append(bucketCount);
+    }
+    histogram.insert("buckets", bucketArray);
+    return histogram;
+}
+
+inline QVector<int> KNLatencyHistogram::buckets() const
+{
+    QVector<int> bucketCounts(BucketCount, 0);
+    for(qint64 sample : m_samples)
+    {
+        int bucket=0;
+        while(bucket<BucketCount-1 &&
+              sample>=(qint64)(FirstBucketMicroseconds << bucket)*1000)
+        {
+            ++bucket;
+        }
+        ++bucketCounts[bucket];
+    }
+    return bucketCounts;
+}
@@ -0,0 +1,81 @@
+/*
+ * Copyright (C) Kreogist Dev Team
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+#ifndef KNLATENCYHISTOGRAM_H
+#define KNLATENCYHISTOGRAM_H
+
+#include <QJsonObject>
+#include <QString>
+#include <QVector>
+
+/*!
+ * \brief The KNLatencyHistogram collects the latency samples of one kind of
+ * event. The samples are kept, so the percentiles are exact.
+ */
+class KNLatencyHistogram
+{
+public:
+    /*!
+     * \brief Construct an empty KNLatencyHistogram.
+     */
+    KNLatencyHistogram();
+
+    /*!
+     * \brief Add a sample.
+     * \param nsecs The latency in nanoseconds.
+     */
+    void add(qint64 nsecs);
+
+    /*!
+     * \brief Get the number of the samples.
+     * \return The sample count.
+     */
+    int count() const;
+
+    /*!
+     * \brief Get a percentile of the samples.
+     * \param percent The percentile, from 0 to 100.
+     * \return The latency in nanoseconds. If there is no sample, return 0.
+     */
+    qint64 percentile(qreal percent) const;
+
+    /*!
+     * \brief Get the largest sample.
+     * \return The latency in nanoseconds.
+     */
+    qint64 maximum() const;
+
+    /*!
+     * \brief Format the percentiles and the power of two buckets of the
+     * samples.
+     * \param name The event kind name.
+     * \return The text report.
+     */
+    QString report(const QString &name) const;
+
+    /*!
+     * \brief Get the percentiles and the buckets as a JSON object.
+     * \return The JSON object.
+     */
+    QJsonObject toJson() const;
+
+private:
+    inline QVector<int> buckets() const;
+    QVector<qint64> m_samples;
+};
+
+#endif // KNLATENCYHISTOGRAM_H
@@ -0,0 +1,87 @@
+/*
+ * Copyright (C) Kreogist Dev Team
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+#include <QApplication>
+#include <QCommandLineParser>
+#include <QStyleFactory>
+#include <QTextStream>
+
+#include "kndialogreplayer.h"
+
+int main(int argc, char *argv[])
+{
+    //Replay under the offscreen platform unless another one is asked.
+    if(qEnvironmentVariableIsEmpty("QT_QPA_PLATFORM"))
+    {
+        qputenv("QT_QPA_PLATFORM", "offscreen");
+    }
+    QApplication app(argc, argv);
+    QApplication::setStyle(QStyleFactory::create("fusion"));
+    //The blinking caret adds the frames which are not caused by the input.
+    QApplication::setCursorFlashTime(0);
+    //Parse the arguments.
+    QCommandLineParser parser;
+    parser.setApplicationDescription(
+                "Replay a script on the font dialog and report the "
+                "input-to-frame latency percentiles.");
+    parser.addHelpOption();
+    parser.addPositionalArgument("script", "The replay script file.");
+    QCommandLineOption repeatOption(QStringList() << "r" << "repeat",
+                                    "Run the script <count> times.",
+                                    "count", "1"),
+                       jsonOption(QStringList() << "j" << "json",
+                                  "Save the report as JSON to <file>.",
+                                  "file"),
+                       timeoutOption(QStringList() << "t" << "timeout",
+                                     "Wait <msecs> for the frame of an "
+                                     "event.",
+                                     "msecs", "1000");
+    parser.addOption(repeatOption);
+    parser.addOption(jsonOption);
+    parser.addOption(timeoutOption);
+    parser.process(app);
+    if(parser.positionalArguments().isEmpty())
+    {
+        parser.showHelp(1);
+    }
+    QTextStream output(stdout), errorOutput(stderr);
+    //Load and run the script.
+    KNDialogReplayer replayer;
+    replayer.setFrameTimeout(parser.value(timeoutOption).toInt());
+    if(!replayer.load(parser.positionalArguments().first()))
+    {
+        errorOutput << replayer.errorString() << endl;
+        return 1;
+    }
+    int repeat=qMax(1, parser.value(repeatOption).toInt());
+    for(int i=0; i<repeat; ++i)
+    {
+        if(!replayer.run())
+        {
+            errorOutput << replayer.errorString() << endl;
+            return 1;
+        }
+    }
+    output << replayer.report() << endl;
+    if(parser.isSet(jsonOption) &&
+            !replayer.saveJson(parser.value(jsonOption)))
+    {
+        errorOutput << "Cannot save " << parser.value(jsonOption) << endl;
+        return 1;
+    }
+    return 0;
+}